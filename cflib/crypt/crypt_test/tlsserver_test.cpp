@@ -16,6 +16,47 @@
 
 using namespace cflib::crypt;
 
+namespace {
+
+bool handshake(TLSClient & client, TLSServer & server)
+{
+    QByteArray enc1 = client.initialSend();
+    QByteArray enc2;
+    QByteArray plain;
+    while (!enc1.isEmpty()) {
+        enc2.clear();
+        if (!server.received(enc1, plain, enc2)) return false;
+        enc1.clear();
+        if (!client.received(enc2, plain, enc1)) return false;
+    }
+    return plain.isEmpty();
+}
+
+void throughput(TLSServer & server, TLSClient & client, int chunkSize)
+{
+    const qint64 Total = 64 * 1024 * 1024;
+    const QByteArray chunk(chunkSize, 'x');
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 received = 0;
+    for (qint64 sent = 0 ; sent < Total ; sent += chunkSize) {
+        QByteArray enc;
+        QVERIFY(server.send(chunk, enc));
+        QByteArray plain;
+        QByteArray sendBack;
+        QVERIFY(client.received(enc, plain, sendBack));
+        received += plain.size();
+    }
+    const qint64 nsecs = timer.nsecsElapsed();
+    QCOMPARE(received, (Total + chunkSize - 1) / chunkSize * chunkSize);
+
+    QTextStream(stdout) << "chunk size " << chunkSize << ": "
+        << received * 1000 / nsecs << " MB/s" << Qt::endl;
+}
+
+}
+
 class TLSServer_test : public QObject
 {
     Q_OBJECT
@@ -379,6 +420,108 @@ private slots:
         QVERIFY(enc1.isEmpty());
     }
 
+    void test_resumption()
+    {
+        TLSCredentials serverCreds;
+        QCOMPARE((int)serverCreds.addCerts(cert1 + cert2 + cert3), 3);
+        QVERIFY(serverCreds.addPrivateKey(detach(cert1PrivateKey), "SuperSecure123"));
+        TLSSessions serverSessions(3600, 100);
+
+        TLSCredentials clientCreds;
+        QCOMPARE((int)clientCreds.addCerts(cert3, true), 1);
+        QCOMPARE((int)clientCreds.addRevocationLists(cert2Crl), 1);
+        TLSSessions clientSessions(true);
+
+        // first handshake gets a ticket
+        {
+            TLSServer server(serverSessions, serverCreds);
+            TLSClient client(clientSessions, clientCreds, "127.0.0.1");
+            QVERIFY(handshake(client, server));
+        }
+        QCOMPARE(serverSessions.fullHandshakes(), (quint64)1);
+        QCOMPARE(serverSessions.resumedHandshakes(), (quint64)0);
+
+        // other server object (other thread in TCPManager) resumes
+        {
+            TLSServer server(serverSessions, serverCreds);
+            TLSClient client(clientSessions, clientCreds, "127.0.0.1");
+            QVERIFY(handshake(client, server));
+
+            QByteArray msg = "hello dear server";
+            QByteArray enc;
+            QByteArray plain;
+            QByteArray sendBack;
+            QVERIFY(client.send(msg, enc));
+            QVERIFY(server.received(enc, plain, sendBack));
+            QCOMPARE(plain, msg);
+        }
+        QCOMPARE(serverSessions.fullHandshakes(), (quint64)1);
+        QCOMPARE(serverSessions.resumedHandshakes(), (quint64)1);
+
+        // disabled: tickets are not accepted anymore
+        serverSessions.setResumption(0, 0);
+        {
+            TLSServer server(serverSessions, serverCreds);
+            TLSClient client(clientSessions, clientCreds, "127.0.0.1");
+            QVERIFY(handshake(client, server));
+        }
+        QCOMPARE(serverSessions.fullHandshakes(), (quint64)2);
+        QCOMPARE(serverSessions.resumedHandshakes(), (quint64)1);
+    }
+
+    void test_multiRecordSend()
+    {
+        TLSCredentials serverCreds;
+        QCOMPARE((int)serverCreds.addCerts(cert1 + cert2 + cert3), 3);
+        QVERIFY(serverCreds.addPrivateKey(detach(cert1PrivateKey), "SuperSecure123"));
+        TLSSessions serverSessions;
+        TLSServer server(serverSessions, serverCreds);
+
+        TLSCredentials clientCreds;
+        QCOMPARE((int)clientCreds.addCerts(cert3, true), 1);
+        QCOMPARE((int)clientCreds.addRevocationLists(cert2Crl), 1);
+        TLSSessions clientSessions;
+        TLSClient client(clientSessions, clientCreds);
+        QVERIFY(handshake(client, server));
+
+        // more than one record, split at an odd position
+        QByteArray data(100000, 0);
+        for (int i = 0 ; i < data.size() ; ++i) data[i] = (char)(i * 7);
+        QByteArray enc;
+        QVERIFY(server.send(data.constData(), data.size(), enc));
+        QVERIFY(enc.size() <= TLSStream::maxEncryptedSize(data.size()));
+
+        QByteArray plain;
+        QByteArray sendBack;
+        const int split = enc.size() / 3 + 1;
+        QVERIFY(client.received(enc.constData(), split, plain, sendBack));
+        QByteArray rest;
+        QVERIFY(client.received(enc.constData() + split, enc.size() - split, rest, sendBack));
+        QCOMPARE(plain + rest, data);
+    }
+
+    void test_throughputBenchmark()
+    {
+        BENCHMARK_ONLY();
+
+        TLSCredentials serverCreds;
+        QCOMPARE((int)serverCreds.addCerts(cert1 + cert2 + cert3), 3);
+        QVERIFY(serverCreds.addPrivateKey(detach(cert1PrivateKey), "SuperSecure123"));
+        TLSSessions serverSessions;
+        TLSServer server(serverSessions, serverCreds);
+
+        TLSCredentials clientCreds;
+        QCOMPARE((int)clientCreds.addCerts(cert3, true), 1);
+        QCOMPARE((int)clientCreds.addRevocationLists(cert2Crl), 1);
+        TLSSessions clientSessions;
+        TLSClient client(clientSessions, clientCreds);
+        QVERIFY(handshake(client, server));
+
+        throughput(server, client, 1024);
+        throughput(server, client, 16 * 1024);
+        throughput(server, client, 1024 * 1024);
+    }
+
 };
 #include "tlsserver_test.moc"
 ADD_TEST(TLSServer_test)
@@ -18,6 +18,7 @@
 #include <botan/bcrypt.h>
 #include <botan/der_enc.h>
 #include <botan/filters.h>
+#include <botan/kdf.h>
 #include <botan/pem.h>
 #include <botan/pkcs10.h>
 #include <botan/pkcs8.h>
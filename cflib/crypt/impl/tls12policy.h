@@ -31,4 +31,18 @@ private:
     const bool requireRevocationInfo_;
 };
 
+// provides the secrets to Callbacks::tls_ssl_key_log_data
+template<typename Base>
+class KeyLogPolicy : public Base
+{
+public:
+    template<typename... Args>
+    KeyLogPolicy(Args... args) : Base(args...) {}
+
+    bool allow_ssl_key_log_file() const override
+    {
+        return true;
+    }
+};
+
 }}
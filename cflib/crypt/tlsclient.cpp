@@ -129,15 +129,23 @@ QByteArray TLSClient::initialSend()
     return rv;
 }
 
-bool TLSClient::received(const QByteArray & encrypted, QByteArray & plain, QByteArray & sendBack)
+bool TLSClient::isEstablished() const
+{
+    return impl_->isReady;
+}
+
+bool TLSClient::received(const char * encrypted, int size, QByteArray & plain, QByteArray & sendBack)
 {
     if (impl_->hasError) return false;
     impl_->outgoingEncryptedPtr = &sendBack;
     impl_->incomingPlainPtr     = &plain;
+    // plain bytes of a record are less than its record bytes
+    if (impl_->isReady) plain.reserve(plain.size() + size);
     TRY {
-        impl_->client.received_data((const byte *)encrypted.constData(), encrypted.size());
+        impl_->client.received_data((const byte *)encrypted, size);
         QByteArray & tmpBuf = impl_->outgoingPlainTmpBuf;
         if (!tmpBuf.isEmpty() && impl_->isReady && !impl_->hasError) {
+            sendBack.reserve(sendBack.size() + maxEncryptedSize(tmpBuf.size()));
             impl_->client.send((const byte *)tmpBuf.constData(), tmpBuf.size());
             tmpBuf.clear();
         }
@@ -147,13 +155,17 @@ bool TLSClient::received(const QByteArray & encrypted, QByteArray & plain, QByte
     return false;
 }
 
-bool TLSClient::send(const QByteArray & plain, QByteArray & encrypted)
+bool TLSClient::send(const char * plain, int size, QByteArray & encrypted)
 {
     if (impl_->hasError) return false;
     impl_->outgoingEncryptedPtr = &encrypted;
     TRY {
-        if (impl_->isReady) impl_->client.send((const byte *)plain.constData(), plain.size());
-        else                impl_->outgoingPlainTmpBuf.append(plain);
+        if (impl_->isReady) {
+            encrypted.reserve(encrypted.size() + maxEncryptedSize(size));
+            impl_->client.send((const byte *)plain, size);
+        } else {
+            impl_->outgoingPlainTmpBuf.append(plain, size);
+        }
         return !impl_->hasError;
     } CATCH
     impl_->hasError = true;
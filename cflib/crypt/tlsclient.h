@@ -22,8 +22,11 @@ public:
     ~TLSClient();
 
     QByteArray initialSend() override;
-    bool received(const QByteArray & encrypted, QByteArray & plain, QByteArray & sendBack) override;
-    bool send(const QByteArray & plain, QByteArray & encrypted) override;
+    bool isEstablished() const override;
+    using TLSStream::received;
+    using TLSStream::send;
+    bool received(const char * encrypted, int size, QByteArray & plain, QByteArray & sendBack) override;
+    bool send(const char * plain, int size, QByteArray & encrypted) override;
 
 private:
     class Impl;
@@ -16,18 +16,48 @@ USE_LOG(LogCat::Crypt)
 
 namespace cflib { namespace crypt {
 
+namespace {
+
+// HKDF-Expand-Label of RFC 8446 with empty context
+QByteArray expandLabel(const std::string & hash, const std::vector<uint8_t> & secret, const std::string & label, size_t length)
+{
+    const std::string fullLabel = "tls13 " + label;
+    std::vector<uint8_t> info;
+    info.push_back((uint8_t)(length >> 8));
+    info.push_back((uint8_t)length);
+    info.push_back((uint8_t)fullLabel.size());
+    info.insert(info.end(), fullLabel.begin(), fullLabel.end());
+    info.push_back(0);
+    const secure_vector<uint8_t> rv = KDF::create_or_throw("HKDF-Expand(" + hash + ")")
+        ->derive_key(length, secret, std::span<const uint8_t>(), info);
+    return QByteArray((const char *)rv.data(), (int)rv.size());
+}
+
+}
+
 class TLSServer::Impl : public TLS::Callbacks
 {
 public:
-    Impl(TLS::Session_Manager & session_manager, Credentials_Manager & creds, bool highSecurity, bool requireRevocationInfo) :
+    Impl(TLSSessions & sessions, Credentials_Manager & creds, bool highSecurity, bool requireRevocationInfo,
+        bool exportTrafficKeys)
+    :
+        sessions(sessions),
         outgoingEncryptedPtr(0),
         incomingPlainPtr(0),
         isReady(false),
         hasError(false),
-        policy(highSecurity ? (TLS::Policy *)new TLS::Strict_Policy : (TLS::Policy *)new TLS::TLS12Policy(requireRevocationInfo)),
+        exportKeys(exportTrafficKeys),
+        isTLS13(false),
+        bytesNeeded(0),
+        appKeys(false),
+        recordRest(0),
+        recordSplit(false),
+        txRecords(0),
+        rxSeq(0),
+        policy(createPolicy(highSecurity, requireRevocationInfo, exportTrafficKeys)),
         server(
             detachedShared(*this),
-            detachedShared(session_manager),
+            detachedShared(sessions.session_Manager()),
             detachedShared(creds),
             policy,
             detachedShared(rng))
@@ -44,17 +74,62 @@ public:
 //             size_t reserved_io_buffer_size = TLS::Channel::IO_BUF_DEFAULT_SIZE);
 
 
+    static TLS::Policy * createPolicy(bool highSecurity, bool requireRevocationInfo, bool keyLog)
+    {
+        if (highSecurity) {
+            if (keyLog) return new TLS::KeyLogPolicy<TLS::Strict_Policy>();
+            else        return new TLS::Strict_Policy;
+        }
+        if (keyLog) return new TLS::KeyLogPolicy<TLS::TLS12Policy>(requireRevocationInfo);
+        else        return new TLS::TLS12Policy(requireRevocationInfo);
+    }
+
     void tls_emit_data(std::span<const uint8_t> data) override
     {
         outgoingEncryptedPtr->append((const char *)data.data(), data.size());
+        if (appKeys) countRecords(data);
     }
 
     void tls_record_received(uint64_t seq_no, std::span<const uint8_t> data) override
     {
-        Q_UNUSED(seq_no)
+        rxSeq = seq_no + 1;
         incomingPlainPtr->append((const char *)data.data(), data.size());
     }
 
+    void tls_ssl_key_log_data(std::string_view label, std::span<const uint8_t> client_random,
+        std::span<const uint8_t> secret) const override
+    {
+        Q_UNUSED(client_random)
+        if (!exportKeys) return;
+        if (label == "CLIENT_TRAFFIC_SECRET_0") {
+            clientSecret.assign(secret.begin(), secret.end());
+        } else if (label == "SERVER_TRAFFIC_SECRET_0") {
+            serverSecret.assign(secret.begin(), secret.end());
+            // all following records use the application traffic key
+            appKeys = true;
+        }
+    }
+
+    // Botan emits complete records, a split header is not followed
+    void countRecords(std::span<const uint8_t> data)
+    {
+        size_t pos = 0;
+        while (pos < data.size()) {
+            if (recordRest > 0) {
+                const size_t count = qMin(recordRest, data.size() - pos);
+                recordRest -= count;
+                pos += count;
+                continue;
+            }
+            if (data.size() - pos < TLS::TLS_HEADER_SIZE) {
+                recordSplit = true;
+                return;
+            }
+            recordRest = TLS::TLS_HEADER_SIZE + (data[pos + 3] << 8 | data[pos + 4]);
+            ++txRecords;
+        }
+    }
+
     void tls_alert(TLS::Alert alert) override
     {
         logInfo("TLS alert: %1", alert.type_string().c_str());
@@ -63,26 +138,45 @@ public:
 
     void tls_session_established(const TLS::Session_Summary & session) override
     {
-        Q_UNUSED(session)
+        sessions.handshakeFinished(session.was_resumption());
+        isTLS13 = !session.version().is_pre_tls_13();
+        cipher = session.ciphersuite().cipher_algo();
+        prf    = session.ciphersuite().prf_algo();
         isReady = true;
     }
 
 public:
+    TLSSessions & sessions;
     QByteArray outgoingPlainTmpBuf;
     QByteArray * outgoingEncryptedPtr;
     QByteArray * incomingPlainPtr;
     bool isReady;
     bool hasError;
+    // traffic key export
+    const bool exportKeys;
+    bool isTLS13;
+    std::string cipher;
+    std::string prf;
+    size_t bytesNeeded;    // of the next record
+    mutable std::vector<uint8_t> clientSecret;
+    mutable std::vector<uint8_t> serverSecret;
+    mutable bool appKeys;
+    size_t recordRest;
+    bool recordSplit;
+    quint64 txRecords;
+    quint64 rxSeq;
     std::shared_ptr<TLS::Policy> policy;
     AutoSeeded_RNG rng;
     TLS::Server server;
 };
 
-TLSServer::TLSServer(TLSSessions & sessions, TLSCredentials & credentials, bool highSecurity, bool requireRevocationInfo) :
+TLSServer::TLSServer(TLSSessions & sessions, TLSCredentials & credentials, bool highSecurity, bool requireRevocationInfo,
+    bool exportTrafficKeys)
+:
     impl_(0)
 {
     TRY {
-        impl_ = new Impl(sessions.session_Manager(), credentials.credentials_Manager(), highSecurity, requireRevocationInfo);
+        impl_ = new Impl(sessions, credentials.credentials_Manager(), highSecurity, requireRevocationInfo, exportTrafficKeys);
     } CATCH
 }
 
@@ -91,15 +185,23 @@ TLSServer::~TLSServer()
     delete impl_;
 }
 
-bool TLSServer::received(const QByteArray & encrypted, QByteArray & plain, QByteArray & sendBack)
+bool TLSServer::isEstablished() const
+{
+    return impl_->isReady;
+}
+
+bool TLSServer::received(const char * encrypted, int size, QByteArray & plain, QByteArray & sendBack)
 {
     if (impl_->hasError) return false;
     impl_->outgoingEncryptedPtr = &sendBack;
     impl_->incomingPlainPtr     = &plain;
+    // plain bytes of a record are less than its record bytes
+    if (impl_->isReady) plain.reserve(plain.size() + size);
     TRY {
-        impl_->server.received_data((const byte *)encrypted.constData(), encrypted.size());
+        impl_->bytesNeeded = impl_->server.received_data((const byte *)encrypted, size);
         QByteArray & tmpBuf = impl_->outgoingPlainTmpBuf;
         if (!tmpBuf.isEmpty() && impl_->isReady && !impl_->hasError) {
+            sendBack.reserve(sendBack.size() + maxEncryptedSize(tmpBuf.size()));
             impl_->server.send((const byte *)tmpBuf.constData(), tmpBuf.size());
             tmpBuf.clear();
         }
@@ -109,17 +211,47 @@ bool TLSServer::received(const QByteArray & encrypted, QByteArray & plain, QByte
     return false;
 }
 
-bool TLSServer::send(const QByteArray & plain, QByteArray & encrypted)
+bool TLSServer::send(const char * plain, int size, QByteArray & encrypted)
 {
     if (impl_->hasError) return false;
     impl_->outgoingEncryptedPtr = &encrypted;
     TRY {
-        if (impl_->isReady) impl_->server.send((const byte *)plain.constData(), plain.size());
-        else                impl_->outgoingPlainTmpBuf.append(plain);
+        if (impl_->isReady) {
+            encrypted.reserve(encrypted.size() + maxEncryptedSize(size));
+            impl_->server.send((const byte *)plain, size);
+        } else {
+            impl_->outgoingPlainTmpBuf.append(plain, size);
+        }
         return !impl_->hasError;
     } CATCH
     impl_->hasError = true;
     return false;
 }
 
+bool TLSServer::trafficKeys(TLSTrafficKeys & keys)
+{
+    const Impl & d = *impl_;
+    if (!d.exportKeys || !d.isReady || d.hasError || !d.isTLS13 || d.recordSplit) return false;
+    // Botan must not hold any part of a record
+    if (d.bytesNeeded != TLS::TLS_HEADER_SIZE || d.recordRest > 0 || !d.outgoingPlainTmpBuf.isEmpty()) return false;
+    if (d.clientSecret.empty() || d.serverSecret.empty()) return false;
+
+    size_t keyLen;
+    if      (d.cipher == "AES-128/GCM")      { keys.cipher = TLSTrafficKeys::AES_128_GCM;       keyLen = 16; }
+    else if (d.cipher == "AES-256/GCM")      { keys.cipher = TLSTrafficKeys::AES_256_GCM;       keyLen = 32; }
+    else if (d.cipher == "ChaCha20Poly1305") { keys.cipher = TLSTrafficKeys::ChaCha20_Poly1305; keyLen = 32; }
+    else return false;
+
+    TRY {
+        keys.txKey = expandLabel(d.prf, d.serverSecret, "key", keyLen);
+        keys.txIV  = expandLabel(d.prf, d.serverSecret, "iv",  12);
+        keys.txSeq = d.txRecords;
+        keys.rxKey = expandLabel(d.prf, d.clientSecret, "key", keyLen);
+        keys.rxIV  = expandLabel(d.prf, d.clientSecret, "iv",  12);
+        keys.rxSeq = d.rxSeq;
+        return true;
+    } CATCH
+    return false;
+}
+
 }}    // namespace
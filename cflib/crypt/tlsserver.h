@@ -17,13 +17,18 @@ class TLSSessions;
 class TLSServer : public TLSStream
 {
 public:
+    // exportTrafficKeys: enables trafficKeys (TLS 1.3 only)
     TLSServer(TLSSessions & sessions, TLSCredentials & credentials,
-        bool highSecurity = false, bool requireRevocationInfo = false);
+        bool highSecurity = false, bool requireRevocationInfo = false, bool exportTrafficKeys = false);
     ~TLSServer();
 
     QByteArray initialSend() override { return QByteArray(); }
-    bool received(const QByteArray & encrypted, QByteArray & plain, QByteArray & sendBack) override;
-    bool send(const QByteArray & plain, QByteArray & encrypted) override;
+    bool isEstablished() const override;
+    using TLSStream::received;
+    using TLSStream::send;
+    bool received(const char * encrypted, int size, QByteArray & plain, QByteArray & sendBack) override;
+    bool send(const char * plain, int size, QByteArray & encrypted) override;
+    bool trafficKeys(TLSTrafficKeys & keys) override;
 
 private:
     class Impl;
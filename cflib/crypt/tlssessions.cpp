@@ -13,17 +13,175 @@ USE_LOG(LogCat::Crypt)
 
 namespace cflib { namespace crypt {
 
+namespace {
+
+QByteArray idKey(const TLS::Session_ID & id)
+{
+    return QByteArray((const char *)id.get().data(), (int)id.get().size());
+}
+
+// Server side session manager shared by all TLSServers (of all threads).
+// TLS 1.3 and TLS 1.2 clients with ticket support get stateless tickets.
+// Only TLS 1.2 clients without ticket support occupy memory.
+class TicketSessionManager : public TLS::Session_Manager
+{
+public:
+    TicketSessionManager(RandomNumberGenerator & rng, uint ticketKeyLifetimeSec, uint maxCachedSessions) :
+        TLS::Session_Manager(detachedShared(rng)),
+        rng_(rng),
+        keyLifetimeMs_(0)
+    {
+        configure(ticketKeyLifetimeSec, maxCachedSessions);
+    }
+
+    void configure(uint ticketKeyLifetimeSec, uint maxCachedSessions)
+    {
+        QMutexLocker lock(&mutex_);
+        keyLifetimeMs_ = (qint64)ticketKeyLifetimeSec * 1000;
+        ids_.setMaxCost(keyLifetimeMs_ > 0 ? maxCachedSessions : 0);
+        if (keyLifetimeMs_ == 0) {
+            currentKey_.reset();
+            previousKey_.reset();
+        }
+    }
+
+    std::optional<TLS::Session_Handle> establish(const TLS::Session & session,
+        const std::optional<TLS::Session_ID> & id, bool tls12_no_ticket) override
+    {
+        QMutexLocker lock(&mutex_);
+        if (keyLifetimeMs_ == 0) return std::nullopt;
+
+        if (tls12_no_ticket) {
+            if (ids_.maxCost() == 0) return std::nullopt;
+            TLS::Session_ID newId;
+            if (id) {
+                newId = *id;
+            } else {
+                std::vector<uint8_t> rnd(32);
+                rng_.randomize(rnd.data(), rnd.size());
+                newId = TLS::Session_ID(rnd);
+            }
+            ids_.insert(idKey(newId), new TLS::Session(session));
+            return TLS::Session_Handle(newId);
+        }
+
+        rotateKeys();
+        TRY {
+            return TLS::Session_Handle(TLS::Session_Ticket(session.encrypt(*currentKey_, rng_)));
+        } CATCH
+        return std::nullopt;
+    }
+
+    void store(const TLS::Session & session, const TLS::Session_Handle & handle) override
+    {
+        const std::optional<TLS::Session_ID> id = handle.id();
+        if (!id) return;
+        QMutexLocker lock(&mutex_);
+        if (ids_.maxCost() > 0) ids_.insert(idKey(*id), new TLS::Session(session));
+    }
+
+    size_t remove(const TLS::Session_Handle & handle) override
+    {
+        const std::optional<TLS::Session_ID> id = handle.id();
+        if (!id) return 0;
+        QMutexLocker lock(&mutex_);
+        return ids_.remove(idKey(*id)) ? 1 : 0;
+    }
+
+    size_t remove_all() override
+    {
+        QMutexLocker lock(&mutex_);
+        const size_t rv = ids_.size();
+        ids_.clear();
+        return rv;
+    }
+
+    bool emits_session_tickets() override
+    {
+        return true;
+    }
+
+protected:
+    std::optional<TLS::Session> retrieve_one(const TLS::Session_Handle & handle) override
+    {
+        QMutexLocker lock(&mutex_);
+        if (keyLifetimeMs_ == 0) return std::nullopt;
+
+        if (const std::optional<TLS::Session_ID> id = handle.id()) {
+            const TLS::Session * session = ids_.object(idKey(*id));
+            if (session) return *session;
+        }
+
+        const std::optional<TLS::Session_Ticket> ticket = handle.ticket();
+        if (!ticket) return std::nullopt;
+        rotateKeys();
+        for (const std::optional<SymmetricKey> * key : { &currentKey_, &previousKey_ }) {
+            if (!*key) continue;
+            try {
+                return TLS::Session::decrypt(ticket->get(), **key);
+            } catch (...) {
+                // other key or manipulated ticket
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::vector<TLS::Session_with_Handle> find_some(const TLS::Server_Information & info,
+        size_t max_sessions_hint) override
+    {
+        // clients are not served
+        Q_UNUSED(info)
+        Q_UNUSED(max_sessions_hint)
+        return {};
+    }
+
+private:
+    // keys are replaced lazily on first use after their lifetime
+    void rotateKeys()
+    {
+        if (currentKey_ && keyAge_.elapsed() < keyLifetimeMs_) return;
+        if (currentKey_ && keyAge_.elapsed() < 2 * keyLifetimeMs_) previousKey_ = currentKey_;
+        else                                                       previousKey_.reset();
+        currentKey_ = SymmetricKey(rng_, 32);
+        keyAge_.start();
+        logDebug("new session ticket key");
+    }
+
+private:
+    RandomNumberGenerator & rng_;
+    QMutex mutex_;
+    qint64 keyLifetimeMs_;
+    std::optional<SymmetricKey> currentKey_;
+    std::optional<SymmetricKey> previousKey_;
+    QElapsedTimer keyAge_;
+    QCache<QByteArray, TLS::Session> ids_;
+};
+
+}
+
 class TLSSessions::Impl
 {
 public:
     Impl(bool enable) :
+        tickets(0),
         mgr(enable ?
             (TLS::Session_Manager *)new TLS::Session_Manager_In_Memory(detachedShared(rng)) :
-            (TLS::Session_Manager *)new TLS::Session_Manager_Noop) {}
+            (TLS::Session_Manager *)new TLS::Session_Manager_Noop),
+        fullHandshakes(0),
+        resumedHandshakes(0) {}
+
+    Impl(uint ticketKeyLifetimeSec, uint maxCachedSessions) :
+        tickets(new TicketSessionManager(rng, ticketKeyLifetimeSec, maxCachedSessions)),
+        mgr(tickets),
+        fullHandshakes(0),
+        resumedHandshakes(0) {}
 
 public:
     AutoSeeded_RNG rng;
+    TicketSessionManager * tickets;
     QSharedPointer<TLS::Session_Manager> mgr;
+    QAtomicInteger<quint64> fullHandshakes;
+    QAtomicInteger<quint64> resumedHandshakes;
 };
 
 TLSSessions::TLSSessions(bool enable) :
@@ -31,14 +189,44 @@ TLSSessions::TLSSessions(bool enable) :
 {
 }
 
+TLSSessions::TLSSessions(uint ticketKeyLifetimeSec, uint maxCachedSessions) :
+    impl_(new Impl(ticketKeyLifetimeSec, maxCachedSessions))
+{
+}
+
 TLSSessions::~TLSSessions()
 {
     delete impl_;
 }
 
+void TLSSessions::setResumption(uint ticketKeyLifetimeSec, uint maxCachedSessions)
+{
+    if (!impl_->tickets) {
+        logWarn("setResumption on client side sessions");
+        return;
+    }
+    impl_->tickets->configure(ticketKeyLifetimeSec, maxCachedSessions);
+}
+
+quint64 TLSSessions::fullHandshakes() const
+{
+    return impl_->fullHandshakes.loadRelaxed();
+}
+
+quint64 TLSSessions::resumedHandshakes() const
+{
+    return impl_->resumedHandshakes.loadRelaxed();
+}
+
 Botan::TLS::Session_Manager & TLSSessions::session_Manager()
 {
     return *impl_->mgr;
 }
 
+void TLSSessions::handshakeFinished(bool resumed)
+{
+    if (resumed) impl_->resumedHandshakes.fetchAndAddRelaxed(1);
+    else         impl_->fullHandshakes.fetchAndAddRelaxed(1);
+}
+
 }}    // namespace
@@ -13,13 +13,30 @@ namespace Botan { namespace TLS { class Session_Manager; }}
 
 namespace cflib { namespace crypt {
 
+// Session storage of TLSClient and TLSServer.
+// Can be shared by any number of streams in any thread.
 class TLSSessions
 {
     Q_DISABLE_COPY(TLSSessions)
 public:
+    // in memory cache of sessions (client side) or no resumption at all
     TLSSessions(bool enable = false);
+
+    // server side resumption:
+    // - stateless session tickets encrypted with a key, which is replaced every ticketKeyLifetimeSec
+    //   (tickets of the previous key are still accepted)
+    // - clients without ticket support (TLS 1.2) get a session id, up to maxCachedSessions are kept (LRU)
+    TLSSessions(uint ticketKeyLifetimeSec, uint maxCachedSessions);
     ~TLSSessions();
 
+    // only for sessions created with the server side constructor
+    // ticketKeyLifetimeSec == 0 disables resumption
+    void setResumption(uint ticketKeyLifetimeSec, uint maxCachedSessions);
+
+    // handshakes of all TLSServers using this object
+    quint64 fullHandshakes() const;
+    quint64 resumedHandshakes() const;
+
 private:
     class Impl;
     Impl * impl_;
@@ -27,6 +44,7 @@ private:
     friend class TLSClient;
     friend class TLSServer;
     Botan::TLS::Session_Manager & session_Manager();
+    void handshakeFinished(bool resumed);
 };
 
 }}    // namespace
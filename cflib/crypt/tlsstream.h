@@ -11,6 +11,20 @@
 
 namespace cflib { namespace crypt {
 
+// Record protection of an established TLS 1.3 connection for encryption by the kernel (kTLS).
+struct TLSTrafficKeys
+{
+    enum Cipher { AES_128_GCM, AES_256_GCM, ChaCha20_Poly1305 };
+
+    Cipher cipher;
+    QByteArray txKey;
+    QByteArray txIV;    // 12 bytes
+    quint64 txSeq;      // sequence number of the next record
+    QByteArray rxKey;
+    QByteArray rxIV;
+    quint64 rxSeq;
+};
+
 class TLSStream
 {
     Q_DISABLE_COPY(TLSStream)
@@ -18,8 +32,36 @@ public:
     TLSStream() {}
     virtual ~TLSStream() {}
     virtual QByteArray initialSend() = 0;
-    virtual bool received(const QByteArray & encrypted, QByteArray & plain, QByteArray & sendBack) = 0;
-    virtual bool send(const QByteArray & plain, QByteArray & encrypted) = 0;
+    virtual bool isEstablished() const = 0;    // handshake is done
+
+    // Decrypted bytes are appended to plain, bytes for the peer to sendBack / encrypted.
+    // Space for the whole output is reserved at once, so every byte is copied only once
+    // and the output can be passed on without a copy (i.e. to the write queue of a connection).
+    virtual bool received(const char * encrypted, int size, QByteArray & plain, QByteArray & sendBack) = 0;
+    virtual bool send(const char * plain, int size, QByteArray & encrypted) = 0;
+
+    bool received(const QByteArray & encrypted, QByteArray & plain, QByteArray & sendBack)
+    {
+        return received(encrypted.constData(), encrypted.size(), plain, sendBack);
+    }
+
+    bool send(const QByteArray & plain, QByteArray & encrypted)
+    {
+        return send(plain.constData(), plain.size(), encrypted);
+    }
+
+    // upper bound of the record bytes for size plain bytes
+    static int maxEncryptedSize(int size)
+    {
+        return size + (size / MaxRecordSize + 1) * MaxRecordOverhead;
+    }
+
+    static const int MaxRecordSize     = 16384;
+    static const int MaxRecordOverhead = 256;    // header, content type, MAC / tag and padding
+
+    // Returns false, if the keys cannot be exported (not enabled, handshake running, partial record buffered, ...).
+    // After the records are protected by someone else, this stream must not be used anymore.
+    virtual bool trafficKeys(TLSTrafficKeys & keys) { Q_UNUSED(keys) return false; }
 };
 
 }}    // namespace
@@ -22,6 +22,60 @@ namespace {
 
 const QRegularExpression ipRe("^(?:\\d+\\.\\d+\\.\\d+\\.\\d+|[:0-9A-Fa-f]+)$");
 
+class Cache
+{
+public:
+    Cache() : positiveTTL_(60), negativeTTL_(5) {}
+
+    bool get(const QByteArray & name, bool preferIPv6, QList<QByteArray> & ips)
+    {
+        QMutexLocker ml(&mutex_);
+        QHash<QPair<QByteArray, bool>, Entry>::const_iterator it = entries_.constFind(qMakePair(name, preferIPv6));
+        if (it == entries_.constEnd() || it->expires.hasExpired()) return false;
+        ips = it->ips;
+        return true;
+    }
+
+    void set(const QByteArray & name, bool preferIPv6, const QList<QByteArray> & ips)
+    {
+        QMutexLocker ml(&mutex_);
+        // drop expired entries from time to time
+        if (entries_.size() >= 0x1000) {
+            QMutableHashIterator<QPair<QByteArray, bool>, Entry> it(entries_);
+            while (it.hasNext()) if (it.next().value().expires.hasExpired()) it.remove();
+        }
+        Entry & entry = entries_[qMakePair(name, preferIPv6)];
+        entry.ips = ips;
+        entry.expires.setRemainingTime((qint64)(ips.isEmpty() ? negativeTTL_ : positiveTTL_) * 1000);
+    }
+
+    void setTTL(uint positiveSecs, uint negativeSecs)
+    {
+        QMutexLocker ml(&mutex_);
+        positiveTTL_ = positiveSecs;
+        negativeTTL_ = negativeSecs;
+    }
+
+    void clear()
+    {
+        QMutexLocker ml(&mutex_);
+        entries_.clear();
+    }
+
+private:
+    struct Entry {
+        QList<QByteArray> ips;
+        QDeadlineTimer expires;
+    };
+
+    QMutex mutex_;
+    uint positiveTTL_;
+    uint negativeTTL_;
+    QHash<QPair<QByteArray, bool>, Entry> entries_;
+};
+
+Q_GLOBAL_STATIC(Cache, cache)
+
 }
 
 QList<QByteArray> getIPFromDNS(const QByteArray & name, bool preferIPv6)
@@ -40,13 +94,13 @@ QList<QByteArray> getIPFromDNS(const QByteArray & name, bool preferIPv6)
 
     QSet<QByteArray> ipv4;
     QSet<QByteArray> ipv6;
-    for ( ; res ; res = res->ai_next) {
+    for (struct addrinfo * ai = res ; ai ; ai = ai->ai_next) {
         char ip[40];
-        if (res->ai_family == AF_INET) {
-            inet_ntop(AF_INET, &((struct sockaddr_in *)res->ai_addr)->sin_addr, ip, sizeof(ip));
+        if (ai->ai_family == AF_INET) {
+            inet_ntop(AF_INET, &((struct sockaddr_in *)ai->ai_addr)->sin_addr, ip, sizeof(ip));
             ipv4 << ip;
-        } else if (res->ai_family == AF_INET6) {
-            inet_ntop(AF_INET6, &((struct sockaddr_in6 *)res->ai_addr)->sin6_addr, ip, sizeof(ip));
+        } else if (ai->ai_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr, ip, sizeof(ip));
             ipv6 << ip;
         }
     }
@@ -59,4 +113,74 @@ QList<QByteArray> getIPFromDNS(const QByteArray & name, bool preferIPv6)
     return rv;
 }
 
+QList<QByteArray> getCachedIPFromDNS(const QByteArray & name, bool preferIPv6)
+{
+    QList<QByteArray> rv;
+    if (ipRe.match(name).hasMatch()) return rv << name;
+    if (cache()->get(name, preferIPv6, rv)) return rv;
+    rv = getIPFromDNS(name, preferIPv6);
+    cache()->set(name, preferIPv6, rv);
+    return rv;
+}
+
+DNSResolver::DNSResolver(uint threadCount) :
+    ThreadVerify("DNSResolver", ThreadVerify::Worker, threadCount)
+{
+}
+
+DNSResolver::~DNSResolver()
+{
+    stopVerifyThread();
+}
+
+void DNSResolver::resolve(const QByteArray & name, bool preferIPv6, const Callback & callback)
+{
+    QList<QByteArray> ips;
+    if (ipRe.match(name).hasMatch()) {
+        callback(ips << name);
+        return;
+    }
+    if (cached(name, preferIPv6, ips)) {
+        callback(ips);
+        return;
+    }
+
+    {
+        QMutexLocker ml(&mutex_);
+        QList<Callback> & callbacks = pending_[qMakePair(name, preferIPv6)];
+        callbacks << callback;
+        if (callbacks.size() > 1) return;
+    }
+    lookup(name, preferIPv6);
+}
+
+bool DNSResolver::cached(const QByteArray & name, bool preferIPv6, QList<QByteArray> & ips)
+{
+    return cache()->get(name, preferIPv6, ips);
+}
+
+void DNSResolver::setCacheTTL(uint positiveSecs, uint negativeSecs)
+{
+    cache()->setTTL(positiveSecs, negativeSecs);
+}
+
+void DNSResolver::clearCache()
+{
+    cache()->clear();
+}
+
+void DNSResolver::lookup(const QByteArray & name, bool preferIPv6)
+{
+    if (!verifyThreadCall(&DNSResolver::lookup, name, preferIPv6)) return;
+
+    const QList<QByteArray> ips = getCachedIPFromDNS(name, preferIPv6);
+
+    QList<Callback> callbacks;
+    {
+        QMutexLocker ml(&mutex_);
+        callbacks = pending_.take(qMakePair(name, preferIPv6));
+    }
+    foreach (const Callback & callback, callbacks) callback(ips);
+}
+
 }}    // namespace
@@ -7,11 +7,47 @@
 
 #pragma once
 
-#include <QtCore>
+#include <cflib/util/threadverify.h>
+
+#include <functional>
 
 namespace cflib { namespace net {
 
 // Attention: this function may need some time (blocks)
 QList<QByteArray> getIPFromDNS(const QByteArray & name, bool preferIPv6 = false);
 
+// Like getIPFromDNS, but uses the process wide cache of DNSResolver (blocks only on cache misses).
+QList<QByteArray> getCachedIPFromDNS(const QByteArray & name, bool preferIPv6 = false);
+
+// Non blocking name resolution: getaddrinfo runs in the resolver threads.
+// Results are cached process wide. getaddrinfo does not report record TTLs,
+// so addresses are kept for positiveTTL seconds and failed lookups for negativeTTL seconds.
+// Concurrent lookups of the same name are merged.
+class DNSResolver : public util::ThreadVerify
+{
+public:
+    // ips is empty, if the name could not be resolved
+    typedef std::function<void (const QList<QByteArray> & ips)> Callback;
+
+public:
+    DNSResolver(uint threadCount = 2);
+    ~DNSResolver();
+
+    // callback is called directly for IP addresses and cached names, otherwise in a resolver thread
+    void resolve(const QByteArray & name, bool preferIPv6, const Callback & callback);
+
+    // returns false, if name is not cached (or expired)
+    static bool cached(const QByteArray & name, bool preferIPv6, QList<QByteArray> & ips);
+    static void setCacheTTL(uint positiveSecs, uint negativeSecs);
+    static void clearCache();
+
+private:
+    void lookup(const QByteArray & name, bool preferIPv6);
+
+private:
+    typedef QPair<QByteArray, bool> Key;
+    QMutex mutex_;
+    QHash<Key, QList<Callback>> pending_;
+};
+
 }}    // namespace
@@ -18,6 +18,9 @@ namespace cflib { namespace net {
 
 namespace {
 
+// bigger files are not compressed
+const qint64 MaxCompressedSize = 0x1000000;    // 16mb
+
 QStringList splitParams(const QString & param)
 {
     QStringList retval;
@@ -242,18 +245,10 @@ void FileServer::handleRequest(const Request & request)
         return;
     }
 
-    QByteArray replyData;
-    if (!request.isHEAD()) {
-        if (parseHtml_ && (
-            fullPath.endsWith(".css") ||
-            fullPath.endsWith(".js" ) ||
-            fullPath.endsWith(".mjs")))
-        {
-            replyData = parseHtml(fullPath, false, path).toUtf8();
-        } else {
-            replyData = util::readFile(fullPath);
-        }
-    }
+    const bool parse = parseHtml_ && (
+        fullPath.endsWith(".css") ||
+        fullPath.endsWith(".js" ) ||
+        fullPath.endsWith(".mjs"));
 
     // deliver static content
     bool cache = true;
@@ -284,8 +279,16 @@ void FileServer::handleRequest(const Request & request)
         request.addHeaderLine("Cache-Control: no-cache");
         if (!noCache_) request.addHeaderLine("ETag: " << eTag_);
     }
-    if (request.isHEAD()) request.sendReply("", contentType);
-    else                  request.sendReply(replyData, contentType, compression);
+    if (request.isHEAD()) {
+        request.sendReply("", contentType);
+    } else if (parse) {
+        request.sendReply(parseHtml(fullPath, false, path).toUtf8(), contentType, compression);
+    } else if (!compression || fi.size() > MaxCompressedSize) {
+        // sent by the kernel without reading it
+        if (!request.sendFile(fullPath, contentType)) logInfo("cannot open file: %1", fullPath);
+    } else {
+        request.sendReply(util::readFile(fullPath), contentType, compression);
+    }
 }
 
 QString FileServer::parseHtml(const QString & fullPath, bool isPart, const QString & path,
@@ -20,7 +20,59 @@ namespace cflib { namespace net {
 namespace {
 
 const QRegularExpression lengthRE("\r?\nContent-Length: (\\d+)\r?\n", QRegularExpression::CaseInsensitiveOption);
-const QRegularExpression statusRE("^HTTP/1.[01] (\\d+)");
+const QRegularExpression statusRE("^HTTP/1\\.([01]) (\\d+)");
+const QRegularExpression keepAliveRE("\r?\nConnection: *keep-alive\r?\n", QRegularExpression::CaseInsensitiveOption);
+const QRegularExpression closeRE("\r?\nConnection: *close\r?\n", QRegularExpression::CaseInsensitiveOption);
+const QRegularExpression connectionRE("^Connection:", QRegularExpression::CaseInsensitiveOption);
+
+QByteArray buildRequest(const QUrl & url, const QList<QByteArray> & headers,
+    const QByteArray & postData, const QByteArray & contentType, bool & keepAlive)
+{
+    // GET / POST
+    QByteArray request = postData.isNull() ? "GET " : "POST ";
+
+    // path
+    request += url.path().isEmpty() ? "/" : url.path(QUrl::FullyEncoded).toUtf8();
+
+    // query
+    if (url.hasQuery()) request += "?" + url.query(QUrl::FullyEncoded).toUtf8();
+    request += " HTTP/1.0\r\n";
+
+    // host
+    request += "Host: " + url.host(QUrl::FullyEncoded).toUtf8();
+    if (url.port() != -1) request += ":" + QByteArray::number(url.port());
+    request += "\r\n";
+
+    // login / password
+    if (!url.userInfo().isEmpty()) {
+        request += "Authorization: Basic " + url.userInfo().toUtf8().toBase64() + "\r\n";
+    }
+
+    // additional headers (the caller may decide about the reuse of the connection)
+    keepAlive = true;
+    bool hasConnection = false;
+    for (const QByteArray & header : headers) {
+        const QByteArray line = header.trimmed();
+        if (connectionRE.match(line).hasMatch()) {
+            hasConnection = true;
+            if (!line.toLower().contains("keep-alive")) keepAlive = false;
+        }
+        request += line + "\r\n";
+    }
+
+    // reuse of the connection (see TCPManager::openPooledConnection)
+    if (!hasConnection) request += "Connection: keep-alive\r\n";
+
+    if (postData.isNull()) {
+        request += "\r\n";
+    } else {
+        request += "Content-Length: " + QByteArray::number(postData.size()) + "\r\n";
+        request += "Content-Type: " + contentType + "\r\n";
+        request += "\r\n";
+        request += postData;
+    }
+    return request;
+}
 
 }
 
@@ -28,48 +80,16 @@ class HttpRequest::Conn : public TCPConn, public util::ThreadVerify
 {
 public:
     Conn(HttpRequest * parent, TCPConnData * data,
-        const QUrl & url, const QList<QByteArray> & headers,
-        const QByteArray & postData, const QByteArray & contentType,
-        uint timeoutMs)
+        const QByteArray & request, bool keepAlive, uint timeoutMs, bool reused)
     :
         TCPConn(data),
-        ThreadVerify(manager().networkThread()),
+        ThreadVerify(networkThread()),
         timeout_(this, &Conn::timeout),
         parent_(parent),
+        keepAlive_(keepAlive),
+        reused_(reused),
         gotReply_(false)
     {
-        // GET / POST
-        QByteArray request = postData.isNull() ? "GET " : "POST ";
-
-        // path
-        request += url.path().isEmpty() ? "/" : url.path(QUrl::FullyEncoded).toUtf8();
-
-        // query
-        if (url.hasQuery()) request += "?" + url.query(QUrl::FullyEncoded).toUtf8();
-        request += " HTTP/1.0\r\n";
-
-        // host
-        request += "Host: " + url.host(QUrl::FullyEncoded).toUtf8();
-        if (url.port() != -1) request += ":" + QByteArray::number(url.port());
-        request += "\r\n";
-
-        // login / password
-        if (!url.userInfo().isEmpty()) {
-            request += "Authorization: Basic " + url.userInfo().toUtf8().toBase64() + "\r\n";
-        }
-
-        // additional headers
-        for (const QByteArray & header : headers) request += header.trimmed() + "\r\n";
-
-        if (postData.isNull()) {
-            request += "\r\n";
-        } else {
-            request += "Content-Length: " + QByteArray::number(postData.size()) + "\r\n";
-            request += "Content-Type: " + contentType + "\r\n";
-            request += "\r\n";
-            request += postData;
-        }
-
         logTrace("sending: %1", request);
         write(request);
 
@@ -121,11 +141,25 @@ protected:
             return;
         }
 
-        const int status = match.captured(1).toInt();
+        const bool isHttp11 = match.captured(1) == "1";
+        const int status = match.captured(2).toInt();
 
         if (parent_) parent_->reply(status, buf_.mid(headerEndPos + 4, length));
         gotReply_ = true;
         timeout_.stop();
+
+        // connection can be used for the next request
+        // (HTTP/1.1 keeps it open unless told otherwise, HTTP/1.0 only if told so)
+        const QByteArray header = buf_.left(headerEndPos + 2);
+        const bool keepAlive = isHttp11 ? !closeRE.match(header).hasMatch() : keepAliveRE.match(header).hasMatch();
+        if (keepAlive_ && keepAlive && buf_.size() == headerEndPos + 4 + length) {
+            if (parent_) parent_->conn_ = 0;
+            TCPManager & mgr = manager();
+            mgr.releaseConnection(detach());
+            util::deleteNext(this);
+            return;
+        }
+
         close(ReadWriteClosed, true);
     }
 
@@ -136,8 +170,10 @@ protected:
         logFunctionTrace
 
         if (parent_) {
-            if (!gotReply_) parent_->reply(503, "Service Unavailable");
             parent_->conn_ = 0;
+            // the peer may close an idle connection at any time: try once more on a new one
+            if      (!gotReply_ && reused_ && buf_.isEmpty()) parent_->retry();
+            else if (!gotReply_)                             parent_->reply(503, "Service Unavailable");
         }
         timeout_.stop();
         util::deleteNext(this);
@@ -158,6 +194,8 @@ private:
 private:
     util::EVTimer timeout_;
     HttpRequest * parent_;
+    const bool keepAlive_;
+    const bool reused_;
     bool gotReply_;
     QByteArray buf_;
 };
@@ -165,7 +203,11 @@ private:
 HttpRequest::HttpRequest(TCPManager & mgr) :
     ThreadVerify(mgr.networkThread()),
     mgr_(mgr),
-    conn_(0)
+    conn_(0),
+    port_(0),
+    tls_(false),
+    keepAlive_(true),
+    timeoutMs_(0)
 {
 }
 
@@ -187,22 +229,30 @@ void HttpRequest::start(const QUrl & url, const QList<QByteArray> & headers,
         return;
     }
 
-    TCPConnData * cd;
-    if (url.scheme() == "http") {
-        cd = mgr_.openConnection(
-            url.host(QUrl::FullyEncoded).toUtf8(),
-            url.port() != -1 ? url.port() : 80);
-    } else {
-        cd = mgr_.openTLSConnection(
-        url.host(QUrl::FullyEncoded).toUtf8(),
-        url.port() != -1 ? url.port() : 443);
+    host_ = url.host(QUrl::FullyEncoded).toUtf8();
+    tls_ = url.scheme() != "http";
+    port_ = url.port() != -1 ? url.port() : tls_ ? 443 : 80;
+    request_ = buildRequest(url, headers, postData, contentType, keepAlive_);
+    timeoutMs_ = timeoutMs;
+
+    bool reused = false;
+    TCPConnData * cd = mgr_.openPooledConnection(host_, port_, tls_, false, &reused);
+    if (!cd) {
+        reply(503, "Service Unavailable");
+        return;
     }
+    conn_ = new Conn(this, cd, request_, keepAlive_, timeoutMs_, reused);
+}
 
+void HttpRequest::retry()
+{
+    logDebug("retrying request to %1:%2 on a new connection", host_, port_);
+    TCPConnData * cd = tls_ ? mgr_.openTLSConnection(host_, port_) : mgr_.openConnection(host_, port_);
     if (!cd) {
         reply(503, "Service Unavailable");
         return;
     }
-    conn_ = new Conn(this, cd, url, headers, postData, contentType, timeoutMs);
+    conn_ = new Conn(this, cd, request_, keepAlive_, timeoutMs_, false);
 }
 
 void HttpRequest::destroy()
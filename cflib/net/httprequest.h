@@ -36,12 +36,20 @@ cfsignals:
     sig<void (int status, const QByteArray & reply)> reply;
 
 private:
+    void retry();
     void destroy();
 
 private:
     TCPManager & mgr_;
     class Conn;
     Conn * conn_;
+    // current request (for the retry after a reused connection got closed)
+    QByteArray host_;
+    quint16 port_;
+    bool tls_;
+    QByteArray request_;
+    bool keepAlive_;
+    uint timeoutMs_;
 };
 
 }}    // namespace
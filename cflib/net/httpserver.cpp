@@ -18,8 +18,8 @@ namespace cflib { namespace net {
 class HttpServer::Impl : public TCPManager
 {
 public:
-    Impl(uint threadCount, uint tlsThreadCount) :
-        TCPManager(tlsThreadCount),
+    Impl(uint threadCount, uint tlsThreadCount, uint reactorCount) :
+        TCPManager(tlsThreadCount, 0, reactorCount),
         threadCounter_(0)
     {
         for (uint i = 1 ; i <= threadCount ; ++i) threads_.append(new impl::HttpThread(i, threadCount));
@@ -39,17 +39,18 @@ public:
 protected:
     virtual void newConnection(TCPConnData * data)
     {
-        threads_[++threadCounter_ % threads_.size()]->newRequest(data, handlers_);
+        // called by all reactor threads
+        threads_[(threadCounter_.fetchAndAddRelaxed(1) + 1) % threads_.size()]->newRequest(data, handlers_);
     }
 
 private:
     QVector<impl::HttpThread *> threads_;
-    uint threadCounter_;
+    QAtomicInteger<uint> threadCounter_;
     QList<RequestHandler *> handlers_;
 };
 
-HttpServer::HttpServer(uint threadCount, uint tlsThreadCount) :
-    impl_(new Impl(threadCount, tlsThreadCount))
+HttpServer::HttpServer(uint threadCount, uint tlsThreadCount, uint reactorCount) :
+    impl_(new Impl(threadCount, tlsThreadCount, reactorCount))
 {
 }
 
@@ -93,4 +94,24 @@ void HttpServer::registerHandler(RequestHandler & handler)
     impl_->registerHandler(handler);
 }
 
+void HttpServer::setTLSSessionResumption(uint ticketKeyLifetimeSec, uint maxCachedSessions)
+{
+    impl_->setTLSSessionResumption(ticketKeyLifetimeSec, maxCachedSessions);
+}
+
+const crypt::TLSSessions & HttpServer::tlsServerSessions() const
+{
+    return impl_->tlsServerSessions();
+}
+
+void HttpServer::setKernelTLS(bool enable)
+{
+    impl_->setKernelTLS(enable);
+}
+
+void HttpServer::setTLSHandshakeThreads(uint threadCount, uint maxPendingHandshakes)
+{
+    impl_->setTLSHandshakeThreads(threadCount, maxPendingHandshakes);
+}
+
 }}    // namespace
@@ -9,7 +9,7 @@
 
 #include <QtCore>
 
-namespace cflib { namespace crypt { class TLSCredentials; }}
+namespace cflib { namespace crypt { class TLSCredentials; class TLSSessions; }}
 
 namespace cflib { namespace net {
 
@@ -19,7 +19,8 @@ class HttpServer
 {
     Q_DISABLE_COPY(HttpServer)
 public:
-    HttpServer(uint threadCount = 2, uint tlsThreadCount = 0);
+    // reactorCount: see TCPManager
+    HttpServer(uint threadCount = 2, uint tlsThreadCount = 0, uint reactorCount = 1);
     ~HttpServer();
 
     bool start(const QByteArray & address, quint16 port);
@@ -31,6 +32,12 @@ public:
 
     void registerHandler(RequestHandler & handler);
 
+    // see TCPManager
+    void setTLSSessionResumption(uint ticketKeyLifetimeSec, uint maxCachedSessions = 10000);
+    const crypt::TLSSessions & tlsServerSessions() const;
+    void setKernelTLS(bool enable);
+    void setTLSHandshakeThreads(uint threadCount, uint maxPendingHandshakes = 0);
+
 private:
     class Impl;
     Impl * impl_;
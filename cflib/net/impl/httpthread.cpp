@@ -28,21 +28,20 @@ HttpThread::~HttpThread()
 
 void HttpThread::newRequest(TCPConnData * data, const QList<RequestHandler *> & handlers)
 {
-    ++activeRequests_;
+    activeRequests_.fetchAndAddOrdered(1);
     new impl::RequestParser(data, handlers, this);
 }
 
 void HttpThread::requestFinished()
 {
-    --activeRequests_;
-    if (shutdown_ && activeRequests_ == 0) sem_.release();
+    if (activeRequests_.fetchAndSubOrdered(1) == 1 && shutdown_) sem_.release();
 }
 
 void HttpThread::waitForRequestsToFinish()
 {
     if (!verifyThreadCall(&HttpThread::waitForRequestsToFinish)) return;
 
-    if (activeRequests_ == 0) sem_.release();
+    if (activeRequests_.loadAcquire() == 0) sem_.release();
     else shutdown_ = true;
 }
 
@@ -29,7 +29,7 @@ private:
     void waitForRequestsToFinish();
 
 private:
-    uint activeRequests_;
+    QAtomicInteger<uint> activeRequests_;    // incremented by all reactors
     bool shutdown_;
     QSemaphore sem_;
 };
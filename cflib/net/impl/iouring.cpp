@@ -0,0 +1,838 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include "iouring.h"
+
+#include <cflib/net/impl/tcpconndata.h>
+#include <cflib/net/impl/tcpmanagerimpl.h>
+#include <cflib/util/libev.h>
+#include <cflib/util/log.h>
+
+#ifdef Q_OS_LINUX
+    #include <arpa/inet.h>
+    #include <errno.h>
+    #include <linux/io_uring.h>
+    #include <netinet/in.h>
+    #include <poll.h>
+    #include <stdio.h>
+    #include <string.h>
+    #include <sys/eventfd.h>
+    #include <sys/mman.h>
+    #include <sys/resource.h>
+    #include <sys/socket.h>
+    #include <sys/syscall.h>
+    #include <sys/uio.h>
+    #include <sys/utsname.h>
+    #include <unistd.h>
+#endif
+
+USE_LOG(LogCat::Network)
+
+namespace cflib { namespace net { namespace impl {
+
+#ifdef Q_OS_LINUX
+
+namespace {
+
+const uint RingEntries  = 1024;
+const uint BufferCount  = 256;       // power of 2
+const uint BufferSize   = 0x4000;    // 16kb
+const uint BufferGroup  = 0;
+const uint MaxFileSlots = 0x10000;
+
+// operation of a submission in the lower bits of user_data
+enum Op { Ignore = 0, Accept = 1, Recv = 2, Send = 3, OpMask = 3 };
+
+inline quint64 userData(const void * ptr, Op op)
+{
+    return (quint64)(quintptr)ptr | op;
+}
+
+inline int registerResource(int fd, uint opcode, const void * arg, uint nrArgs)
+{
+    TCPConnData::ioSyscalls.fetchAndAddRelaxed(1);
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+// multishot recv needs Linux 6.0
+bool kernelSupported()
+{
+    struct utsname name;
+    if (uname(&name) != 0) return false;
+    int major = 0;
+    if (sscanf(name.release, "%d", &major) != 1) return false;
+    return major >= 6;
+}
+
+}
+
+// one io_uring instance with mapped rings, provided buffers and fixed file table
+class IOUringRing
+{
+public:
+    IOUringRing();
+    ~IOUringRing();
+
+    bool init();
+
+    // returns 0, if the submission queue is full
+    io_uring_sqe * sqe();
+    bool hasUnsubmitted() const { return sqTailLocal_ != sqSubmitted_; }
+    void submit(uint waitFor = 0);
+    bool completion(io_uring_cqe & cqe);
+    bool overflown() const { return __atomic_load_n(sqFlags_, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW; }
+
+    const char * buffer(uint bid) const { return buffers_ + bid * BufferSize; }
+    void recycle(uint bid);
+
+    // returns -1, if there is no free slot
+    int registerFile(int fd);
+    void unregisterFile(int slot);
+
+    int fd;
+    int eventFd;
+
+private:
+    void addBuffer(uint bid);
+
+private:
+    void * ring_;
+    size_t ringSize_;
+    io_uring_sqe * sqes_;
+    size_t sqesSize_;
+    uint * sqHead_;
+    uint * sqTail_;
+    uint * sqFlags_;
+    uint * sqArray_;
+    uint sqMask_;
+    uint sqEntries_;
+    uint sqTailLocal_;
+    uint sqSubmitted_;
+    uint * cqHead_;
+    uint * cqTail_;
+    uint cqMask_;
+    io_uring_cqe * cqes_;
+    io_uring_buf_ring * bufRing_;
+    char * buffers_;
+    quint16 bufTail_;
+    QVector<int> freeSlots_;
+};
+
+IOUringRing::IOUringRing() :
+    fd(-1), eventFd(-1),
+    ring_(0), ringSize_(0), sqes_(0), sqesSize_(0),
+    sqHead_(0), sqTail_(0), sqFlags_(0), sqArray_(0), sqMask_(0), sqEntries_(0), sqTailLocal_(0), sqSubmitted_(0),
+    cqHead_(0), cqTail_(0), cqMask_(0), cqes_(0),
+    bufRing_(0), buffers_(0), bufTail_(0)
+{
+}
+
+IOUringRing::~IOUringRing()
+{
+    // closing the ring unregisters buffers, files and eventfd
+    if (fd != -1) close(fd);
+    if (eventFd != -1) close(eventFd);
+    if (sqes_) munmap(sqes_, sqesSize_);
+    if (ring_) munmap(ring_, ringSize_);
+    if (bufRing_) munmap(bufRing_, BufferCount * sizeof(io_uring_buf));
+    delete[] buffers_;
+}
+
+bool IOUringRing::init()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+    params.cq_entries = RingEntries * 4;
+    fd = (int)syscall(__NR_io_uring_setup, RingEntries, &params);
+    if (fd < 0) {
+        logInfo("io_uring_setup failed (%1 - %2)", errno, strerror(errno));
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) return false;
+
+    // rings
+    ringSize_ = qMax(params.sq_off.array + params.sq_entries * sizeof(uint),
+                     params.cq_off.cqes  + params.cq_entries * sizeof(io_uring_cqe));
+    ring_ = mmap(0, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring_ == MAP_FAILED) {
+        ring_ = 0;
+        return false;
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void * sqes = mmap(0, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    sqes_ = (io_uring_sqe *)sqes;
+
+    char * ring = (char *)ring_;
+    sqHead_      = (uint *)(ring + params.sq_off.head);
+    sqTail_      = (uint *)(ring + params.sq_off.tail);
+    sqFlags_     = (uint *)(ring + params.sq_off.flags);
+    sqArray_     = (uint *)(ring + params.sq_off.array);
+    sqMask_      = *(uint *)(ring + params.sq_off.ring_mask);
+    sqEntries_   = params.sq_entries;
+    sqTailLocal_ = sqSubmitted_ = *sqTail_;
+    cqHead_      = (uint *)(ring + params.cq_off.head);
+    cqTail_      = (uint *)(ring + params.cq_off.tail);
+    cqMask_      = *(uint *)(ring + params.cq_off.ring_mask);
+    cqes_        = (io_uring_cqe *)(ring + params.cq_off.cqes);
+
+    // provided buffers for recv
+    void * bufRing = mmap(0, BufferCount * sizeof(io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufRing == MAP_FAILED) return false;
+    bufRing_ = (io_uring_buf_ring *)bufRing;
+    buffers_ = new char[BufferCount * BufferSize];
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (quint64)(quintptr)bufRing_;
+    reg.ring_entries = BufferCount;
+    reg.bgid         = BufferGroup;
+    if (registerResource(fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        logInfo("cannot register provided buffers (%1 - %2)", errno, strerror(errno));
+        return false;
+    }
+    for (uint i = 0 ; i < BufferCount ; ++i) addBuffer(i);
+    __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+
+    // every completion signals the eventfd
+    // (EVENTFD_ASYNC would miss socket completions, which are not done by io-wq workers)
+    eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventFd < 0 || registerResource(fd, IORING_REGISTER_EVENTFD, &eventFd, 1) < 0) {
+        logInfo("cannot register eventfd (%1 - %2)", errno, strerror(errno));
+        return false;
+    }
+
+    // sparse table of fixed files (optional)
+    uint slots = MaxFileSlots;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < slots) slots = (uint)limit.rlim_cur;
+    io_uring_rsrc_register files;
+    memset(&files, 0, sizeof(files));
+    files.nr    = slots;
+    files.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (registerResource(fd, IORING_REGISTER_FILES2, &files, sizeof(files)) == 0) {
+        freeSlots_.reserve(slots);
+        for (int i = slots - 1 ; i >= 0 ; --i) freeSlots_ << i;
+    } else {
+        logInfo("no fixed files for io_uring (%1 - %2)", errno, strerror(errno));
+    }
+
+    return true;
+}
+
+io_uring_sqe * IOUringRing::sqe()
+{
+    if (sqTailLocal_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        submit();
+        if (sqTailLocal_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) return 0;
+    }
+    const uint index = sqTailLocal_ & sqMask_;
+    sqArray_[index] = index;
+    ++sqTailLocal_;
+    io_uring_sqe * rv = &sqes_[index];
+    memset(rv, 0, sizeof(*rv));
+    return rv;
+}
+
+void IOUringRing::submit(uint waitFor)
+{
+    const uint toSubmit = sqTailLocal_ - sqSubmitted_;
+    const bool flush = overflown();
+    if (toSubmit == 0 && waitFor == 0 && !flush) return;
+
+    __atomic_store_n(sqTail_, sqTailLocal_, __ATOMIC_RELEASE);
+    TCPConnData::ioSyscalls.fetchAndAddRelaxed(1);
+    const int rv = (int)syscall(__NR_io_uring_enter, fd, toSubmit, waitFor,
+        waitFor > 0 || flush ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+    if (rv < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            logWarn("io_uring_enter failed (%1 - %2)", errno, strerror(errno));
+        }
+        return;
+    }
+    sqSubmitted_ += rv;
+}
+
+bool IOUringRing::completion(io_uring_cqe & cqe)
+{
+    const uint head = *cqHead_;
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) return false;
+    cqe = cqes_[head & cqMask_];
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void IOUringRing::recycle(uint bid)
+{
+    addBuffer(bid);
+    __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+}
+
+void IOUringRing::addBuffer(uint bid)
+{
+    // not bufRing_->bufs: its flexible array has an offset in C++
+    io_uring_buf & buf = ((io_uring_buf *)bufRing_)[bufTail_ & (BufferCount - 1)];
+    buf.addr = (quint64)(quintptr)(buffers_ + bid * BufferSize);
+    buf.len  = BufferSize;
+    buf.bid  = bid;
+    ++bufTail_;
+}
+
+int IOUringRing::registerFile(int file)
+{
+    if (freeSlots_.isEmpty()) return -1;
+    const int slot = freeSlots_.takeLast();
+    io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.fds    = (quint64)(quintptr)&file;
+    if (registerResource(fd, IORING_REGISTER_FILES_UPDATE, &update, 1) != 1) {
+        freeSlots_ << slot;
+        return -1;
+    }
+    return slot;
+}
+
+void IOUringRing::unregisterFile(int slot)
+{
+    int file = -1;
+    io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.fds    = (quint64)(quintptr)&file;
+    registerResource(fd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+    freeSlots_ << slot;
+}
+
+// ============================================================================
+
+class IOUringConn
+{
+public:
+    IOUringConn() :
+        slot(-1), inflight(0),
+        recv(false), recvCancelled(false), armed(false), send(false), polling(false), eof(false), remove(false),
+        error(0)
+    {
+        memset(&msg, 0, sizeof(msg));
+    }
+
+    int slot;              // fixed file or -1
+    int inflight;          // submitted operations
+    bool recv;             // multishot recv is active
+    bool recvCancelled;
+    bool armed;            // waiting for data (startRead)
+    bool send;             // sendmsg is active
+    bool polling;          // send is a poll for a file segment
+    bool eof;
+    bool remove;           // delete connection after last completion
+    int error;
+    QByteArray received;   // received while not armed
+    QVector<iovec> vec;
+    QList<QByteArray> sending;    // keeps data of active sendmsg alive
+    msghdr msg;
+};
+
+IOUringEngine * IOUringEngine::create(TCPReactor & reactor)
+{
+    if (!kernelSupported()) return 0;
+    IOUringRing * ring = new IOUringRing();
+    if (!ring->init()) {
+        delete ring;
+        return 0;
+    }
+    return new IOUringEngine(reactor, ring);
+}
+
+IOUringEngine::IOUringEngine(TCPReactor & reactor, IOUringRing * ring) :
+    reactor_(reactor),
+    loop_(reactor.libEVLoop()),
+    ring_(ring),
+    completionWatcher_(new ev_io),
+    submitWatcher_(new ev_prepare),
+    deliverWatcher_(new ev_idle),
+    listenSock_(-1),
+    accepting_(false),
+    acceptActive_(false),
+    inflight_(0)
+{
+    TCPConnData::readBufferBytes.fetchAndAddRelaxed(BufferCount * BufferSize);
+
+    ev_io_init(completionWatcher_, &IOUringEngine::completionsAvailable, ring_->eventFd, EV_READ);
+    completionWatcher_->data = this;
+    ev_io_start(loop_, completionWatcher_);
+    ev_prepare_init(submitWatcher_, &IOUringEngine::beforeBlocking);
+    submitWatcher_->data = this;
+    ev_prepare_start(loop_, submitWatcher_);
+    ev_idle_init(deliverWatcher_, &IOUringEngine::deliverScheduled);
+    deliverWatcher_->data = this;
+}
+
+IOUringEngine::~IOUringEngine()
+{
+    ev_io_stop(loop_, completionWatcher_);
+    ev_prepare_stop(loop_, submitWatcher_);
+    ev_idle_stop(loop_, deliverWatcher_);
+
+    // the kernel must not use buffers and connections anymore
+    if (inflight_ > 0) {
+        if (io_uring_sqe * sqe = ring_->sqe()) {
+            sqe->opcode       = IORING_OP_ASYNC_CANCEL;
+            sqe->fd           = -1;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+        }
+        while (inflight_ > 0) {
+            ring_->submit(1);
+            io_uring_cqe cqe;
+            while (ring_->completion(cqe)) {
+                if ((cqe.user_data & OpMask) != Ignore && !(cqe.flags & IORING_CQE_F_MORE)) --inflight_;
+            }
+        }
+    }
+
+    foreach (TCPConnData * conn, conns_) {
+        IOUringConn * c = conn->uring;
+        TCPConnData::readBufferBytes.fetchAndSubRelaxed(c->received.size());
+        conn->uring = 0;
+        if (c->remove) delete conn;
+        delete c;
+    }
+    TCPConnData::readBufferBytes.fetchAndSubRelaxed(BufferCount * BufferSize);
+
+    delete ring_;
+    delete completionWatcher_;
+    delete submitWatcher_;
+    delete deliverWatcher_;
+}
+
+void IOUringEngine::startAccept(int listenSocket)
+{
+    listenSock_ = listenSocket;
+    accepting_ = true;
+    // a cancelled accept resubmits on completion
+    if (!acceptActive_) submitAccept();
+}
+
+void IOUringEngine::stopAccept()
+{
+    accepting_ = false;
+    if (acceptActive_) submitCancel(userData(this, Accept));
+}
+
+void IOUringEngine::addConn(TCPConnData * conn)
+{
+    IOUringConn * c = new IOUringConn();
+    c->slot = ring_->registerFile(conn->socket);
+    conn->uring = c;
+    conns_ << conn;
+}
+
+void IOUringEngine::startRead(TCPConnData * conn)
+{
+    IOUringConn & c = *conn->uring;
+    c.armed = true;
+    if (!c.received.isEmpty() || c.eof || c.error) scheduleDelivery(conn);
+    else if (!c.recv) submitRecv(conn);
+}
+
+void IOUringEngine::stopRead(TCPConnData * conn)
+{
+    IOUringConn & c = *conn->uring;
+    c.armed = false;
+    scheduled_.removeOne(conn);
+    if (c.recv && !c.recvCancelled) {
+        submitCancel(userData(conn, Recv));
+        c.recvCancelled = true;
+    }
+}
+
+bool IOUringEngine::isReading(const TCPConnData * conn) const
+{
+    return conn->uring->armed;
+}
+
+bool IOUringEngine::isReceiving(const TCPConnData * conn) const
+{
+    return conn->uring->recv;
+}
+
+void IOUringEngine::startWrite(TCPConnData * conn)
+{
+    if (!conn->uring->send) submitSend(conn);
+}
+
+bool IOUringEngine::isWriting(const TCPConnData * conn) const
+{
+    return conn->uring->send;
+}
+
+bool IOUringEngine::hasInput(const TCPConnData * conn) const
+{
+    const IOUringConn & c = *conn->uring;
+    return !c.received.isEmpty() || c.eof || c.error;
+}
+
+void IOUringEngine::closeSocket(TCPConnData * conn)
+{
+    IOUringConn & c = *conn->uring;
+    if (c.recv && !c.recvCancelled) {
+        submitCancel(userData(conn, Recv));
+        c.recvCancelled = true;
+    }
+    if (c.send) submitCancel(userData(conn, Send));
+    if (c.slot != -1) {
+        ring_->unregisterFile(c.slot);
+        c.slot = -1;
+    }
+}
+
+bool IOUringEngine::release(TCPConnData * conn)
+{
+    IOUringConn & c = *conn->uring;
+    scheduled_.removeOne(conn);
+    if (c.inflight > 0) {
+        c.remove = true;
+        c.armed = false;
+        closeSocket(conn);
+        return false;
+    }
+    dropState(conn);
+    return true;
+}
+
+void IOUringEngine::submitRecv(TCPConnData * conn)
+{
+    IOUringConn & c = *conn->uring;
+    io_uring_sqe * sqe = ring_->sqe();
+    if (!sqe) {
+        c.error = EAGAIN;
+        scheduleDelivery(conn);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    if (c.slot != -1) {
+        sqe->fd     = c.slot;
+        sqe->flags |= IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = conn->socket;
+    }
+    sqe->flags    |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BufferGroup;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->user_data = userData(conn, Recv);
+    c.recv = true;
+    c.recvCancelled = false;
+    ++c.inflight;
+    ++inflight_;
+}
+
+void IOUringEngine::submitSend(TCPConnData * conn)
+{
+    IOUringConn & c = *conn->uring;
+    io_uring_sqe * sqe = ring_->sqe();
+    if (!sqe) {
+        reactor_.writeFailed(conn, EAGAIN);
+        return;
+    }
+
+    // There is no sendfile operation: wait until the socket (or an empty pipe) is ready and send directly.
+    if (conn->writeBuf.fileAtHead()) {
+        const int pipe = conn->writeBuf.waitingPipe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        if (pipe != -1) {
+            sqe->fd = pipe;
+        } else if (c.slot != -1) {
+            sqe->fd     = c.slot;
+            sqe->flags |= IOSQE_FIXED_FILE;
+        } else {
+            sqe->fd = conn->socket;
+        }
+        sqe->poll32_events = pipe != -1 ? POLLIN : POLLOUT;
+        sqe->user_data     = userData(conn, Send);
+        c.send    = true;
+        c.polling = true;
+        ++c.inflight;
+        ++inflight_;
+        return;
+    }
+
+    // iovecs, msghdr and data stay untouched until completion
+    c.vec.resize(qMin(conn->writeBuf.segmentCount(), WriteQueue::MaxSegments));
+    const int count = conn->writeBuf.fill(c.vec.data(), c.vec.size());
+    c.sending = conn->writeBuf.head(count);
+    c.msg.msg_iov    = c.vec.data();
+    c.msg.msg_iovlen = count;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    if (c.slot != -1) {
+        sqe->fd     = c.slot;
+        sqe->flags |= IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = conn->socket;
+    }
+    sqe->addr      = (quint64)(quintptr)&c.msg;
+    sqe->len       = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = userData(conn, Send);
+    c.send = true;
+    ++c.inflight;
+    ++inflight_;
+}
+
+void IOUringEngine::submitCancel(quint64 target)
+{
+    io_uring_sqe * sqe = ring_->sqe();
+    if (!sqe) return;
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->fd        = -1;
+    sqe->addr      = target;
+    sqe->user_data = Ignore;
+}
+
+void IOUringEngine::submitAccept()
+{
+    io_uring_sqe * sqe = ring_->sqe();
+    if (!sqe) return;
+    sqe->opcode       = IORING_OP_ACCEPT;
+    sqe->fd           = listenSock_;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data    = userData(this, Accept);
+    acceptActive_ = true;
+    ++inflight_;
+}
+
+void IOUringEngine::processCompletions()
+{
+    forever {
+        io_uring_cqe cqe;
+        while (ring_->completion(cqe)) {
+            void * ptr = (void *)(quintptr)(cqe.user_data & ~(quint64)OpMask);
+            switch (cqe.user_data & OpMask) {
+                case Accept: acceptCompleted(cqe.res, cqe.flags);                  break;
+                case Recv:   recvCompleted((TCPConnData *)ptr, cqe.res, cqe.flags); break;
+                case Send:   sendCompleted((TCPConnData *)ptr, cqe.res);            break;
+                default:                                                            break;
+            }
+        }
+        if (!ring_->overflown()) return;
+        ring_->submit();
+    }
+}
+
+void IOUringEngine::recvCompleted(TCPConnData * conn, int res, uint flags)
+{
+    IOUringConn & c = *conn->uring;
+    if (!(flags & IORING_CQE_F_MORE)) {
+        c.recv = false;
+        --c.inflight;
+        --inflight_;
+    }
+
+    if (res > 0 && (flags & IORING_CQE_F_BUFFER)) {
+        const uint bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (!c.remove && !(conn->closeType & TCPConn::ReadClosed)) {
+            logTrace("read %1 raw bytes from %2", res, conn->socket);
+            TCPConnData::readBufferBytes.fetchAndAddRelaxed(res);
+            c.received.append(ring_->buffer(bid), res);
+            if (reactor_.impl.socketOptions.quickAck) TCPManagerImpl::rearmQuickAck(conn->socket);
+        }
+        ring_->recycle(bid);
+
+        // flow control: stop receiving until the data got read
+        if (!c.armed && c.recv && !c.recvCancelled && c.received.size() >= (int)conn->readBufferSize) {
+            submitCancel(userData(conn, Recv));
+            c.recvCancelled = true;
+        }
+    } else if (res == 0) {
+        logDebug("read channel closed on fd %1", conn->socket);
+        c.eof = true;
+    } else if (res != -ENOBUFS && res != -ECANCELED) {
+        c.error = -res;
+    }
+
+    // switch to kernel TLS waits for the last recv
+    if (!c.recv && conn->kernelTLSKeys && !c.remove) {
+        reactor_.continueKernelTLS(conn);
+        return;
+    }
+
+    if (finished(conn) || !c.armed) return;
+    if (!c.received.isEmpty() || c.eof || c.error) deliver(conn);
+    else if (!c.recv) submitRecv(conn);
+}
+
+void IOUringEngine::sendCompleted(TCPConnData * conn, int res)
+{
+    IOUringConn & c = *conn->uring;
+    const bool polled = c.polling;
+    c.send    = false;
+    c.polling = false;
+    c.sending.clear();
+    --c.inflight;
+    --inflight_;
+
+    if (finished(conn) || c.remove || res == -ECANCELED || (conn->closeType & TCPConn::WriteClosed)) return;
+    // TCP fast open has sent the SYN only
+    if (res == -EINPROGRESS) res = 0;
+    if (res < 0) {
+        reactor_.writeFailed(conn, -res);
+        return;
+    }
+    if (polled) {
+        TCPConnData::ioSyscalls.fetchAndAddRelaxed(1);
+        const qint64 count = conn->writeBuf.send(conn->socket);
+        if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            reactor_.writeFailed(conn, errno);
+            return;
+        }
+        reactor_.written(conn, qMax(count, (qint64)0));
+        return;
+    }
+    conn->writeBuf.consume(res);
+    reactor_.written(conn, res);
+}
+
+void IOUringEngine::acceptCompleted(int res, uint flags)
+{
+    if (!(flags & IORING_CQE_F_MORE)) {
+        acceptActive_ = false;
+        --inflight_;
+    }
+
+    if (res >= 0) {
+        if (!accepting_) {
+            close(res);
+        } else {
+            char ip[INET6_ADDRSTRLEN];
+            ip[0] = '\0';
+            quint16 port = 0;
+            struct sockaddr_storage addr;
+            socklen_t len = sizeof(addr);
+            TCPConnData::ioSyscalls.fetchAndAddRelaxed(1);
+            if (getpeername(res, (struct sockaddr *)&addr, &len) == 0) {
+                if (addr.ss_family == AF_INET6) {
+                    const struct sockaddr_in6 * a = (const struct sockaddr_in6 *)&addr;
+                    inet_ntop(AF_INET6, &a->sin6_addr, ip, sizeof(ip));
+                    port = ntohs(a->sin6_port);
+                } else {
+                    const struct sockaddr_in * a = (const struct sockaddr_in *)&addr;
+                    inet_ntop(AF_INET, &a->sin_addr, ip, sizeof(ip));
+                    port = ntohs(a->sin_port);
+                }
+            }
+            reactor_.accepted(res, ip, port);
+        }
+    } else if (res != -ECANCELED) {
+        logInfo("accept on fd %1 failed (%2 - %3)", listenSock_, -res, strerror(-res));
+    }
+
+    if (!acceptActive_ && accepting_) submitAccept();
+}
+
+bool IOUringEngine::finished(TCPConnData * conn)
+{
+    const IOUringConn & c = *conn->uring;
+    if (!c.remove || c.inflight > 0) return false;
+    dropState(conn);
+    delete conn;
+    return true;
+}
+
+void IOUringEngine::dropState(TCPConnData * conn)
+{
+    IOUringConn * c = conn->uring;
+    if (c->slot != -1) ring_->unregisterFile(c->slot);
+    TCPConnData::readBufferBytes.fetchAndSubRelaxed(c->received.size());
+    conns_.remove(conn);
+    conn->uring = 0;
+    delete c;
+}
+
+void IOUringEngine::deliver(TCPConnData * conn)
+{
+    IOUringConn & c = *conn->uring;
+    if (!c.received.isEmpty()) {
+        c.armed = false;
+        QByteArray data;
+        data.swap(c.received);
+        TCPConnData::readBufferBytes.fetchAndSubRelaxed(data.size());
+        reactor_.received(conn, data);
+    } else if (c.eof) {
+        reactor_.closeConn(conn, TCPConn::ReadClosed, false);
+    } else if (c.error == EIO && conn->kernelTLSRx) {
+        // kernel TLS: record without data (close_notify, KeyUpdate, ... see TCPManager::setKernelTLS)
+        logDebug("TLS record without data on fd %1", conn->socket);
+        reactor_.closeConn(conn, TCPConn::ReadClosed, false);
+    } else if (c.error) {
+        logInfo("read on fd %1 failed (%2 - %3)", conn->socket, c.error, strerror(c.error));
+        reactor_.closeConn(conn, TCPConn::HardClosed, false);
+    }
+}
+
+void IOUringEngine::scheduleDelivery(TCPConnData * conn)
+{
+    if (!scheduled_.contains(conn)) scheduled_ << conn;
+    ev_idle_start(loop_, deliverWatcher_);
+}
+
+void IOUringEngine::completionsAvailable(ev_loop *, ev_io * w, int)
+{
+    IOUringEngine * engine = (IOUringEngine *)w->data;
+    quint64 count;
+    TCPConnData::ioSyscalls.fetchAndAddRelaxed(1);
+    if (read(engine->ring_->eventFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        logWarn("cannot read eventfd (%1 - %2)", errno, strerror(errno));
+    }
+    engine->processCompletions();
+}
+
+void IOUringEngine::beforeBlocking(ev_loop *, ev_prepare * w, int)
+{
+    // all submissions of this loop iteration with one syscall
+    IOUringEngine * engine = (IOUringEngine *)w->data;
+    while (engine->ring_->hasUnsubmitted()) {
+        engine->ring_->submit();
+        engine->processCompletions();
+    }
+}
+
+void IOUringEngine::deliverScheduled(ev_loop * loop, ev_idle * w, int)
+{
+    IOUringEngine * engine = (IOUringEngine *)w->data;
+    ev_idle_stop(loop, w);
+    QList<TCPConnData *> conns;
+    conns.swap(engine->scheduled_);
+    foreach (TCPConnData * conn, conns) {
+        // might have been deleted by a previous delivery
+        if (!engine->conns_.contains(conn)) continue;
+        const IOUringConn & c = *conn->uring;
+        if (c.armed && !c.remove) engine->deliver(conn);
+    }
+}
+
+#else
+
+IOUringEngine * IOUringEngine::create(TCPReactor &) { return 0; }
+IOUringEngine::~IOUringEngine() {}
+void IOUringEngine::startAccept(int) {}
+void IOUringEngine::stopAccept() {}
+void IOUringEngine::addConn(TCPConnData *) {}
+void IOUringEngine::startRead(TCPConnData *) {}
+void IOUringEngine::stopRead(TCPConnData *) {}
+bool IOUringEngine::isReading(const TCPConnData *) const { return false; }
+bool IOUringEngine::isReceiving(const TCPConnData *) const { return false; }
+void IOUringEngine::startWrite(TCPConnData *) {}
+bool IOUringEngine::isWriting(const TCPConnData *) const { return false; }
+bool IOUringEngine::hasInput(const TCPConnData *) const { return false; }
+void IOUringEngine::closeSocket(TCPConnData *) {}
+bool IOUringEngine::release(TCPConnData *) { return true; }
+
+#endif
+
+}}}    // namespace
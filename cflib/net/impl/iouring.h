@@ -0,0 +1,96 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include <QtCore>
+
+struct ev_idle;
+struct ev_io;
+struct ev_loop;
+struct ev_prepare;
+
+namespace cflib { namespace net {
+
+class TCPConnData;
+
+namespace impl {
+
+class IOUringConn;
+class IOUringRing;
+class TCPReactor;
+
+// Completion based socket I/O of one TCPReactor (Linux >= 6.0, raw syscalls, no liburing):
+// - multishot accept on the listen socket
+// - multishot recv into a ring of provided buffers (no buffer per idle connection)
+// - sendmsg of the write queue (file segments: poll and sendfile / splice)
+// - all submissions of one loop iteration are sent with one io_uring_enter
+// - sockets are registered as fixed files
+// Completions are signaled by an eventfd watched by the libev loop of the reactor.
+// Must be created, used and deleted in the thread of the reactor.
+class IOUringEngine
+{
+    Q_DISABLE_COPY(IOUringEngine)
+public:
+    // returns 0, if io_uring is not available
+    static IOUringEngine * create(TCPReactor & reactor);
+    ~IOUringEngine();
+
+    void startAccept(int listenSocket);
+    void stopAccept();
+
+    void addConn(TCPConnData * conn);
+    // like readWatcher: exactly one bytesReceived / closeConn after startRead
+    void startRead(TCPConnData * conn);
+    void stopRead(TCPConnData * conn);
+    bool isReading(const TCPConnData * conn) const;
+    // a recv is submitted (may be cancelled already)
+    bool isReceiving(const TCPConnData * conn) const;
+    void startWrite(TCPConnData * conn);
+    bool isWriting(const TCPConnData * conn) const;
+    // received bytes, EOF or error which have not been delivered
+    bool hasInput(const TCPConnData * conn) const;
+    // must be called before the socket gets closed
+    void closeSocket(TCPConnData * conn);
+    // returns false, if the kernel still uses conn (it will be deleted later)
+    bool release(TCPConnData * conn);
+
+private:
+    IOUringEngine(TCPReactor & reactor, IOUringRing * ring);
+    void submitRecv(TCPConnData * conn);
+    void submitSend(TCPConnData * conn);
+    void submitCancel(quint64 userData);
+    void submitAccept();
+    void processCompletions();
+    void recvCompleted(TCPConnData * conn, int res, uint flags);
+    void sendCompleted(TCPConnData * conn, int res);
+    void acceptCompleted(int res, uint flags);
+    bool finished(TCPConnData * conn);
+    void dropState(TCPConnData * conn);
+    void deliver(TCPConnData * conn);
+    void scheduleDelivery(TCPConnData * conn);
+
+    static void completionsAvailable(ev_loop * loop, ev_io * w, int revents);
+    static void beforeBlocking(ev_loop * loop, ev_prepare * w, int revents);
+    static void deliverScheduled(ev_loop * loop, ev_idle * w, int revents);
+
+private:
+    TCPReactor & reactor_;
+    ev_loop * const loop_;
+    IOUringRing * const ring_;
+    ev_io * completionWatcher_;
+    ev_prepare * submitWatcher_;
+    ev_idle * deliverWatcher_;
+    int listenSock_;
+    bool accepting_;
+    bool acceptActive_;
+    int inflight_;    // submitted operations (without cancels)
+    QSet<TCPConnData *> conns_;
+    QList<TCPConnData *> scheduled_;
+};
+
+}}}    // namespace
@@ -12,6 +12,12 @@
 #include <cflib/util/log.h>
 #include <cflib/util/util.h>
 
+#ifdef Q_OS_WIN
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
 USE_LOG(LogCat::Http)
 
 namespace cflib { namespace net { namespace impl {
@@ -46,17 +52,18 @@ RequestParser::RequestParser(TCPConnData * data,
 RequestParser::~RequestParser()
 {
     logTrace("deleted RequestParser of connection %1", id_);
+    foreach (const Reply & reply, replies_) if (reply.fd != -1) ::close(reply.fd);
     thread_->requestFinished();
 }
 
-void RequestParser::sendReply(int id, const QByteArray & reply)
+void RequestParser::sendReply(int id, const QByteArray & reply, int fd, qint64 size)
 {
-    if (!verifyThreadCall(&RequestParser::sendReply, id, reply)) return;
+    if (!verifyThreadCall(&RequestParser::sendReply, id, reply, fd, size)) return;
 
     if (id == nextReplyId_) {
-        writeReply(reply);
+        writeReply(Reply{ reply, fd, size });
 
-        QMutableMapIterator<int, QByteArray> it(replies_);
+        QMutableMapIterator<int, Reply> it(replies_);
         while (it.hasNext()) {
             it.next();
             if (it.key() != nextReplyId_) break;
@@ -64,7 +71,7 @@ void RequestParser::sendReply(int id, const QByteArray & reply)
             it.remove();
         }
     } else {
-        replies_[id] = reply;
+        replies_[id] = Reply{ reply, fd, size };
     }
 }
 
@@ -273,16 +280,23 @@ bool RequestParser::handleRequestLine(const QByteArray & line)
     return true;
 }
 
-void RequestParser::writeReply(const QByteArray & reply)
+void RequestParser::writeReply(const Reply & reply)
 {
+    const qint64 size = reply.data.size() + reply.fileSize;
     if (isClosed() & WriteClosed) {
         logCustom(LogCat::Network | LogCat::Warn)("cannot write %1 bytes of request %2 on closed connection %3",
-            reply.size(), nextReplyId_, id_);
+            size, nextReplyId_, id_);
     } else {
-        write(reply);
+        write(reply.data);
+        if (reply.fd != -1 && !writeFile(reply.fd, 0, reply.fileSize)) {
+            // TLS needs the bytes
+            QFile file;
+            if (file.open(reply.fd, QIODevice::ReadOnly)) write(file.read(reply.fileSize));
+        }
         logCustom(LogCat::Network | LogCat::Trace)("wrote %1 bytes of request %2 on connection %3",
-            reply.size(), nextReplyId_, id_);
+            size, nextReplyId_, id_);
     }
+    if (reply.fd != -1) ::close(reply.fd);
     if (passThrough_) {
         logCustom(LogCat::Network | LogCat::Warn)("Not all bytes from pass through read! Closing connection %1 of request %2",
             id_, nextReplyId_);
@@ -26,7 +26,8 @@ public:
         const QList<RequestHandler *> & handlers, HttpThread * thread);
     ~RequestParser();
 
-    void sendReply(int id, const QByteArray & reply);
+    // takes ownership of fd (size bytes are sent after reply)
+    void sendReply(int id, const QByteArray & reply, int fd = -1, qint64 size = 0);
 
     void detachRequest();
     void setPassThroughHandler(PassThroughHandler * hdl);
@@ -41,7 +42,12 @@ private:
     void parseRequest();
     bool parseHeader();
     bool handleRequestLine(const QByteArray & line);
-    void writeReply(const QByteArray & reply);
+    struct Reply {
+        QByteArray data;
+        int fd;
+        qint64 fileSize;
+    };
+    void writeReply(const Reply & reply);
 
 private:
     const QList<RequestHandler *> & handlers_;
@@ -58,7 +64,7 @@ private:
 
     int requestCount_;
     int nextReplyId_;
-    QMap<int, QByteArray> replies_;
+    QMap<int, Reply> replies_;
 
     int attachedRequests_;
     bool detached_;
@@ -8,6 +8,7 @@
 #include "tcpconndata.h"
 
 #include <cflib/crypt/tlsstream.h>
+#include <cflib/net/impl/iouring.h>
 #include <cflib/net/impl/tcpmanagerimpl.h>
 #include <cflib/util/libev.h>
 #include <cflib/util/log.h>
@@ -16,31 +17,43 @@ USE_LOG(LogCat::Network)
 
 namespace cflib { namespace net {
 
-TCPConnData::TCPConnData(impl::TCPManagerImpl & impl,
+QAtomicInteger<qint64> TCPConnData::readBufferBytes;
+QAtomicInteger<quint64> TCPConnData::ioSyscalls;
+
+TCPConnData::TCPConnData(impl::TCPReactor & reactor,
     int socket, const char * peerIP, quint16 peerPort,
     crypt::TLSStream * tlsStream, uint tlsThreadId)
 :
-    impl(impl), conn(0),
+    impl(reactor.impl), reactor(reactor), conn(0),
     socket(socket), peerIP(peerIP), peerPort(peerPort),
     tlsStream(tlsStream), tlsThreadId(tlsThreadId),
-    readWatcher(new ev_io), writeWatcher(new ev_io),
+    tlsInPool(false), tlsHandshakeStarted(false), tlsDeleteAfterHandshake(false),
+    kernelTLSState(NoKernelTLS), kernelTLS(false), kernelTLSKeys(0), kernelTLSRx(false), kernelTLSStartRead(false),
+    readWatcher(new ev_io), writeWatcher(new ev_io), readBufferSize(0),
+    streaming(false), notifyPending(false), readCredit(0),
+    pendingWrite(0), writeHighWatermark(0), writeLowWatermark(0), maxPendingWrite(0), writeBufferFull(false),
     notifySomeBytesWritten(false), closeAfterWriting(false), deleteAfterWriting(false), notifyWrite(false),
-    closeType(TCPConn::NotClosed), lastInformedCloseType(TCPConn::NotClosed)
+    closeType(TCPConn::NotClosed), lastInformedCloseType(TCPConn::NotClosed),
+    uring(0)
 {
-    ev_io_init(readWatcher, &impl::TCPManagerImpl::readable, socket, EV_READ);
+    ev_io_init(readWatcher, &impl::TCPReactor::readable, socket, EV_READ);
     readWatcher->data = this;
-    ev_io_init(writeWatcher, &impl::TCPManagerImpl::writeable, socket, EV_WRITE);
+    ev_io_init(writeWatcher, &impl::TCPReactor::writeable, socket, EV_WRITE);
     writeWatcher->data = this;
+    if (impl::IOUringEngine * engine = reactor.ioUring()) engine->addConn(this);
 
     if (tlsStream) {
         const QByteArray data = tlsStream->initialSend();
-        if (!data.isEmpty()) impl.writeToSocket(this, data, false);
+        if (!data.isEmpty()) reactor.writeToSocket(this, data, false);
     }
 }
 
 TCPConnData::~TCPConnData()
 {
+    readBufferBytes.fetchAndSubRelaxed(readData.size());
+    if (tlsStream) impl.tlsConnectionDeleted(tlsThreadId);
     delete tlsStream;
+    delete kernelTLSKeys;
     delete readWatcher;
     delete writeWatcher;
     logTrace("~TCPConnData()");
@@ -51,4 +64,38 @@ void TCPConnData::callClosed()
     conn->closed(closeType);
 }
 
+bool TCPConnData::appendReadData(const char * data, int size)
+{
+    readBufferBytes.fetchAndAddRelaxed(size);
+    QMutexLocker ml(streaming ? &readMutex : 0);
+    if (readData.isEmpty()) readData = QByteArray(data, size);
+    else                    readData.append(data, size);
+    return !streaming || !qExchange(notifyPending, true);
+}
+
+bool TCPConnData::appendReadData(const QByteArray & data)
+{
+    readBufferBytes.fetchAndAddRelaxed(data.size());
+    QMutexLocker ml(streaming ? &readMutex : 0);
+    if (readData.isEmpty()) readData = data;
+    else                    readData += data;
+    return !streaming || !qExchange(notifyPending, true);
+}
+
+void TCPConnData::setReadData(const QByteArray & data)
+{
+    readBufferBytes.fetchAndAddRelaxed(data.size() - readData.size());
+    readData = data;
+}
+
+QByteArray TCPConnData::takeReadData()
+{
+    QMutexLocker ml(streaming ? &readMutex : 0);
+    notifyPending = false;
+    readBufferBytes.fetchAndSubRelaxed(readData.size());
+    QByteArray rv;
+    rv.swap(readData);
+    return rv;
+}
+
 }}    // namespace
@@ -7,29 +7,43 @@
 
 #pragma once
 
+#include <cflib/net/impl/writequeue.h>
 #include <cflib/net/tcpconn.h>
 
 struct ev_io;
 
-namespace cflib { namespace crypt { class TLSStream; }}
+namespace cflib { namespace crypt { class TLSStream; struct TLSTrafficKeys; }}
 
 namespace cflib { namespace net {
 
-namespace impl { class TCPManagerImpl; }
+namespace impl { class IOUringConn; class TCPManagerImpl; class TCPReactor; }
 
 class TCPConnData
 {
     Q_DISABLE_COPY(TCPConnData)
 public:
-    TCPConnData(impl::TCPManagerImpl & impl,
+    TCPConnData(impl::TCPReactor & reactor,
         int socket, const char * peerIP, quint16 peerPort,
         crypt::TLSStream * tlsStream, uint tlsThreadId);
     ~TCPConnData();
 
     void callClosed();
 
+    // readData is only allocated while received bytes wait for TCPConn::read
+    // returns false, if the consumer still has to read earlier bytes (streaming mode)
+    bool appendReadData(const char * data, int size);
+    bool appendReadData(const QByteArray & data);
+    void setReadData(const QByteArray & data);
+    QByteArray takeReadData();
+
+    // bytes of all read buffers (see TCPManager::readBufferBytes)
+    static QAtomicInteger<qint64> readBufferBytes;
+    // socket syscalls of all reactors (see TCPManager::ioSyscalls)
+    static QAtomicInteger<quint64> ioSyscalls;
+
 public:
     impl::TCPManagerImpl & impl;
+    impl::TCPReactor & reactor;    // all socket operations happen in this thread
     TCPConn * conn;
 
     // connection
@@ -40,19 +54,46 @@ public:
     // TLS handling
     crypt::TLSStream * const tlsStream;
     const uint tlsThreadId;
+    // handshake pool (see TCPManager::setTLSHandshakeThreads), only used by TLS thread
+    bool tlsInPool;                 // pool reads tlsStream
+    bool tlsHandshakeStarted;       // pool has accepted the handshake
+    bool tlsDeleteAfterHandshake;   // deleteOnFinish while pool reads
+    QList<QPair<QByteArray, bool>> tlsHeldWrites;        // only used by TLS thread while pool reads or switching
+    // kernel TLS (see TCPManager::setKernelTLS)
+    enum KernelTLSState { NoKernelTLS, KernelTLSSwitching, KernelTLSActive, KernelTLSFailed };
+    KernelTLSState kernelTLSState;                       // only used by TLS thread
+    QAtomicInteger<bool> kernelTLS;                      // tlsStream is not used anymore
+    crypt::TLSTrafficKeys * kernelTLSKeys;               // only used by reactor while switching
+    bool kernelTLSRx;                                    // only used by reactor
+    bool kernelTLSStartRead;                             // only used by reactor while switching
+
+    // outbound connections: destination address, port and TLS (see TCPManager::openPooledConnection)
+    QByteArray poolKey;
 
     // state
     ev_io * readWatcher;
     ev_io * writeWatcher;
-    QByteArray readBuf;
+    uint readBufferSize;    // max bytes per recv
     QByteArray readData;
-    QByteArray writeBuf;
+    // streaming read mode (see TCPConn::startStreaming)
+    bool streaming;         // readData is shared by both threads (guarded by readMutex)
+    bool notifyPending;     // newBytesAvailable called, read not yet
+    qint64 readCredit;      // only used by reactor
+    QMutex readMutex;
+    impl::WriteQueue writeBuf;
+    // write backpressure (see TCPConn::setWriteWatermarks)
+    QAtomicInteger<qint64> pendingWrite;    // including bytes on the way to the reactor
+    quint64 writeHighWatermark;
+    quint64 writeLowWatermark;
+    quint64 maxPendingWrite;
+    bool writeBufferFull;                   // only used by reactor
     bool notifySomeBytesWritten;
     bool closeAfterWriting;
     bool deleteAfterWriting;
     bool notifyWrite;
     volatile TCPConn::CloseType closeType;
     TCPConn::CloseType lastInformedCloseType;
+    impl::IOUringConn * uring;    // state of io_uring backend
 };
 
 }}    // namespace
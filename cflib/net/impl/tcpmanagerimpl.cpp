@@ -11,12 +11,14 @@
 #include <cflib/crypt/tlsserver.h>
 #include <cflib/crypt/tlssessions.h>
 #include <cflib/net/dns.h>
+#include <cflib/net/impl/iouring.h>
 #include <cflib/net/impl/tcpconndata.h>
 #include <cflib/net/impl/tlsthread.h>
 #include <cflib/net/tcpmanager.h>
 #include <cflib/util/libev.h>
 #include <cflib/util/log.h>
 
+#include <algorithm>
 #include <errno.h>
 #include <fcntl.h>
 #include <functional>
@@ -40,6 +42,16 @@
     #define close closesocket
 #endif
 
+#ifdef Q_OS_LINUX
+    #include <linux/tls.h>
+    #ifndef SOL_TLS
+        #define SOL_TLS 282
+    #endif
+    #ifndef TCP_ULP
+        #define TCP_ULP 31
+    #endif
+#endif
+
 USE_LOG(LogCat::Network)
 
 using namespace cflib::crypt;
@@ -49,7 +61,7 @@ namespace cflib { namespace net { namespace impl {
 
 namespace {
 
-Q_GLOBAL_STATIC(TLSSessions, tlsSessions)
+Q_GLOBAL_STATIC_WITH_ARGS(TLSSessions, clientSessions, (true))
 
 inline bool setNonBlocking(int fd)
 {
@@ -69,6 +81,18 @@ inline bool setNonBlocking(int fd)
     return true;
 }
 
+// saves the fcntl calls where possible
+inline int acceptNonBlocking(int listenSocket, struct sockaddr * addr, socklen_t * len)
+{
+#ifdef Q_OS_LINUX
+    return accept4(listenSocket, addr, len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    const int rv = accept(listenSocket, addr, len);
+    if (rv >= 0) setNonBlocking(rv);
+    return rv;
+#endif
+}
+
 inline bool callWithSockaddr(const QByteArray & ip, quint16 port, std::function<bool (const struct sockaddr *, socklen_t)> func)
 {
     if (ip.indexOf('.') == -1) {
@@ -88,52 +112,174 @@ inline bool callWithSockaddr(const QByteArray & ip, quint16 port, std::function<
     }
 }
 
+#ifdef Q_OS_LINUX
+
+// installs the keys of one direction (TLS_TX or TLS_RX) for TLS 1.3
+bool setKernelTLSKeys(int sock, int direction, const TLSTrafficKeys & keys)
+{
+    const bool tx = direction == TLS_TX;
+    const QByteArray & key = tx ? keys.txKey : keys.rxKey;
+    const QByteArray & iv  = tx ? keys.txIV  : keys.rxIV;
+    unsigned char recSeq[8];
+    qToBigEndian(tx ? keys.txSeq : keys.rxSeq, recSeq);
+
+    union {
+        tls12_crypto_info_aes_gcm_128 aes128;
+        tls12_crypto_info_aes_gcm_256 aes256;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+        tls12_crypto_info_chacha20_poly1305 chacha;
+#endif
+    } info;
+    memset(&info, 0, sizeof(info));
+    socklen_t size;
+    if (iv.size() != 12) return false;
+    switch (keys.cipher) {
+    case TLSTrafficKeys::AES_128_GCM:
+        if (key.size() != sizeof(info.aes128.key)) return false;
+        info.aes128.info.version     = TLS_1_3_VERSION;
+        info.aes128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        memcpy(info.aes128.key,     key.constData(), sizeof(info.aes128.key));
+        memcpy(info.aes128.salt,    iv.constData(), 4);
+        memcpy(info.aes128.iv,      iv.constData() + 4, 8);
+        memcpy(info.aes128.rec_seq, recSeq, 8);
+        size = sizeof(info.aes128);
+        break;
+    case TLSTrafficKeys::AES_256_GCM:
+        if (key.size() != sizeof(info.aes256.key)) return false;
+        info.aes256.info.version     = TLS_1_3_VERSION;
+        info.aes256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        memcpy(info.aes256.key,     key.constData(), sizeof(info.aes256.key));
+        memcpy(info.aes256.salt,    iv.constData(), 4);
+        memcpy(info.aes256.iv,      iv.constData() + 4, 8);
+        memcpy(info.aes256.rec_seq, recSeq, 8);
+        size = sizeof(info.aes256);
+        break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case TLSTrafficKeys::ChaCha20_Poly1305:
+        if (key.size() != sizeof(info.chacha.key)) return false;
+        info.chacha.info.version     = TLS_1_3_VERSION;
+        info.chacha.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+        memcpy(info.chacha.key,     key.constData(), sizeof(info.chacha.key));
+        memcpy(info.chacha.iv,      iv.constData(), 12);
+        memcpy(info.chacha.rec_seq, recSeq, 8);
+        size = sizeof(info.chacha);
+        break;
+#endif
+    default:
+        return false;
+    }
+
+    const bool ok = setsockopt(sock, SOL_TLS, direction, &info, size) == 0;
+    memset(&info, 0, sizeof(info));
+    return ok;
+}
+
+#endif
+
 }
 
-TCPManagerImpl::TCPManagerImpl(TCPManager & parent, uint tlsThreadCount) :
-    ThreadVerify("TCPManager", ThreadVerify::Net),
+TCPManagerImpl::TCPManagerImpl(TCPManager & parent, uint tlsThreadCount, uint reactorCount,
+    TCPManager::IOBackend backend)
+:
+    ThreadVerify(reactorCount > 1 ? QString("TCPManager 1/%1").arg(reactorCount) : "TCPManager", ThreadVerify::Net),
     parent(parent),
-    listenSock_(-1),
-    isIPv6Sock_(false),
-    readWatcher_(new ev_io),
+    serverSessions(3600, 10000),
+    kernelTLS(false),
+    isRunning_(false),
     credentials_(0),
-    tlsConnId_(0)
+    handshakePool_(0),
+    nextReactor_(0),
+    resolver_(0),
+    poolMaxIdle_(64),
+    poolMaxIdlePerHost_(8),
+    poolIdleTimeoutSec_(30)
 {
     setThreadPrio(QThread::HighestPriority);
-    for (uint i = 1 ; i <= tlsThreadCount ; ++i) tlsThreads_.append(new TLSThread(*this, i, tlsThreadCount));
+    init(tlsThreadCount, reactorCount, backend, true);
 }
 
-TCPManagerImpl::TCPManagerImpl(TCPManager & parent, uint tlsThreadCount, util::ThreadVerify * other) :
+TCPManagerImpl::TCPManagerImpl(TCPManager & parent, uint tlsThreadCount, uint reactorCount,
+    TCPManager::IOBackend backend, util::ThreadVerify * other)
+:
     ThreadVerify(other),
     parent(parent),
-    listenSock_(-1),
-    isIPv6Sock_(false),
-    readWatcher_(new ev_io),
+    serverSessions(3600, 10000),
+    kernelTLS(false),
+    isRunning_(false),
     credentials_(0),
-    tlsConnId_(0)
+    handshakePool_(0),
+    nextReactor_(0),
+    resolver_(0),
+    poolMaxIdle_(64),
+    poolMaxIdlePerHost_(8),
+    poolIdleTimeoutSec_(30)
 {
-    for (uint i = 1 ; i <= tlsThreadCount ; ++i) tlsThreads_.append(new TLSThread(*this, i, tlsThreadCount));
+    init(tlsThreadCount, reactorCount, backend, false);
 }
 
 TCPManagerImpl::~TCPManagerImpl()
 {
     logFunctionTrace
+    // pending lookups may still open connections
+    delete resolver_;
     stopVerifyThread();
+    delete handshakePool_;
+    foreach (TCPReactor * r, reactors_) delete r;
     foreach (TLSThread * th, tlsThreads_) delete th;
-    delete readWatcher_;
+}
+
+void TCPManagerImpl::init(uint tlsThreadCount, uint reactorCount, TCPManager::IOBackend backend, bool ownThread)
+{
+    for (uint i = 1 ; i <= tlsThreadCount ; ++i) tlsThreads_.append(new TLSThread(i, tlsThreadCount));
+    reactors_ << new TCPReactor(*this, this);
+    for (uint i = 2 ; i <= reactorCount ; ++i) reactors_ << new TCPReactor(*this, i, reactorCount);
+
+    if (backend != TCPManager::IOUringBackend) return;
+
+    // A foreign thread may not be a libev thread or may be stopped before us.
+    bool fallback = false;
+    for (int i = ownThread ? 0 : 1 ; i < reactors_.size() ; ++i) {
+        if (!reactors_[i]->initIOUring()) fallback = true;
+    }
+    if (fallback) logInfo("io_uring not available, using libev");
 }
 
 void TCPManagerImpl::deleteThreadData()
 {
     stop();
+    reactors_[0]->deleteThreadData();
 }
 
-bool TCPManagerImpl::start(int listenSocket, crypt::TLSCredentials * credentials)
+bool TCPManagerImpl::start(const QByteArray & ip, quint16 port, crypt::TLSCredentials * credentials)
 {
-    SyncedThreadCall<bool> stc(this);
-    if (!stc.verify(&TCPManagerImpl::start, listenSocket, credentials)) return stc.retval();
+    if (reactors_.size() == 1) return start(openListenSocket(ip, port, false, socketOptions), credentials);
+
+    // The kernel distributes new connections between the sockets.
+    // Without SO_REUSEPORT all reactors share one socket.
+    QList<int> socks;
+    for (int i = 0 ; i < reactors_.size() ; ++i) {
+        const int sock = openListenSocket(ip, port, true, socketOptions);
+        if (sock < 0) {
+            foreach (int s, socks) close(s);
+            return start(openListenSocket(ip, port, false, socketOptions), credentials);
+        }
+        socks << sock;
+    }
+    return startReactors(socks, credentials);
+}
 
+bool TCPManagerImpl::start(int listenSocket, crypt::TLSCredentials * credentials)
+{
     if (listenSocket < 0) return false;
+    QList<int> socks;
+    for (int i = 0 ; i < reactors_.size() ; ++i) socks << listenSocket;
+    return startReactors(socks, credentials);
+}
+
+bool TCPManagerImpl::startReactors(const QList<int> & listenSockets, crypt::TLSCredentials * credentials)
+{
+    SyncedThreadCall<bool> stc(this);
+    if (!stc.verify(&TCPManagerImpl::startReactors, listenSockets, credentials)) return stc.retval();
 
     if (isRunning()) {
         logWarn("server already running");
@@ -145,23 +291,18 @@ bool TCPManagerImpl::start(int listenSocket, crypt::TLSCredentials * credentials
         return false;
     }
 
-    struct sockaddr address;
-    socklen_t len = sizeof(address);
-    if (getsockname(listenSocket, &address, &len) < 0) {
-        logWarn("invalid socket %1 (%2 - %3)", listenSocket, errno, strerror(errno));
-        return false;
-    }
-
-    listenSock_ = listenSocket;
     credentials_ = credentials;
-    isIPv6Sock_ = address.sa_family == AF_INET6;
-
-    // watching for incoming activity
-    ev_io_init(readWatcher_, &TCPManagerImpl::listenSocketReadable, listenSock_, EV_READ);
-    readWatcher_->data = this;
-    ev_io_start(libEVLoop(), readWatcher_);
+    for (int i = 0 ; i < reactors_.size() ; ++i) {
+        if (!reactors_[i]->startListening(listenSockets[i])) {
+            foreach (TCPReactor * r, reactors_) r->stop();
+            credentials_ = 0;
+            return false;
+        }
+    }
+    listenSocks_ = listenSockets;
+    isRunning_ = true;
 
-    logInfo("server started");
+    logInfo("server started with %1 reactor(s)", reactors_.size());
     return true;
 }
 
@@ -171,17 +312,16 @@ void TCPManagerImpl::stop()
 
     logFunctionTrace
 
-    if (isRunning()) {
-        ev_io_stop(libEVLoop(), readWatcher_);
-        close(listenSock_);
-        listenSock_ = -1;
-        credentials_ = 0;
-    }
+    foreach (TCPReactor * r, reactors_) r->stop();
 
-    foreach (TCPConnData * c, connections_) {
-        if (c->tlsStream) tlsCloseConn(c, TCPConn::HardClosed, false);
-        else              closeConn(c, TCPConn::HardClosed, false);
-    }
+    // reactors may share the socket
+    QList<int> socks = listenSocks_;
+    std::sort(socks.begin(), socks.end());
+    socks.erase(std::unique(socks.begin(), socks.end()), socks.end());
+    foreach (int sock, socks) close(sock);
+    listenSocks_.clear();
+    credentials_ = 0;
+    isRunning_ = false;
 }
 
 TCPConnData * TCPManagerImpl::openConnection(
@@ -196,24 +336,92 @@ TCPConnData * TCPManagerImpl::openConnection(
         return 0;
     }
 
-    // resolve dns
-    QByteArray destIP;
-    {
-        const QList<QByteArray> ips = getIPFromDNS(destAddress, preferIPv6);
-        if (ips.isEmpty()) {
-            logWarn("cannot resolve host: %1", destAddress);
-            return 0;
-        }
-        destIP = ips[QRandomGenerator::global()->generate() % ips.size()];
+    return connectTo(getCachedIPFromDNS(destAddress, preferIPv6), destAddress, destPort, sourceIP, sourcePort, credentials);
+}
+
+TCPConnData * TCPManagerImpl::openPooledConnection(const QByteArray & destAddress, quint16 destPort,
+    TLSCredentials * credentials, bool preferIPv6, bool * reused)
+{
+    // no thread verify needed here
+
+    // A reactor thread must not wait for other reactors.
+    const QByteArray key = poolKey(destAddress, destPort, credentials != 0);
+    TCPConnData * conn = 0;
+    if (TCPReactor * reactor = reactorOfThread()) {
+        conn = reactor->checkoutConnection(key);
+    } else {
+        foreach (TCPReactor * r, reactors_) if ((conn = r->checkoutConnection(key))) break;
+    }
+    if (reused) *reused = conn != 0;
+    if (conn) return conn;
+    return openConnection(destAddress, destPort, QByteArray(), 0, credentials, preferIPv6);
+}
+
+void TCPManagerImpl::releaseConnection(TCPConnData * conn)
+{
+    // pending TLS reads have to be finished first
+    if (conn->tlsStream) tlsThreads_[conn->tlsThreadId]->releaseConnection(conn);
+    else                 conn->reactor.releaseConnection(conn);
+}
+
+void TCPManagerImpl::setConnectionPool(uint maxIdle, uint maxIdlePerHost, uint idleTimeoutSec)
+{
+    // read by the reactors on release only
+    poolMaxIdle_        = maxIdle;
+    poolMaxIdlePerHost_ = maxIdlePerHost;
+    poolIdleTimeoutSec_ = idleTimeoutSec;
+}
+
+void TCPManagerImpl::openConnection(
+    const QByteArray & destAddress, quint16 destPort,
+    const QByteArray & sourceIP, quint16 sourcePort,
+    TLSCredentials * credentials, bool preferIPv6,
+    const TCPManager::ConnectCallback & callback)
+{
+    // no thread verify needed here
+
+    if (credentials && tlsThreads_.isEmpty()) {
+        logWarn("no TLS threads");
+        callback(0);
+        return;
+    }
+
+    resolver()->resolve(destAddress, preferIPv6,
+        [this, destAddress, destPort, sourceIP, sourcePort, credentials, callback](const QList<QByteArray> & ips) {
+            callback(connectTo(ips, destAddress, destPort, sourceIP, sourcePort, credentials));
+        });
+}
+
+TCPConnData * TCPManagerImpl::connectTo(const QList<QByteArray> & ips,
+    const QByteArray & destAddress, quint16 destPort,
+    const QByteArray & sourceIP, quint16 sourcePort,
+    TLSCredentials * credentials)
+{
+    if (ips.isEmpty()) {
+        logWarn("cannot resolve host: %1", destAddress);
+        return 0;
     }
+    const QByteArray destIP = ips[QRandomGenerator::global()->generate() % ips.size()];
 
     // create non blocking socket
+#ifdef Q_OS_LINUX
+    int sock = socket(destIP.indexOf('.') == -1 ? AF_INET6 : AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) return 0;
+#else
     int sock = socket(destIP.indexOf('.') == -1 ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
     if (sock < 0) return 0;
     if (!setNonBlocking(sock)) {
         close(sock);
         return 0;
     }
+#endif
+    applySocketOptions(sock, socketOptions);
+#ifdef TCP_FASTOPEN_CONNECT
+    if (socketOptions.fastOpenConnect) {
+        int on = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, (const void *)&on, sizeof(on));
+    }
+#endif
 
     // bind source address and port
     if (!sourceIP.isEmpty()) {
@@ -238,122 +446,59 @@ TCPConnData * TCPManagerImpl::openConnection(
 
     logDebug("opened connection %1 to %2:%3", sock, destIP, destPort);
 
-    return addConnection(sock, destIP, destPort, credentials, destAddress);
+    // Connections opened in a reactor thread stay there, so that a TCPConn living in
+    // the network thread does not need cross thread calls. Others are spread evenly.
+    TCPReactor * reactor = reactorOfThread();
+    if (!reactor) reactor = reactors_[nextReactor_.fetchAndAddRelaxed(1) % reactors_.size()];
+    return reactor->addConnection(sock, destIP, destPort, credentials, destAddress);
 }
 
-void TCPManagerImpl::startReadWatcher(TCPConnData * conn)
+void TCPManagerImpl::setTLSHandshakeThreads(uint threadCount, uint maxPendingHandshakes)
 {
-    if (!verifyThreadCall(&TCPManagerImpl::startReadWatcher, conn)) return;
-
-    if (conn->closeType & TCPConn::ReadClosed) {
-        callClosed(conn);
-        return;
-    }
-    ev_io_start(libEVLoop(), conn->readWatcher);
+    if (isRunning_ || handshakePool_) return;
+    if (threadCount > 0) handshakePool_ = new TLSHandshakePool(threadCount, maxPendingHandshakes);
 }
 
-void TCPManagerImpl::writeToSocket(TCPConnData * conn, const QByteArray & data, bool notifyFinished)
+uint TCPManagerImpl::selectTLSThread() const
 {
-    if (!verifyThreadCall(&TCPManagerImpl::writeToSocket, conn, data, notifyFinished)) return;
-
-    conn->writeBuf += data;
-
-    if (conn->writeBuf.isEmpty()) {
-        if (notifyFinished) execLater(new Functor0<TCPConn>(conn->conn, &TCPConn::writeFinished));
-        return;
-    }
-
-    if (conn->closeType & TCPConn::WriteClosed) {
-        conn->writeBuf.clear();
-        if (notifyFinished) callClosed(conn);
-        return;
+    // least connections, the handshakes do not load these threads (see TLSHandshakePool)
+    int best = 0;
+    uint bestCount = tlsThreads_[0]->connCount.loadRelaxed();
+    for (int i = 1 ; i < tlsThreads_.size() ; ++i) {
+        const uint count = tlsThreads_[i]->connCount.loadRelaxed();
+        if (count < bestCount) {
+            best = i;
+            bestCount = count;
+        }
     }
-
-    if (notifyFinished) conn->notifyWrite = true;
-    if (!ev_is_active(conn->writeWatcher)) writeable(libEVLoop(), conn->writeWatcher, 0);
+    tlsThreads_[best]->connCount.fetchAndAddRelaxed(1);
+    return best;
 }
 
-void TCPManagerImpl::closeConn(TCPConnData * conn, TCPConn::CloseType type, bool notifyClose)
+void TCPManagerImpl::tlsConnectionDeleted(uint tlsThreadId) const
 {
-    if (!verifyThreadCall(&TCPManagerImpl::closeConn, conn, type, notifyClose)) return;
-
-    // update state
-    volatile TCPConn::CloseType & ct = conn->closeType;
-    const TCPConn::CloseType oldCt = ct;
-    ct = (TCPConn::CloseType)(ct | type);
-
-    // nothing changed
-    if (oldCt == ct) return;
-
-    // calc changes
-    const TCPConn::CloseType changed = (TCPConn::CloseType)(oldCt ^ ct);
-    bool readClosed  = changed & TCPConn::ReadClosed;
-    bool writeClosed = changed & TCPConn::WriteClosed;
-
-    if (ct != TCPConn::HardClosed && writeClosed && !conn->writeBuf.isEmpty()) {
-        ct = (TCPConn::CloseType)(ct & ~TCPConn::WriteClosed);
-        writeClosed = false;
-        conn->notifySomeBytesWritten = false;
-        conn->closeAfterWriting = true;
-        if (oldCt == ct) return;
-    }
-
-    logDebug("socket %1 closed (%2 => %3)", conn->socket, (int)oldCt, (int)ct);
-
-    // stop watcher
-    if (readClosed && ev_is_active(conn->readWatcher)) {
-        ev_io_stop(libEVLoop(), conn->readWatcher);
-        notifyClose = true;
-    }
-    if (writeClosed) {
-        if (ev_is_active(conn->writeWatcher)) ev_io_stop(libEVLoop(), conn->writeWatcher);
-        if (conn->notifyWrite) {
-            conn->notifyWrite = false;
-            notifyClose = true;
-        }
-    }
-    if (notifyClose) callClosed(conn);
-
-    // hard close after both have been closed or no close change
-    if (!readClosed && !writeClosed) return;
-
-    // close socket
-    if (readClosed)  conn->readBuf.clear();
-    if (ct == TCPConn::HardClosed) {
-        // send RST instead of FIN
-        struct linger lin;
-        lin.l_onoff  = 1;
-        lin.l_linger = 0;
-        setsockopt(conn->socket, SOL_SOCKET, SO_LINGER, (const void *)&lin, sizeof(lin));
-        close(conn->socket);
-        logDebug("fd %1 closed", conn->socket);
-    } else if (ct & TCPConn::ReadClosed) {
-        if (ct & TCPConn::WriteClosed) {
-            // no need to call shutdown(conn->socket, SHUT_RDWR) - close() will do.
-            close(conn->socket);
-            logDebug("fd %1 closed", conn->socket);
-        } else {
-            shutdown(conn->socket, SHUT_RD);
-        }
-    } else {
-        shutdown(conn->socket, SHUT_WR);
-    }
+    tlsThreads_[tlsThreadId]->connCount.fetchAndSubRelaxed(1);
 }
 
-void TCPManagerImpl::deleteOnFinish(TCPConnData * conn)
+TLSCounters & TCPManagerImpl::tlsCounters(const TCPConnData * conn) const
 {
-    if (!verifyThreadCall(&TCPManagerImpl::deleteOnFinish, conn)) return;
+    return tlsThreads_[conn->tlsThreadId]->counters;
+}
 
-    if (ev_is_active(conn->writeWatcher)) {
-        closeConn(conn, TCPConn::ReadClosed, false);
-        conn->notifySomeBytesWritten = false;
-        conn->closeAfterWriting = true;
-        conn->deleteAfterWriting = true;
-    } else {
-        closeConn(conn, TCPConn::ReadWriteClosed, false);
-        connections_.remove(conn);
-        delete conn;
+QList<TCPManager::TLSThreadStats> TCPManagerImpl::tlsThreadStats() const
+{
+    QList<TCPManager::TLSThreadStats> rv;
+    foreach (const TLSThread * th, tlsThreads_) {
+        TCPManager::TLSThreadStats stats;
+        stats.connections       = th->connCount.loadRelaxed();
+        stats.handshakes        = th->counters.handshakes.loadRelaxed();
+        stats.handshakeFailures = th->counters.handshakeFailures.loadRelaxed();
+        stats.bytesReceived     = th->counters.bytesReceived.loadRelaxed();
+        stats.bytesSent         = th->counters.bytesSent.loadRelaxed();
+        stats.botanNsecs        = th->counters.botanNsecs.loadRelaxed();
+        rv << stats;
     }
+    return rv;
 }
 
 void TCPManagerImpl::tlsStartReadWatcher(TCPConnData * conn)
@@ -361,28 +506,98 @@ void TCPManagerImpl::tlsStartReadWatcher(TCPConnData * conn)
     tlsThreads_[conn->tlsThreadId]->startReadWatcher(conn);
 }
 
+void TCPManagerImpl::tlsRead(TCPConnData * conn) const
+{
+    tlsThreads_[conn->tlsThreadId]->read(conn);
+}
+
 void TCPManagerImpl::tlsWrite(TCPConnData * conn, const QByteArray & data, bool notifyFinished) const
 {
     tlsThreads_[conn->tlsThreadId]->write(conn, data, notifyFinished);
 }
 
+void TCPManagerImpl::tlsWriteFile(TCPConnData * conn, int fd, qint64 offset, qint64 length, bool notifyFinished) const
+{
+    tlsThreads_[conn->tlsThreadId]->writeFile(conn, fd, offset, length, notifyFinished);
+}
+
 void TCPManagerImpl::tlsCloseConn(TCPConnData * conn, TCPConn::CloseType type, bool notifyClose) const
 {
     tlsThreads_[conn->tlsThreadId]->closeConn(conn, type, notifyClose);
 }
 
+void TCPManagerImpl::tlsSetCork(TCPConnData * conn, bool cork) const
+{
+    tlsThreads_[conn->tlsThreadId]->setCork(conn, cork);
+}
+
 void TCPManagerImpl::tlsDeleteOnFinish(TCPConnData * conn) const
 {
     tlsThreads_[conn->tlsThreadId]->deleteOnFinish(conn);
 }
 
+void TCPManagerImpl::tlsCallClosed(TCPConnData * conn) const
+{
+    tlsThreads_[conn->tlsThreadId]->callClosed(conn);
+}
+
+void TCPManagerImpl::tlsKernelTLSEnabled(TCPConnData * conn, bool ok) const
+{
+    tlsThreads_[conn->tlsThreadId]->kernelTLSEnabled(conn, ok);
+}
+
+void TCPManagerImpl::tlsHandshakeRead(TCPConnData * conn, const QByteArray & plain, bool ok) const
+{
+    tlsThreads_[conn->tlsThreadId]->handshakeRead(conn, plain, ok);
+}
+
+QByteArray TCPManagerImpl::poolKey(const QByteArray & destAddress, quint16 destPort, bool tls)
+{
+    return destAddress + ':' + QByteArray::number(destPort) + (tls ? "/tls" : "");
+}
+
 void TCPManagerImpl::setNoDelay(int socket, bool noDelay)
 {
     int on = noDelay ? 1 : 0;
     setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (char *)&on, sizeof(on));
 }
 
-int TCPManagerImpl::openListenSocket(const QByteArray & ip, quint16 port)
+void TCPManagerImpl::applySocketOptions(int socket, const TCPManager::SocketOptions & options)
+{
+    auto set = [socket](int level, int name, int value) {
+        setsockopt(socket, level, name, (const char *)&value, sizeof(value));
+    };
+    if (options.sendBufferSize    > 0) set(SOL_SOCKET, SO_SNDBUF, options.sendBufferSize);
+    if (options.receiveBufferSize > 0) set(SOL_SOCKET, SO_RCVBUF, options.receiveBufferSize);
+    if (options.noDelay)               set(IPPROTO_TCP, TCP_NODELAY, 1);
+    if (options.keepAliveIdleSecs > 0) {
+        set(SOL_SOCKET, SO_KEEPALIVE, 1);
+#ifdef TCP_KEEPIDLE
+        set(IPPROTO_TCP, TCP_KEEPIDLE, options.keepAliveIdleSecs);
+        if (options.keepAliveIntervalSecs > 0) set(IPPROTO_TCP, TCP_KEEPINTVL, options.keepAliveIntervalSecs);
+        if (options.keepAliveCount        > 0) set(IPPROTO_TCP, TCP_KEEPCNT,   options.keepAliveCount);
+#endif
+    }
+#ifdef Q_OS_LINUX
+    if (options.quickAck)          set(IPPROTO_TCP, TCP_QUICKACK,      1);
+    if (options.busyPollUsecs > 0) set(SOL_SOCKET,  SO_BUSY_POLL,      options.busyPollUsecs);
+    if (options.notSentLowat  > 0) set(IPPROTO_TCP, TCP_NOTSENT_LOWAT, options.notSentLowat);
+#endif
+}
+
+void TCPManagerImpl::rearmQuickAck(int socket)
+{
+    // the kernel leaves quick ack mode on its own, thus it is set again after every read
+#ifdef Q_OS_LINUX
+    int on = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_QUICKACK, (const char *)&on, sizeof(on));
+#else
+    Q_UNUSED(socket)
+#endif
+}
+
+int TCPManagerImpl::openListenSocket(const QByteArray & ip, quint16 port, bool reusePort,
+    const TCPManager::SocketOptions & options)
 {
     // create non blocking socket
     int rv = socket(ip.indexOf('.') == -1 ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
@@ -394,6 +609,18 @@ int TCPManagerImpl::openListenSocket(const QByteArray & ip, quint16 port)
 
     // bind to address and port
     { int on = 1; setsockopt(rv, SOL_SOCKET, SO_REUSEADDR, (const void *)&on, sizeof(on)); }
+    if (reusePort) {
+#ifdef SO_REUSEPORT
+        int on = 1;
+        if (setsockopt(rv, SOL_SOCKET, SO_REUSEPORT, (const void *)&on, sizeof(on)) < 0) {
+            close(rv);
+            return -1;
+        }
+#else
+        close(rv);
+        return -1;
+#endif
+    }
     if (!callWithSockaddr(ip, port, [rv](const struct sockaddr * addr, socklen_t addrlen) {
         return bind(rv, addr, addrlen) >= 0; }))
     {
@@ -402,8 +629,24 @@ int TCPManagerImpl::openListenSocket(const QByteArray & ip, quint16 port)
         return -1;
     }
 
+    // inherited by accepted sockets, window scaling is negotiated with the SYN
+    if (options.sendBufferSize > 0) {
+        setsockopt(rv, SOL_SOCKET, SO_SNDBUF, (const char *)&options.sendBufferSize, sizeof(int));
+    }
+    if (options.receiveBufferSize > 0) {
+        setsockopt(rv, SOL_SOCKET, SO_RCVBUF, (const char *)&options.receiveBufferSize, sizeof(int));
+    }
+#ifdef Q_OS_LINUX
+    if (options.deferAcceptSecs > 0) {
+        setsockopt(rv, IPPROTO_TCP, TCP_DEFER_ACCEPT, (const void *)&options.deferAcceptSecs, sizeof(int));
+    }
+    if (options.fastOpenQueue > 0) {
+        setsockopt(rv, IPPROTO_TCP, TCP_FASTOPEN, (const void *)&options.fastOpenQueue, sizeof(int));
+    }
+#endif
+
     // start listening
-    if (listen(rv, 1024) < 0) {
+    if (listen(rv, options.backlog > 0 ? options.backlog : SOMAXCONN) < 0) {
         close(rv);
         return -1;
     }
@@ -411,152 +654,756 @@ int TCPManagerImpl::openListenSocket(const QByteArray & ip, quint16 port)
     return rv;
 }
 
-void TCPManagerImpl::readable(ev_loop * loop, ev_io * w, int)
+DNSResolver * TCPManagerImpl::resolver()
 {
-    TCPConnData * conn = (TCPConnData *)w->data;
-    TCPManagerImpl & impl = conn->impl;
+    // most users never need resolver threads
+    QMutexLocker ml(&resolverMutex_);
+    if (!resolver_) resolver_ = new DNSResolver();
+    return resolver_;
+}
 
-    char * data = (char *)conn->readBuf.constData();
-    const int fd = conn->socket;
+TCPReactor * TCPManagerImpl::reactorOfThread() const
+{
+    ev_loop * loop = libEVLoopOfThread();
+    if (!loop) return 0;
+    foreach (TCPReactor * r, reactors_) if (r->libEVLoop() == loop) return r;
+    return 0;
+}
 
-    const ssize_t count = ::recv(fd, data, conn->readBuf.size(), 0);
-    if (count > 0) {
-        logTrace("read %1 raw bytes from %2", (int)count, fd);
-        ev_io_stop(loop, w);
-        conn->readData.append(data, (int)count);
-        if (!conn->tlsStream) conn->conn->newBytesAvailable();
-        else                  impl.tlsThreads_[conn->tlsThreadId]->read(conn);
-        return;
-    }
+// ============================================================================
 
-    if (count == 0) {
-        logDebug("read channel closed on fd %1", fd);
-        impl.closeConn(conn, TCPConn::ReadClosed, false);
-        return;
-    }
+TCPReactor::TCPReactor(TCPManagerImpl & impl, uint no, uint total) :
+    ThreadVerify(QString("TCPManager %1/%2").arg(no).arg(total), ThreadVerify::Net),
+    impl(impl),
+    ownThread_(true),
+    uring_(0),
+    listenSock_(-1),
+    isIPv6Sock_(false),
+    readWatcher_(new ev_io),
+    idleCount_(0),
+    idleTimer_(this, &TCPReactor::expireIdleConnections)
+{
+    setThreadPrio(QThread::HighestPriority);
+}
 
-    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        logDebug("nothing to read on fd %1 (%2 - %3)", fd, errno, strerror(errno));
+TCPReactor::TCPReactor(TCPManagerImpl & impl, util::ThreadVerify * other) :
+    ThreadVerify(other),
+    impl(impl),
+    ownThread_(false),
+    uring_(0),
+    listenSock_(-1),
+    isIPv6Sock_(false),
+    readWatcher_(new ev_io),
+    idleCount_(0),
+    idleTimer_(this, &TCPReactor::expireIdleConnections)
+{
+}
+
+TCPReactor::~TCPReactor()
+{
+    if (ownThread_) stopVerifyThread();
+    delete readWatcher_;
+    TCPConnData::readBufferBytes.fetchAndSubRelaxed(readBuf_.size());
+}
+
+void TCPReactor::deleteThreadData()
+{
+    idleTimer_.stop();
+    foreach (const QList<IdleConn> & list, idleConns_) foreach (const IdleConn & idle, list) {
+        closeConn(idle.conn, TCPConn::HardClosed, false);
+        deleteConn(idle.conn);
+    }
+    idleConns_.clear();
+    idleCount_ = 0;
+
+    delete uring_;
+    uring_ = 0;
+}
+
+bool TCPReactor::initIOUring()
+{
+    SyncedThreadCall<bool> stc(this);
+    if (!stc.verify(&TCPReactor::initIOUring)) return stc.retval();
+
+    if (!uring_) uring_ = IOUringEngine::create(*this);
+    return uring_ != 0;
+}
+
+bool TCPReactor::startListening(int listenSocket)
+{
+    SyncedThreadCall<bool> stc(this);
+    if (!stc.verify(&TCPReactor::startListening, listenSocket)) return stc.retval();
+
+    struct sockaddr address;
+    socklen_t len = sizeof(address);
+    if (getsockname(listenSocket, &address, &len) < 0) {
+        logWarn("invalid socket %1 (%2 - %3)", listenSocket, errno, strerror(errno));
+        return false;
+    }
+
+    listenSock_ = listenSocket;
+    isIPv6Sock_ = address.sa_family == AF_INET6;
+
+    // watching for incoming activity
+    if (uring_) {
+        uring_->startAccept(listenSock_);
+        return true;
+    }
+    ev_io_init(readWatcher_, &TCPReactor::listenSocketReadable, listenSock_, EV_READ);
+    readWatcher_->data = this;
+    ev_io_start(libEVLoop(), readWatcher_);
+    return true;
+}
+
+void TCPReactor::stop()
+{
+    if (!verifySyncedThreadCall(&TCPReactor::stop)) return;
+
+    if (listenSock_ != -1) {
+        if (uring_) uring_->stopAccept();
+        else        ev_io_stop(libEVLoop(), readWatcher_);
+        listenSock_ = -1;
+    }
+
+    foreach (TCPConnData * c, connections_) {
+        if (c->tlsStream) impl.tlsCloseConn(c, TCPConn::HardClosed, false);
+        else              closeConn(c, TCPConn::HardClosed, false);
+    }
+}
+
+TCPConnData * TCPReactor::addConnection(int sock, const QByteArray & destIP, quint16 destPort,
+    TLSCredentials * credentials, const QByteArray & destAddress)
+{
+    SyncedThreadCall<TCPConnData *> stc(this);
+    if (!stc.verify(&TCPReactor::addConnection, sock, destIP, destPort, credentials, destAddress)) return stc.retval();
+
+    TCPConnData * conn = credentials ?
+        new TCPConnData(*this, sock, destIP, destPort,
+            new TLSClient(*clientSessions(), *credentials, destAddress), impl.selectTLSThread()) :
+        new TCPConnData(*this, sock, destIP, destPort, 0, 0);
+    conn->poolKey = TCPManagerImpl::poolKey(destAddress, destPort, credentials != 0);
+    connections_ << conn;
+    return conn;
+}
+
+TCPConnData * TCPReactor::checkoutConnection(const QByteArray & poolKey)
+{
+    SyncedThreadCall<TCPConnData *> stc(this);
+    if (!stc.verify(&TCPReactor::checkoutConnection, poolKey)) return stc.retval();
+
+    QHash<QByteArray, QList<IdleConn>>::iterator it = idleConns_.find(poolKey);
+    if (it == idleConns_.end()) return 0;
+
+    TCPConnData * rv = 0;
+    while (!rv && !it->isEmpty()) {
+        const IdleConn idle = it->takeLast();
+        --idleCount_;
+        if (!idle.expires.hasExpired() && isReusable(idle.conn)) rv = idle.conn;
+        else                                                      dropConnection(idle.conn);
+    }
+    if (it->isEmpty()) idleConns_.erase(it);
+    if (idleCount_ == 0) idleTimer_.stop();
+    if (rv) logDebug("reusing connection %1 to %2", rv->socket, poolKey);
+    return rv;
+}
+
+void TCPReactor::releaseConnection(TCPConnData * conn)
+{
+    if (!verifyThreadCall(&TCPReactor::releaseConnection, conn)) return;
+
+    // idle connections do not read
+    if (uring_)                                  uring_->stopRead(conn);
+    else if (ev_is_active(conn->readWatcher)) ev_io_stop(libEVLoop(), conn->readWatcher);
+    conn->streaming = false;
+    conn->readCredit = 0;
+    conn->writeHighWatermark = 0;
+    conn->maxPendingWrite = 0;
+    conn->writeBufferFull = false;
+
+    if (conn->poolKey.isEmpty() || !isReusable(conn) || idleCount_ >= impl.poolMaxIdle_ ||
+        (uint)idleConns_.value(conn->poolKey).size() >= impl.poolMaxIdlePerHost_)
+    {
+        dropConnection(conn);
         return;
     }
 
-    logInfo("read on fd %1 failed (%2 - %3)", fd, errno, strerror(errno));
-    impl.closeConn(conn, TCPConn::HardClosed, false);
+    logDebug("connection %1 to %2 is idle", conn->socket, conn->poolKey);
+    idleConns_[conn->poolKey] << IdleConn{ conn, QDeadlineTimer(impl.poolIdleTimeoutSec_ * 1000) };
+    ++idleCount_;
+    if (!idleTimer_.isActive()) idleTimer_.start(1.0);
 }
 
-void TCPManagerImpl::writeable(ev_loop * loop, ev_io * w, int)
+void TCPReactor::startReadWatcher(TCPConnData * conn)
 {
-    TCPConnData * conn = (TCPConnData *)w->data;
-    TCPManagerImpl & impl = conn->impl;
+    if (!verifyThreadCall(&TCPReactor::startReadWatcher, conn)) return;
 
-    QByteArray & buf = conn->writeBuf;
-    const int fd = conn->socket;
+    // encrypted bytes must not be read before the kernel has the keys
+    if (conn->kernelTLSKeys && !conn->kernelTLSRx) {
+        conn->kernelTLSStartRead = true;
+        return;
+    }
 
-#ifdef Q_OS_LINUX
-    const ssize_t count = ::send(fd, buf.constData(), buf.size(), MSG_NOSIGNAL);
-#else
-    const ssize_t count = ::send(fd, buf.constData(), buf.size(), 0);
-#endif
-    logTrace("wrote %1 / %2 bytes on %3", (qint64)count, buf.size(), fd);
-    if (count < buf.size()) {
-        if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOTCONN) {
-            logDebug("write on fd %1 failed (%2 - %3)", fd, errno, strerror(errno));
-            buf.clear();
-            impl.closeConn(conn, errno == EPIPE ? TCPConn::WriteClosed : TCPConn::HardClosed, false);
-            if (conn->deleteAfterWriting) {
-                impl.connections_.remove(conn);
-                delete conn;
+    if (conn->closeType & TCPConn::ReadClosed) {
+        callClosed(conn);
+        return;
+    }
+    if (uring_) uring_->startRead(conn);
+    else        ev_io_start(libEVLoop(), conn->readWatcher);
+}
+
+void TCPReactor::addReadCredit(TCPConnData * conn, quint64 credit)
+{
+    if (!verifyThreadCall(&TCPReactor::addReadCredit, conn, credit)) return;
+
+    if (conn->closeType & TCPConn::ReadClosed) {
+        callClosed(conn);
+        return;
+    }
+    conn->readCredit += credit;
+    if (conn->readCredit <= 0) return;
+    if (uring_) {
+        if (!uring_->isReading(conn)) uring_->startRead(conn);
+    } else if (!ev_is_active(conn->readWatcher)) {
+        ev_io_start(libEVLoop(), conn->readWatcher);
+    }
+}
+
+void TCPReactor::writeToSocket(TCPConnData * conn, const QByteArray & data, bool notifyFinished)
+{
+    if (!verifyThreadCall(&TCPReactor::writeToSocket, conn, data, notifyFinished)) return;
+
+    // TCPConn::write counts plain connections, TLS threads write encrypted bytes
+    if (conn->tlsStream) conn->pendingWrite.fetchAndAddRelaxed(data.size());
+    conn->writeBuf.append(data);
+    startWriting(conn, notifyFinished);
+}
+
+void TCPReactor::writeFile(TCPConnData * conn, int fd, qint64 offset, qint64 length, bool notifyFinished)
+{
+    if (!verifyThreadCall(&TCPReactor::writeFile, conn, fd, offset, length, notifyFinished)) return;
+
+    conn->writeBuf.appendFile(fd, offset, length);
+    startWriting(conn, notifyFinished);
+}
+
+void TCPReactor::setWriteWatermarks(TCPConnData * conn, quint64 high, quint64 low, quint64 maxPending)
+{
+    if (!verifyThreadCall(&TCPReactor::setWriteWatermarks, conn, high, low, maxPending)) return;
+
+    conn->writeHighWatermark = high;
+    conn->writeLowWatermark  = qMin(low, high);
+    conn->maxPendingWrite    = maxPending;
+    if (high == 0) conn->writeBufferFull = false;
+    checkWriteBuffer(conn);
+}
+
+void TCPReactor::startWriting(TCPConnData * conn, bool notifyFinished)
+{
+    if (conn->writeBuf.isEmpty()) {
+        if (notifyFinished) execLater(new Functor0<TCPConn>(conn->conn, &TCPConn::writeFinished));
+        return;
+    }
+
+    if (conn->closeType & TCPConn::WriteClosed) {
+        clearWriteBuffer(conn);
+        if (notifyFinished) callClosed(conn);
+        return;
+    }
+
+    if (notifyFinished) conn->notifyWrite = true;
+    if (uring_)                                   uring_->startWrite(conn);
+    else if (!ev_is_active(conn->writeWatcher)) writeable(libEVLoop(), conn->writeWatcher, 0);
+    checkWriteBuffer(conn);
+}
+
+void TCPReactor::checkWriteBuffer(TCPConnData * conn)
+{
+    if (conn->writeBuf.isEmpty()) return;
+    const quint64 pending = qMax(conn->pendingWrite.loadRelaxed(), (qint64)0);
+
+    if (conn->maxPendingWrite > 0 && pending > conn->maxPendingWrite) {
+        logInfo("closing fd %1 with %2 pending bytes", conn->socket, pending);
+        clearWriteBuffer(conn);
+        closeConn(conn, TCPConn::HardClosed, true);
+        return;
+    }
+
+    if (conn->writeHighWatermark > 0 && !conn->writeBufferFull && pending >= conn->writeHighWatermark) {
+        conn->writeBufferFull = true;
+        execLater(new Functor0<TCPConn>(conn->conn, &TCPConn::writeBufferFull));
+    }
+}
+
+void TCPReactor::clearWriteBuffer(TCPConnData * conn)
+{
+    conn->pendingWrite.fetchAndSubRelaxed(conn->writeBuf.size());
+    conn->writeBuf.clear();
+}
+
+void TCPReactor::closeConn(TCPConnData * conn, TCPConn::CloseType type, bool notifyClose)
+{
+    if (!verifyThreadCall(&TCPReactor::closeConn, conn, type, notifyClose)) return;
+
+    // update state
+    volatile TCPConn::CloseType & ct = conn->closeType;
+    const TCPConn::CloseType oldCt = ct;
+    ct = (TCPConn::CloseType)(ct | type);
+
+    // nothing changed
+    if (oldCt == ct) return;
+
+    // calc changes
+    const TCPConn::CloseType changed = (TCPConn::CloseType)(oldCt ^ ct);
+    bool readClosed  = changed & TCPConn::ReadClosed;
+    bool writeClosed = changed & TCPConn::WriteClosed;
+
+    if (ct != TCPConn::HardClosed && writeClosed && !conn->writeBuf.isEmpty()) {
+        ct = (TCPConn::CloseType)(ct & ~TCPConn::WriteClosed);
+        writeClosed = false;
+        conn->notifySomeBytesWritten = false;
+        conn->closeAfterWriting = true;
+        if (oldCt == ct) return;
+    }
+
+    logDebug("socket %1 closed (%2 => %3)", conn->socket, (int)oldCt, (int)ct);
+
+    // stop watcher
+    if (readClosed) {
+        if (uring_) {
+            if (uring_->isReading(conn)) {
+                uring_->stopRead(conn);
+                notifyClose = true;
             }
-            return;
+        } else if (ev_is_active(conn->readWatcher)) {
+            ev_io_stop(libEVLoop(), conn->readWatcher);
+            notifyClose = true;
         }
-        if (count > 0) {
-            buf.remove(0, count);
-            if (conn->notifySomeBytesWritten) {
-                impl.execLater(new Functor1<TCPConn, quint64>(conn->conn, &TCPConn::someBytesWritten, (quint64)count));
-            }
+        // streaming consumers wait for closed even without credit
+        if (conn->streaming) notifyClose = true;
+    }
+    if (writeClosed) {
+        if (!uring_ && ev_is_active(conn->writeWatcher)) ev_io_stop(libEVLoop(), conn->writeWatcher);
+        if (conn->notifyWrite) {
+            conn->notifyWrite = false;
+            notifyClose = true;
         }
-        if (!ev_is_active(w)) ev_io_start(loop, w);
-    } else {
-        buf.clear();
-        if (conn->closeAfterWriting) {
-            impl.closeConn(conn, TCPConn::WriteClosed, false);
-            if (conn->deleteAfterWriting) {
-                impl.connections_.remove(conn);
-                delete conn;
-            }
+    }
+    if (notifyClose) callClosed(conn);
+
+    // hard close after both have been closed or no close change
+    if (!readClosed && !writeClosed) return;
+
+    // close socket
+    if (ct == TCPConn::HardClosed) {
+        // send RST instead of FIN
+        struct linger lin;
+        lin.l_onoff  = 1;
+        lin.l_linger = 0;
+        setsockopt(conn->socket, SOL_SOCKET, SO_LINGER, (const void *)&lin, sizeof(lin));
+        closeSocket(conn);
+    } else if (ct & TCPConn::ReadClosed) {
+        if (ct & TCPConn::WriteClosed) {
+            // no need to call shutdown(conn->socket, SHUT_RDWR) - close() will do.
+            closeSocket(conn);
         } else {
-            if (ev_is_active(w)) ev_io_stop(loop, w);
-            if (conn->notifySomeBytesWritten) {
-                impl.execLater(new Functor1<TCPConn, quint64>(conn->conn, &TCPConn::someBytesWritten, (quint64)count));
-            }
-            if (conn->notifyWrite) {
-                conn->notifyWrite = false;
-                impl.execLater(new Functor0<TCPConn>(conn->conn, &TCPConn::writeFinished));
-            }
+            shutdown(conn->socket, SHUT_RD);
         }
+    } else {
+        shutdown(conn->socket, SHUT_WR);
     }
 }
 
-void TCPManagerImpl::listenSocketReadable(ev_loop *, ev_io * w, int)
+void TCPReactor::setCork(TCPConnData * conn, bool cork)
+{
+    if (!verifyThreadCall(&TCPReactor::setCork, conn, cork)) return;
+
+#ifdef Q_OS_LINUX
+    int on = cork ? 1 : 0;
+    setsockopt(conn->socket, IPPROTO_TCP, TCP_CORK, (const void *)&on, sizeof(on));
+#else
+    Q_UNUSED(conn); Q_UNUSED(cork);
+#endif
+}
+
+void TCPReactor::deleteOnFinish(TCPConnData * conn)
+{
+    if (!verifyThreadCall(&TCPReactor::deleteOnFinish, conn)) return;
+
+    // TCPConn is gone
+    conn->writeHighWatermark = 0;
+    conn->writeBufferFull = false;
+
+    if (uring_ ? uring_->isWriting(conn) : ev_is_active(conn->writeWatcher)) {
+        closeConn(conn, TCPConn::ReadClosed, false);
+        conn->notifySomeBytesWritten = false;
+        conn->closeAfterWriting = true;
+        conn->deleteAfterWriting = true;
+    } else {
+        closeConn(conn, TCPConn::ReadWriteClosed, false);
+        deleteConn(conn);
+    }
+}
+
+void TCPReactor::readable(ev_loop * loop, ev_io * w, int)
+{
+    TCPConnData * conn = (TCPConnData *)w->data;
+    TCPReactor & reactor = conn->reactor;
+
+    if (conn->streaming) {
+        reactor.readStream(conn);
+        return;
+    }
+
+    QByteArray & buf = reactor.readBuf_;
+    if ((uint)buf.size() < conn->readBufferSize) {
+        TCPConnData::readBufferBytes.fetchAndAddRelaxed(conn->readBufferSize - buf.size());
+        buf.resize(conn->readBufferSize);
+    }
+    char * data = buf.data();
+    const int fd = conn->socket;
+
+    TCPConnData::ioSyscalls.fetchAndAddRelaxed(1);
+    const ssize_t count = ::recv(fd, data, conn->readBufferSize, 0);
+    if (count > 0) {
+        logTrace("read %1 raw bytes from %2", (int)count, fd);
+        if (reactor.impl.socketOptions.quickAck) TCPManagerImpl::rearmQuickAck(fd);
+        ev_io_stop(loop, w);
+        conn->appendReadData(data, (int)count);
+        reactor.bytesReceived(conn);
+        return;
+    }
+
+    if (count == 0) {
+        logDebug("read channel closed on fd %1", fd);
+        reactor.closeConn(conn, TCPConn::ReadClosed, false);
+        return;
+    }
+
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        logDebug("nothing to read on fd %1 (%2 - %3)", fd, errno, strerror(errno));
+        return;
+    }
+
+    if (errno == EIO && conn->kernelTLSRx) {
+        // kernel TLS: record without data (close_notify, KeyUpdate, ... see TCPManager::setKernelTLS)
+        logDebug("TLS record without data on fd %1", fd);
+        reactor.closeConn(conn, TCPConn::ReadClosed, false);
+        return;
+    }
+
+    logInfo("read on fd %1 failed (%2 - %3)", fd, errno, strerror(errno));
+    reactor.closeConn(conn, TCPConn::HardClosed, false);
+}
+
+void TCPReactor::writeable(ev_loop *, ev_io * w, int)
+{
+    TCPConnData * conn = (TCPConnData *)w->data;
+    TCPReactor & reactor = conn->reactor;
+
+    if (!conn->writeBuf.isEmpty()) TCPConnData::ioSyscalls.fetchAndAddRelaxed(1);
+    const qint64 count = conn->writeBuf.send(conn->socket);
+    // EINPROGRESS: TCP fast open has sent the SYN only
+    if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOTCONN && errno != EINPROGRESS) {
+        reactor.writeFailed(conn, errno);
+        return;
+    }
+    reactor.written(conn, qMax(count, (qint64)0));
+}
+
+void TCPReactor::listenSocketReadable(ev_loop *, ev_io * w, int)
 {
     logFunctionTrace
 
-    TCPManagerImpl * impl = (TCPManagerImpl *)w->data;
+    TCPReactor * reactor = (TCPReactor *)w->data;
 
     forever {
         // get socket and source address
         int newSock;
         char ip[40];
         quint16 port;
-        if (impl->isIPv6Sock_) {
+        TCPConnData::ioSyscalls.fetchAndAddRelaxed(1);
+        if (reactor->isIPv6Sock_) {
             struct sockaddr_in6 cliAddr;
             socklen_t len = sizeof(cliAddr);
-            newSock = accept(impl->listenSock_, (struct sockaddr *)&cliAddr, &len);
+            newSock = acceptNonBlocking(reactor->listenSock_, (struct sockaddr *)&cliAddr, &len);
             if (newSock < 0) break;
             inet_ntop(AF_INET6, &cliAddr.sin6_addr, ip, sizeof(ip));
             port = ntohs(cliAddr.sin6_port);
         } else {
             struct sockaddr_in cliAddr;
             socklen_t len = sizeof(cliAddr);
-            newSock = accept(impl->listenSock_, (struct sockaddr *)&cliAddr, &len);
+            newSock = acceptNonBlocking(reactor->listenSock_, (struct sockaddr *)&cliAddr, &len);
             if (newSock < 0) break;
             inet_ntop(AF_INET, &cliAddr.sin_addr, ip, sizeof(ip));
             port = ntohs(cliAddr.sin_port);
         }
-        setNonBlocking(newSock);
+        reactor->accepted(newSock, ip, port);
+    }
+}
+
+void TCPReactor::accepted(int sock, const char * ip, quint16 port)
+{
+    logDebug("new connection (%1) from %2:%3", sock, ip, port);
 
-        logDebug("new connection (%1) from %2:%3", newSock, ip, port);
+    TCPManagerImpl::applySocketOptions(sock, impl.socketOptions);
+
+    TCPConnData * conn = impl.credentials_ ?
+        new TCPConnData(*this, sock, ip, port,
+            new TLSServer(impl.serverSessions, *impl.credentials_, false, false, impl.kernelTLS),
+            impl.selectTLSThread()) :
+        new TCPConnData(*this, sock, ip, port, 0, 0);
+    connections_ << conn;
+    impl.parent.newConnection(conn);
+}
+
+void TCPReactor::readStream(TCPConnData * conn)
+{
+    if ((uint)readBuf_.size() < conn->readBufferSize) {
+        TCPConnData::readBufferBytes.fetchAndAddRelaxed(conn->readBufferSize - readBuf_.size());
+        readBuf_.resize(conn->readBufferSize);
+    }
+    char * data = readBuf_.data();
+    const int fd = conn->socket;
 
-        TCPConnData * conn = impl->credentials_ ?
-            new TCPConnData(*impl, newSock, ip, port,
-                new TLSServer(*tlsSessions(), *(impl->credentials_)),
-                ++impl->tlsConnId_ % impl->tlsThreads_.size()) :
-            new TCPConnData(*impl, newSock, ip, port, 0, 0);
-        impl->connections_ << conn;
-        impl->parent.newConnection(conn);
+    // drain the socket as far as credit allows
+    bool notify = false;
+    bool gotBytes = false;
+    TCPConn::CloseType closeType = TCPConn::NotClosed;
+    while (conn->readCredit > 0) {
+        const int size = (int)qMin(conn->readCredit, (qint64)conn->readBufferSize);
+        TCPConnData::ioSyscalls.fetchAndAddRelaxed(1);
+        const ssize_t count = ::recv(fd, data, size, 0);
+        if (count > 0) {
+            logTrace("read %1 raw bytes from %2", (int)count, fd);
+            conn->readCredit -= count;
+            gotBytes = true;
+            if (conn->appendReadData(data, (int)count)) notify = true;
+            // socket is empty
+            if (count < size) break;
+        } else if (count == 0) {
+            logDebug("read channel closed on fd %1", fd);
+            closeType = TCPConn::ReadClosed;
+            break;
+        } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                logInfo("read on fd %1 failed (%2 - %3)", fd, errno, strerror(errno));
+                closeType = TCPConn::HardClosed;
+            }
+            break;
+        }
     }
+    if (gotBytes && impl.socketOptions.quickAck) TCPManagerImpl::rearmQuickAck(fd);
+
+    if (conn->readCredit <= 0) ev_io_stop(libEVLoop(), conn->readWatcher);
+    if (notify) conn->conn->newBytesAvailable();
+    if (closeType != TCPConn::NotClosed) closeConn(conn, closeType, false);
 }
 
-void TCPManagerImpl::callClosed(TCPConnData * conn)
+void TCPReactor::bytesReceived(TCPConnData * conn)
 {
-    if (conn->lastInformedCloseType == conn->closeType) return;
-    conn->lastInformedCloseType = conn->closeType;
-    if (conn->tlsStream) tlsThreads_[conn->tlsThreadId]->callClosed(conn);
-    else                 execLater(new Functor0<TCPConnData>(conn, &TCPConnData::callClosed));
+    if (!conn->tlsStream || conn->kernelTLSRx) conn->conn->newBytesAvailable();
+    else                                       impl.tlsRead(conn);
 }
 
-TCPConnData * TCPManagerImpl::addConnection(int sock, const QByteArray & destIP, quint16 destPort,
-    TLSCredentials * credentials, const QByteArray & destAddress)
+void TCPReactor::received(TCPConnData * conn, const QByteArray & data)
 {
-    SyncedThreadCall<TCPConnData *> stc(this);
-    if (!stc.verify(&TCPManagerImpl::addConnection, sock, destIP, destPort, credentials, destAddress)) return stc.retval();
+    const bool notify = conn->appendReadData(data);
+    if (!conn->streaming) {
+        bytesReceived(conn);
+        return;
+    }
 
-    TCPConnData * conn = credentials ?
-        new TCPConnData(*this, sock, destIP, destPort,
-            new TLSClient(*tlsSessions(), *credentials, destAddress), ++tlsConnId_ % tlsThreads_.size()) :
-        new TCPConnData(*this, sock, destIP, destPort, 0, 0);
-    connections_ << conn;
-    return conn;
+    // io_uring may exceed the credit by the bytes received at once
+    conn->readCredit -= data.size();
+    if (conn->readCredit > 0) uring_->startRead(conn);
+    if (notify) conn->conn->newBytesAvailable();
+}
+
+void TCPReactor::written(TCPConnData * conn, qint64 count)
+{
+    logTrace("wrote %1 bytes on %2 (%3 left)", count, conn->socket, conn->writeBuf.size());
+    const qint64 pending = conn->pendingWrite.fetchAndSubRelaxed(count) - count;
+    if (conn->writeBufferFull && pending <= (qint64)conn->writeLowWatermark) {
+        conn->writeBufferFull = false;
+        execLater(new Functor0<TCPConn>(conn->conn, &TCPConn::writeBufferDrained));
+    }
+
+    if (!conn->writeBuf.isEmpty()) {
+        if (count > 0 && conn->notifySomeBytesWritten) {
+            execLater(new Functor1<TCPConn, quint64>(conn->conn, &TCPConn::someBytesWritten, (quint64)count));
+        }
+        watchWrite(conn);
+        return;
+    }
+
+    if (conn->kernelTLSKeys) continueKernelTLS(conn);
+
+    if (conn->closeAfterWriting) {
+        closeConn(conn, TCPConn::WriteClosed, false);
+        if (conn->deleteAfterWriting) deleteConn(conn);
+    } else {
+        if (!uring_ && ev_is_active(conn->writeWatcher)) ev_io_stop(libEVLoop(), conn->writeWatcher);
+        if (conn->notifySomeBytesWritten) {
+            execLater(new Functor1<TCPConn, quint64>(conn->conn, &TCPConn::someBytesWritten, (quint64)count));
+        }
+        if (conn->notifyWrite) {
+            conn->notifyWrite = false;
+            execLater(new Functor0<TCPConn>(conn->conn, &TCPConn::writeFinished));
+        }
+    }
+}
+
+void TCPReactor::watchWrite(TCPConnData * conn)
+{
+    if (uring_) {
+        uring_->startWrite(conn);
+        return;
+    }
+
+    // a pipe without data is watched instead of the socket
+    const int pipe = conn->writeBuf.waitingPipe();
+    const int fd = pipe != -1 ? pipe : conn->socket;
+    ev_io * w = conn->writeWatcher;
+    if (ev_is_active(w)) {
+        if (w->fd == fd) return;
+        ev_io_stop(libEVLoop(), w);
+    }
+    ev_io_set(w, fd, pipe != -1 ? EV_READ : EV_WRITE);
+    ev_io_start(libEVLoop(), w);
+}
+
+void TCPReactor::writeFailed(TCPConnData * conn, int error)
+{
+    logDebug("write on fd %1 failed (%2 - %3)", conn->socket, error, strerror(error));
+    clearWriteBuffer(conn);
+    closeConn(conn, error == EPIPE ? TCPConn::WriteClosed : TCPConn::HardClosed, false);
+    if (conn->deleteAfterWriting) deleteConn(conn);
+}
+
+void TCPReactor::deleteConn(TCPConnData * conn)
+{
+    connections_.remove(conn);
+    // io_uring deletes the connection after the last completion
+    if (uring_ && !uring_->release(conn)) return;
+    delete conn;
+}
+
+void TCPReactor::closeSocket(TCPConnData * conn)
+{
+    if (uring_) uring_->closeSocket(conn);
+    close(conn->socket);
+    logDebug("fd %1 closed", conn->socket);
+}
+
+void TCPReactor::dropConnection(TCPConnData * conn)
+{
+    if (conn->tlsStream) impl.tlsDeleteOnFinish(conn);
+    else                 deleteOnFinish(conn);
+}
+
+bool TCPReactor::isReusable(TCPConnData * conn)
+{
+    if (conn->closeType != TCPConn::NotClosed || !conn->writeBuf.isEmpty() || !conn->readData.isEmpty()) return false;
+    if (uring_ && uring_->hasInput(conn)) return false;
+
+    // The peer must neither have closed nor sent anything (socket is non blocking).
+    char c;
+    TCPConnData::ioSyscalls.fetchAndAddRelaxed(1);
+    return ::recv(conn->socket, &c, 1, MSG_PEEK) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+void TCPReactor::expireIdleConnections()
+{
+    QMutableHashIterator<QByteArray, QList<IdleConn>> it(idleConns_);
+    while (it.hasNext()) {
+        QMutableListIterator<IdleConn> li(it.next().value());
+        while (li.hasNext()) {
+            const IdleConn idle = li.next();
+            if (idle.expires.hasExpired() || !isReusable(idle.conn)) {
+                li.remove();
+                --idleCount_;
+                dropConnection(idle.conn);
+            }
+        }
+        if (it.value().isEmpty()) it.remove();
+    }
+    if (idleCount_ == 0) idleTimer_.stop();
+}
+
+void TCPReactor::enableKernelTLS(TCPConnData * conn, const TLSTrafficKeys & keys, bool startRead)
+{
+    if (!verifyThreadCall(&TCPReactor::enableKernelTLS, conn, keys, startRead)) return;
+
+    conn->kernelTLSKeys = new TLSTrafficKeys(keys);
+    conn->kernelTLSStartRead = startRead;
+    continueKernelTLS(conn);
+}
+
+// RX keys are installed when no encrypted bytes are on the way,
+// TX keys after all bytes encrypted by the TLS thread have been sent.
+void TCPReactor::continueKernelTLS(TCPConnData * conn)
+{
+#ifdef Q_OS_LINUX
+    if (conn->closeType != TCPConn::NotClosed) {
+        finishKernelTLS(conn, false);
+        return;
+    }
+
+    if (!conn->kernelTLSRx) {
+        // continued by IOUringEngine after the last recv
+        if (uring_ && uring_->isReceiving(conn)) {
+            uring_->stopRead(conn);
+            return;
+        }
+        if (uring_ && uring_->hasInput(conn)) {
+            finishKernelTLS(conn, false);
+            return;
+        }
+        if (setsockopt(conn->socket, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+            logInfo("kernel TLS not available on fd %1 (%2 - %3)", conn->socket, errno, strerror(errno));
+            finishKernelTLS(conn, false);
+            return;
+        }
+        if (!setKernelTLSKeys(conn->socket, TLS_RX, *conn->kernelTLSKeys)) {
+            logInfo("kernel TLS cipher not available on fd %1 (%2 - %3)", conn->socket, errno, strerror(errno));
+            finishKernelTLS(conn, false);
+            return;
+        }
+        conn->kernelTLSRx = true;
+        if (qExchange(conn->kernelTLSStartRead, false)) startReadWatcher(conn);
+    }
+
+    // continued by written
+    if (!conn->writeBuf.isEmpty()) return;
+
+    // reading is already done by the kernel
+    if (!setKernelTLSKeys(conn->socket, TLS_TX, *conn->kernelTLSKeys)) {
+        logWarn("cannot set kernel TLS TX keys on fd %1 (%2 - %3)", conn->socket, errno, strerror(errno));
+        finishKernelTLS(conn, false);
+        closeConn(conn, TCPConn::HardClosed, true);
+        return;
+    }
+    logDebug("kernel TLS enabled on fd %1", conn->socket);
+    finishKernelTLS(conn, true);
+#else
+    finishKernelTLS(conn, false);
+#endif
+}
+
+void TCPReactor::finishKernelTLS(TCPConnData * conn, bool ok)
+{
+    delete conn->kernelTLSKeys;
+    conn->kernelTLSKeys = 0;
+    impl.tlsKernelTLSEnabled(conn, ok);
+    if (qExchange(conn->kernelTLSStartRead, false)) startReadWatcher(conn);
+}
+
+void TCPReactor::callClosed(TCPConnData * conn)
+{
+    if (conn->lastInformedCloseType == conn->closeType) return;
+    conn->lastInformedCloseType = conn->closeType;
+    if (conn->tlsStream) impl.tlsCallClosed(conn);
+    else                 execLater(new Functor0<TCPConnData>(conn, &TCPConnData::callClosed));
 }
 
 }}}    // namespace
@@ -8,71 +8,194 @@
 #pragma once
 
 #include <cflib/crypt/tlscredentials.h>
+#include <cflib/crypt/tlssessions.h>
 #include <cflib/net/tcpconn.h>
+#include <cflib/net/tcpmanager.h>
+#include <cflib/util/evtimer.h>
 #include <cflib/util/threadverify.h>
 
 struct ev_io;
 
+namespace cflib { namespace crypt { struct TLSTrafficKeys; }}
+
 namespace cflib { namespace net {
 
-class TCPManager;
+class DNSResolver;
 
 namespace impl {
 
+class IOUringEngine;
+class TCPReactor;
+class TLSHandshakePool;
+struct TLSCounters;
 class TLSThread;
 
 class TCPManagerImpl : public util::ThreadVerify
 {
 public:
-    TCPManagerImpl(TCPManager & parent, uint tlsThreadCount);
-    TCPManagerImpl(TCPManager & parent, uint tlsThreadCount, util::ThreadVerify * other);
+    TCPManagerImpl(TCPManager & parent, uint tlsThreadCount, uint reactorCount, TCPManager::IOBackend backend);
+    TCPManagerImpl(TCPManager & parent, uint tlsThreadCount, uint reactorCount, TCPManager::IOBackend backend,
+        util::ThreadVerify * other);
     ~TCPManagerImpl();
 
-    bool isRunning() const { return listenSock_ != -1; }
+    bool isRunning() const { return isRunning_; }
+    bool start(const QByteArray & ip, quint16 port, crypt::TLSCredentials * credentials);
     bool start(int listenSocket, crypt::TLSCredentials * credentials);
     void stop();
 
     TCPConnData * openConnection(const QByteArray & destAddress, quint16 destPort,
         const QByteArray & sourceIP, quint16 sourcePort,
         crypt::TLSCredentials * credentials, bool preferIPv6);
+    TCPConnData * openPooledConnection(const QByteArray & destAddress, quint16 destPort,
+        crypt::TLSCredentials * credentials, bool preferIPv6, bool * reused);
+    void releaseConnection(TCPConnData * conn);
+    void setConnectionPool(uint maxIdle, uint maxIdlePerHost, uint idleTimeoutSec);
+    void openConnection(const QByteArray & destAddress, quint16 destPort,
+        const QByteArray & sourceIP, quint16 sourcePort,
+        crypt::TLSCredentials * credentials, bool preferIPv6,
+        const TCPManager::ConnectCallback & callback);
 
-    void startReadWatcher(TCPConnData * conn);
-    void writeToSocket(TCPConnData * conn, const QByteArray & data, bool notifyFinished);
-    void closeConn(TCPConnData * conn, TCPConn::CloseType type, bool notifyClose);
-    void deleteOnFinish(TCPConnData * conn);
+    // must be called before start
+    void setTLSHandshakeThreads(uint threadCount, uint maxPendingHandshakes);
+    TLSHandshakePool * handshakePool() const { return handshakePool_; }
+    uint selectTLSThread() const;
+    void tlsConnectionDeleted(uint tlsThreadId) const;
+    TLSCounters & tlsCounters(const TCPConnData * conn) const;
+    QList<TCPManager::TLSThreadStats> tlsThreadStats() const;
 
     void tlsStartReadWatcher(TCPConnData * conn);
+    void tlsRead(TCPConnData * conn) const;
     void tlsWrite(TCPConnData * conn, const QByteArray & data, bool notifyFinished) const;
+    void tlsWriteFile(TCPConnData * conn, int fd, qint64 offset, qint64 length, bool notifyFinished) const;
     void tlsCloseConn(TCPConnData * conn, TCPConn::CloseType type, bool notifyClose) const;
+    void tlsSetCork(TCPConnData * conn, bool cork) const;
     void tlsDeleteOnFinish(TCPConnData * conn) const;
+    void tlsCallClosed(TCPConnData * conn) const;
+    void tlsKernelTLSEnabled(TCPConnData * conn, bool ok) const;
+    void tlsHandshakeRead(TCPConnData * conn, const QByteArray & plain, bool ok) const;
 
+    static QByteArray poolKey(const QByteArray & destAddress, quint16 destPort, bool tls);
     static void setNoDelay(int socket, bool noDelay);
-    static int openListenSocket(const QByteArray & ip, quint16 port);
-
-    static void readable(ev_loop * loop, ev_io * w, int revents);
-    static void writeable(ev_loop * loop, ev_io * w, int revents);
+    static void applySocketOptions(int socket, const TCPManager::SocketOptions & options);
+    static void rearmQuickAck(int socket);
+    static int openListenSocket(const QByteArray & ip, quint16 port, bool reusePort = false,
+        const TCPManager::SocketOptions & options = TCPManager::SocketOptions());
 
     TCPManager & parent;
 
     crypt::TLSCredentials clientCredentials;
+    TCPManager::SocketOptions socketOptions;
+    crypt::TLSSessions serverSessions;    // shared by all TLSThreads
+    bool kernelTLS;                       // see TCPManager::setKernelTLS
 
 protected:
     virtual void deleteThreadData();
 
 private:
-    static void listenSocketReadable(ev_loop * loop, ev_io * w, int revents);
-    void callClosed(TCPConnData * conn);
+    void init(uint tlsThreadCount, uint reactorCount, TCPManager::IOBackend backend, bool ownThread);
+    bool startReactors(const QList<int> & listenSockets, crypt::TLSCredentials * credentials);
+    TCPConnData * connectTo(const QList<QByteArray> & ips,
+        const QByteArray & destAddress, quint16 destPort,
+        const QByteArray & sourceIP, quint16 sourcePort,
+        crypt::TLSCredentials * credentials);
+    DNSResolver * resolver();
+    TCPReactor * reactorOfThread() const;
+
+private:
+    bool isRunning_;
+    QList<int> listenSocks_;
+    crypt::TLSCredentials * credentials_;
+    QVector<TLSThread *> tlsThreads_;
+    TLSHandshakePool * handshakePool_;
+    // first reactor shares the thread of this object
+    QVector<TCPReactor *> reactors_;
+    QAtomicInteger<uint> nextReactor_;
+    QMutex resolverMutex_;
+    DNSResolver * resolver_;
+    // connection pool limits (per reactor)
+    uint poolMaxIdle_;
+    uint poolMaxIdlePerHost_;
+    uint poolIdleTimeoutSec_;
+    friend class TCPReactor;
+};
+
+// one libev thread doing accept, recv, send and close for its connections
+class TCPReactor : public util::ThreadVerify
+{
+public:
+    TCPReactor(TCPManagerImpl & impl, uint no, uint total);
+    TCPReactor(TCPManagerImpl & impl, util::ThreadVerify * other);
+    ~TCPReactor();
+
+    bool startListening(int listenSocket);
+    void stop();
+    bool initIOUring();
+    IOUringEngine * ioUring() const { return uring_; }
+
     TCPConnData * addConnection(int sock, const QByteArray & destIP, quint16 destPort,
         crypt::TLSCredentials * credentials, const QByteArray & destAddress);
 
+    // idle outbound connections of this reactor
+    TCPConnData * checkoutConnection(const QByteArray & poolKey);
+    void releaseConnection(TCPConnData * conn);
+
+    void startReadWatcher(TCPConnData * conn);
+    void addReadCredit(TCPConnData * conn, quint64 credit);
+    void writeToSocket(TCPConnData * conn, const QByteArray & data, bool notifyFinished);
+    void writeFile(TCPConnData * conn, int fd, qint64 offset, qint64 length, bool notifyFinished);
+    void setWriteWatermarks(TCPConnData * conn, quint64 high, quint64 low, quint64 maxPending);
+    void closeConn(TCPConnData * conn, TCPConn::CloseType type, bool notifyClose);
+    void setCork(TCPConnData * conn, bool cork);
+    void deleteOnFinish(TCPConnData * conn);
+    // TLS thread has stopped using the stream (reading is continued, if startRead is set)
+    void enableKernelTLS(TCPConnData * conn, const crypt::TLSTrafficKeys & keys, bool startRead);
+
+    static void readable(ev_loop * loop, ev_io * w, int revents);
+    static void writeable(ev_loop * loop, ev_io * w, int revents);
+
+    TCPManagerImpl & impl;
+
+protected:
+    void deleteThreadData() override;
+
+private:
+    static void listenSocketReadable(ev_loop * loop, ev_io * w, int revents);
+    void callClosed(TCPConnData * conn);
+    void accepted(int sock, const char * ip, quint16 port);
+    void readStream(TCPConnData * conn);
+    void bytesReceived(TCPConnData * conn);
+    void received(TCPConnData * conn, const QByteArray & data);
+    void startWriting(TCPConnData * conn, bool notifyFinished);
+    void checkWriteBuffer(TCPConnData * conn);
+    void clearWriteBuffer(TCPConnData * conn);
+    void watchWrite(TCPConnData * conn);
+    void written(TCPConnData * conn, qint64 count);
+    void writeFailed(TCPConnData * conn, int error);
+    void deleteConn(TCPConnData * conn);
+    void closeSocket(TCPConnData * conn);
+    void dropConnection(TCPConnData * conn);
+    bool isReusable(TCPConnData * conn);
+    void expireIdleConnections();
+    void continueKernelTLS(TCPConnData * conn);
+    void finishKernelTLS(TCPConnData * conn, bool ok);
+
 private:
+    const bool ownThread_;
+    IOUringEngine * uring_;    // completion based I/O instead of watchers, if set
     int listenSock_;
     bool isIPv6Sock_;
     ev_io * readWatcher_;
-    crypt::TLSCredentials * credentials_;
-    QVector<TLSThread *> tlsThreads_;
-    QAtomicInteger<uint> tlsConnId_;
     QSet<TCPConnData *> connections_;
+    QByteArray readBuf_;    // all connections of this reactor recv into this buffer
+    struct IdleConn {
+        TCPConnData * conn;
+        QDeadlineTimer expires;
+    };
+    QHash<QByteArray, QList<IdleConn>> idleConns_;    // most recently released last
+    uint idleCount_;
+    util::EVTimer idleTimer_;
+    friend class IOUringEngine;
+    friend class TCPManagerImpl;
 };
 
 }}}    // namespace
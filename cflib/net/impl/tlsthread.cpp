@@ -10,12 +10,34 @@
 #include <cflib/crypt/tlsstream.h>
 #include <cflib/net/impl/tcpconndata.h>
 #include <cflib/net/impl/tcpmanagerimpl.h>
+#include <cflib/util/log.h>
+
+USE_LOG(LogCat::Network)
 
 namespace cflib { namespace net { namespace impl {
 
-TLSThread::TLSThread(TCPManagerImpl & impl, uint no, uint total) :
-    ThreadVerify(QString("TLSThread %1/%2").arg(no).arg(total), ThreadVerify::Worker),
-    impl_(impl)
+namespace {
+
+bool decrypt(TCPConnData * conn, TLSCounters & counters, QByteArray & plain, QByteArray & sendBack)
+{
+    const bool inHandshake = !conn->tlsStream->isEstablished();
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = conn->tlsStream->received(conn->readData, plain, sendBack);
+    counters.botanNsecs.fetchAndAddRelaxed(timer.nsecsElapsed());
+    counters.bytesReceived.fetchAndAddRelaxed(conn->readData.size());
+    counters.bytesSent.fetchAndAddRelaxed(sendBack.size());
+    if (inHandshake) {
+        if (!ok)                                     counters.handshakeFailures.fetchAndAddRelaxed(1);
+        else if (conn->tlsStream->isEstablished()) counters.handshakes.fetchAndAddRelaxed(1);
+    }
+    return ok;
+}
+
+}
+
+TLSThread::TLSThread(uint no, uint total) :
+    ThreadVerify(QString("TLSThread %1/%2").arg(no).arg(total), ThreadVerify::Worker)
 {
 }
 
@@ -27,26 +49,52 @@ TLSThread::~TLSThread()
 void TLSThread::startReadWatcher(TCPConnData * conn)
 {
     if (!verifyThreadCall(&TLSThread::startReadWatcher, conn)) return;
-    impl_.startReadWatcher(conn);
+    conn->reactor.startReadWatcher(conn);
 }
 
 void TLSThread::read(TCPConnData * conn)
 {
     if (!verifyThreadCall(&TLSThread::read, conn)) return;
 
+    // Handshakes are done by the pool. Writes are held back meanwhile.
+    TLSHandshakePool * pool = conn->impl.handshakePool();
+    if (pool && !conn->tlsStream->isEstablished()) {
+        if (!pool->startRead(conn)) {
+            logInfo("TLS handshake of fd %1 rejected", conn->socket);
+            conn->setReadData(QByteArray());
+            conn->reactor.closeConn(conn, TCPConn::HardClosed, true);
+            return;
+        }
+        conn->tlsInPool = true;
+        return;
+    }
+
     QByteArray sendBack;
     QByteArray plain;
-    bool ok = conn->tlsStream->received(conn->readData, plain, sendBack);
-    if (!sendBack.isEmpty()) impl_.writeToSocket(conn, sendBack, false);
+    bool ok = decrypt(conn, counters, plain, sendBack);
+    if (!sendBack.isEmpty()) conn->reactor.writeToSocket(conn, sendBack, false);
+    processed(conn, plain, ok);
+}
+
+void TLSThread::processed(TCPConnData * conn, const QByteArray & plain, bool ok)
+{
+    // Hand over the records to the kernel after the handshake.
+    // Writes are held back until the reactor has sent all bytes encrypted by the stream.
+    crypt::TLSTrafficKeys keys;
+    const bool switchToKernel = ok && conn->kernelTLSState == TCPConnData::NoKernelTLS &&
+        conn->impl.kernelTLS && conn->tlsStream->trafficKeys(keys);
+    if (switchToKernel) conn->kernelTLSState = TCPConnData::KernelTLSSwitching;
 
     if (plain.isEmpty()) {
-        conn->readData.resize(0);
-        if (ok) impl_.startReadWatcher(conn);
-        else    impl_.closeConn(conn, TCPConn::ReadWriteClosed, true);
+        conn->setReadData(QByteArray());
+        if (switchToKernel) conn->reactor.enableKernelTLS(conn, keys, true);
+        else if (ok)        conn->reactor.startReadWatcher(conn);
+        else                conn->reactor.closeConn(conn, TCPConn::ReadWriteClosed, true);
     } else {
-        conn->readData = plain;
+        if (switchToKernel) conn->reactor.enableKernelTLS(conn, keys, false);
+        conn->setReadData(plain);
         conn->conn->newBytesAvailable();
-        if (!ok) impl_.closeConn(conn, TCPConn::ReadWriteClosed, false);
+        if (!ok) conn->reactor.closeConn(conn, TCPConn::ReadWriteClosed, false);
     }
 }
 
@@ -54,24 +102,63 @@ void TLSThread::write(TCPConnData * conn, const QByteArray & data, bool notifyFi
 {
     if (!verifyThreadCall(&TLSThread::write, conn, data, notifyFinished)) return;
 
+    if (conn->tlsInPool || conn->kernelTLSState == TCPConnData::KernelTLSSwitching) {
+        conn->tlsHeldWrites << qMakePair(data, notifyFinished);
+        return;
+    }
+    if (conn->kernelTLSState == TCPConnData::KernelTLSActive) {
+        conn->reactor.writeToSocket(conn, data, notifyFinished);
+        return;
+    }
+
     QByteArray enc;
-    if (!conn->tlsStream->send(data, enc)) {
-        impl_.closeConn(conn, TCPConn::ReadWriteClosed, notifyFinished);
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = conn->tlsStream->send(data, enc);
+    counters.botanNsecs.fetchAndAddRelaxed(timer.nsecsElapsed());
+    counters.bytesSent.fetchAndAddRelaxed(enc.size());
+    if (!ok) {
+        conn->reactor.closeConn(conn, TCPConn::ReadWriteClosed, notifyFinished);
     } else {
-        impl_.writeToSocket(conn, enc, notifyFinished);
+        conn->reactor.writeToSocket(conn, enc, notifyFinished);
     }
 }
 
+void TLSThread::writeFile(TCPConnData * conn, int fd, qint64 offset, qint64 length, bool notifyFinished)
+{
+    if (!verifyThreadCall(&TLSThread::writeFile, conn, fd, offset, length, notifyFinished)) return;
+
+    // only called for kernel TLS
+    conn->reactor.writeFile(conn, fd, offset, length, notifyFinished);
+}
+
 void TLSThread::closeConn(TCPConnData * conn, TCPConn::CloseType type, bool notifyClose)
 {
     if (!verifyThreadCall(&TLSThread::closeConn, conn, type, notifyClose)) return;
-    impl_.closeConn(conn, type, notifyClose);
+    conn->reactor.closeConn(conn, type, notifyClose);
+}
+
+void TLSThread::setCork(TCPConnData * conn, bool cork)
+{
+    if (!verifyThreadCall(&TLSThread::setCork, conn, cork)) return;
+    conn->reactor.setCork(conn, cork);
 }
 
 void TLSThread::deleteOnFinish(TCPConnData * conn)
 {
     if (!verifyThreadCall(&TLSThread::deleteOnFinish, conn)) return;
-    impl_.deleteOnFinish(conn);
+    // the pool still uses conn
+    if (conn->tlsInPool) {
+        conn->tlsDeleteAfterHandshake = true;
+        return;
+    }
+    conn->reactor.deleteOnFinish(conn);
+}
+
+void TLSThread::releaseConnection(TCPConnData * conn)
+{
+    if (!verifyThreadCall(&TLSThread::releaseConnection, conn)) return;
+    conn->reactor.releaseConnection(conn);
 }
 
 void TLSThread::callClosed(TCPConnData * conn)
@@ -80,4 +167,75 @@ void TLSThread::callClosed(TCPConnData * conn)
     conn->callClosed();
 }
 
+void TLSThread::kernelTLSEnabled(TCPConnData * conn, bool ok)
+{
+    if (!verifyThreadCall(&TLSThread::kernelTLSEnabled, conn, ok)) return;
+
+    conn->kernelTLSState = ok ? TCPConnData::KernelTLSActive : TCPConnData::KernelTLSFailed;
+    if (ok) conn->kernelTLS.storeRelease(true);
+    writeHeld(conn);
+}
+
+void TLSThread::handshakeRead(TCPConnData * conn, const QByteArray & plain, bool ok)
+{
+    if (!verifyThreadCall(&TLSThread::handshakeRead, conn, plain, ok)) return;
+
+    conn->tlsInPool = false;
+    if (conn->tlsDeleteAfterHandshake) {
+        conn->tlsHeldWrites.clear();
+        conn->reactor.deleteOnFinish(conn);
+        return;
+    }
+    processed(conn, plain, ok);
+    writeHeld(conn);
+}
+
+void TLSThread::writeHeld(TCPConnData * conn)
+{
+    // writes may be held again (kernel TLS switch)
+    typedef QPair<QByteArray, bool> HeldWrite;
+    const QList<HeldWrite> held = conn->tlsHeldWrites;
+    conn->tlsHeldWrites.clear();
+    foreach (const HeldWrite & w, held) write(conn, w.first, w.second);
+}
+
+TLSHandshakePool::TLSHandshakePool(uint threadCount, uint maxPending) :
+    ThreadVerify("TLSHandshake", ThreadVerify::Worker, threadCount),
+    maxPending_(maxPending),
+    pending_(0),
+    rejected_(0)
+{
+}
+
+TLSHandshakePool::~TLSHandshakePool()
+{
+    stopVerifyThread();
+}
+
+bool TLSHandshakePool::startRead(TCPConnData * conn)
+{
+    // only new handshakes are rejected, started ones are finished
+    const uint pending = pending_.fetchAndAddRelaxed(1);
+    if (maxPending_ > 0 && pending >= maxPending_ && !conn->tlsHandshakeStarted) {
+        pending_.fetchAndSubRelaxed(1);
+        rejected_.fetchAndAddRelaxed(1);
+        return false;
+    }
+    conn->tlsHandshakeStarted = true;
+    read(conn);
+    return true;
+}
+
+void TLSHandshakePool::read(TCPConnData * conn)
+{
+    if (!verifyThreadCall(&TLSHandshakePool::read, conn)) return;
+
+    QByteArray sendBack;
+    QByteArray plain;
+    const bool ok = decrypt(conn, conn->impl.tlsCounters(conn), plain, sendBack);
+    if (!sendBack.isEmpty()) conn->reactor.writeToSocket(conn, sendBack, false);
+    pending_.fetchAndSubRelaxed(1);
+    conn->impl.tlsHandshakeRead(conn, plain, ok);
+}
+
 }}}    // namespace
@@ -16,23 +16,65 @@ class TCPConnData;
 
 namespace impl {
 
-class TCPManagerImpl;
+// written by the TLS thread of a connection or the handshake pool (see TCPManager::tlsThreadStats)
+struct TLSCounters
+{
+    QAtomicInteger<quint64> handshakes;
+    QAtomicInteger<quint64> handshakeFailures;
+    QAtomicInteger<quint64> bytesReceived;    // encrypted
+    QAtomicInteger<quint64> bytesSent;        // encrypted
+    QAtomicInteger<quint64> botanNsecs;       // time spent in TLSStream
+};
 
 class TLSThread : public util::ThreadVerify
 {
 public:
-    TLSThread(TCPManagerImpl & impl, uint no, uint total);
+    TLSThread(uint no, uint total);
     ~TLSThread();
 
     void startReadWatcher(TCPConnData * conn);
     void read(TCPConnData * conn);
     void write(TCPConnData * conn, const QByteArray & data, bool notifyFinished);
+    void writeFile(TCPConnData * conn, int fd, qint64 offset, qint64 length, bool notifyFinished);
     void closeConn(TCPConnData * conn, TCPConn::CloseType type, bool notifyClose);
+    void setCork(TCPConnData * conn, bool cork);
     void deleteOnFinish(TCPConnData * conn);
+    void releaseConnection(TCPConnData * conn);
     void callClosed(TCPConnData * conn);
+    void kernelTLSEnabled(TCPConnData * conn, bool ok);
+    void handshakeRead(TCPConnData * conn, const QByteArray & plain, bool ok);
+
+    // established connections of this thread (load of this thread)
+    QAtomicInteger<uint> connCount;
+    TLSCounters counters;
+
+private:
+    void processed(TCPConnData * conn, const QByteArray & plain, bool ok);
+    void writeHeld(TCPConnData * conn);
+};
+
+// Worker threads doing the asymmetric crypto of TLS handshakes, so that
+// the TLSThreads of established connections are not blocked by reconnect storms.
+// A connection stays in its TLSThread, only reads during the handshake are done here.
+class TLSHandshakePool : public util::ThreadVerify
+{
+public:
+    // maxPending == 0: unlimited
+    TLSHandshakePool(uint threadCount, uint maxPending);
+    ~TLSHandshakePool();
+
+    // returns false, if a new handshake is rejected because of too many pending reads
+    bool startRead(TCPConnData * conn);
+
+    quint64 rejected() const { return rejected_.loadRelaxed(); }
+
+private:
+    void read(TCPConnData * conn);
 
 private:
-    TCPManagerImpl & impl_;
+    const uint maxPending_;
+    QAtomicInteger<uint> pending_;
+    QAtomicInteger<quint64> rejected_;
 };
 
 }}}    // namespace
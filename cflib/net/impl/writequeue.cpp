@@ -0,0 +1,177 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include "writequeue.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifndef Q_OS_WIN
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#else
+    #include <io.h>
+    #include <winsock2.h>
+#endif
+
+#ifdef Q_OS_LINUX
+    #include <fcntl.h>
+    #include <sys/sendfile.h>
+    #include <sys/stat.h>
+#endif
+
+namespace cflib { namespace net { namespace impl {
+
+namespace {
+
+// sendfile transfers at most 0x7ffff000 bytes at once
+const qint64 MaxFileChunk = 0x40000000;
+
+}
+
+#ifdef IOV_MAX
+const int WriteQueue::MaxSegments = IOV_MAX < 1024 ? IOV_MAX : 1024;
+#else
+const int WriteQueue::MaxSegments = 1024;
+#endif
+
+void WriteQueue::append(const QByteArray & data)
+{
+    if (data.isEmpty()) return;
+    segments_ << Segment{ data, -1, false, 0, data.size() };
+    size_ += data.size();
+}
+
+void WriteQueue::appendFile(int fd, qint64 offset, qint64 length)
+{
+    if (length <= 0) {
+        ::close(fd);
+        return;
+    }
+#ifdef Q_OS_LINUX
+    struct stat st;
+    const bool isPipe = fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+#else
+    const bool isPipe = false;
+#endif
+    segments_ << Segment{ QByteArray(), fd, isPipe, offset, length };
+    size_ += length;
+}
+
+void WriteQueue::clear()
+{
+    foreach (const Segment & seg, segments_) if (seg.fd != -1) ::close(seg.fd);
+    segments_.clear();
+    offset_ = 0;
+    size_ = 0;
+}
+
+qint64 WriteQueue::send(int fd)
+{
+    if (size_ == 0) return 0;
+
+#ifdef Q_OS_LINUX
+    const Segment & first = segments_.first();
+    if (first.fd != -1) {
+        const size_t len = (size_t)qMin(first.size - offset_, MaxFileChunk);
+        qint64 rv;
+        if (first.isPipe) {
+            rv = ::splice(first.fd, 0, fd, 0, len, SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+        } else {
+            off_t off = first.offset + offset_;
+            rv = ::sendfile(fd, first.fd, &off, len);
+        }
+        // file is shorter than announced
+        if (rv == 0) {
+            errno = EIO;
+            return -1;
+        }
+        if (rv > 0) consume(rv);
+        return rv;
+    }
+#endif
+
+#ifndef Q_OS_WIN
+    iovec vec[MaxSegments];
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = vec;
+    msg.msg_iovlen = fill(vec, MaxSegments);
+
+    #ifdef Q_OS_LINUX
+        const qint64 rv = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+    #else
+        const qint64 rv = ::sendmsg(fd, &msg, 0);
+    #endif
+#else
+    const QByteArray & seg = segments_.first().data;
+    const qint64 rv = ::send(fd, seg.constData() + offset_, seg.size() - offset_, 0);
+#endif
+
+    if (rv > 0) consume(rv);
+    return rv;
+}
+
+#ifndef Q_OS_WIN
+int WriteQueue::fill(iovec * vec, int max) const
+{
+    const int count = qMin(segments_.size(), max);
+    for (int i = 0 ; i < count ; ++i) {
+        const QByteArray & seg = segments_[i].data;
+        if (segments_[i].fd != -1) return i;
+        const int offset = i == 0 ? (int)offset_ : 0;
+        vec[i].iov_base = (void *)(seg.constData() + offset);
+        vec[i].iov_len  = seg.size() - offset;
+    }
+    return count;
+}
+
+#endif
+
+int WriteQueue::waitingPipe() const
+{
+    if (segments_.isEmpty() || !segments_.first().isPipe) return -1;
+#ifdef Q_OS_LINUX
+    pollfd pfd;
+    pfd.fd      = segments_.first().fd;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    return ::poll(&pfd, 1, 0) == 0 ? pfd.fd : -1;
+#else
+    return -1;
+#endif
+}
+
+QList<QByteArray> WriteQueue::head(int count) const
+{
+    QList<QByteArray> rv;
+    for (int i = 0 ; i < count ; ++i) rv << segments_[i].data;
+    return rv;
+}
+
+void WriteQueue::consume(qint64 count)
+{
+    size_ -= count;
+    while (count > 0) {
+        const Segment & first = segments_.first();
+        const qint64 left = first.size - offset_;
+        if (count < left) {
+            offset_ += count;
+            return;
+        }
+        count -= left;
+        if (first.fd != -1) ::close(first.fd);
+        segments_.removeFirst();
+        offset_ = 0;
+    }
+}
+
+}}}    // namespace
@@ -0,0 +1,63 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include <QtCore>
+
+struct iovec;
+
+namespace cflib { namespace net { namespace impl {
+
+// Pending bytes of one socket.
+// Holds the written QByteArrays (implicitly shared, no copy)
+// and sends as many of them as possible with one call of sendmsg.
+// File segments are sent by the kernel directly (sendfile, splice for pipes).
+class WriteQueue
+{
+    Q_DISABLE_COPY(WriteQueue)
+public:
+    WriteQueue() : offset_(0), size_(0) {}
+    ~WriteQueue() { clear(); }
+
+    void append(const QByteArray & data);
+    // takes ownership of fd (Linux only)
+    void appendFile(int fd, qint64 offset, qint64 length);
+    void clear();
+    bool isEmpty() const { return size_ == 0; }
+    qint64 size() const  { return size_; }
+    int segmentCount() const { return segments_.size(); }
+
+    // returns the result of sendmsg, sendfile or splice and removes all sent bytes
+    qint64 send(int fd);
+
+    // file segments can only be sent by send
+    bool fileAtHead() const { return !segments_.isEmpty() && segments_.first().fd != -1; }
+    // pipe at head which has no data, otherwise -1
+    int waitingPipe() const;
+
+    // for asynchronous sends: fill vec with up to max segments (until the first file) and call consume after sending
+    int fill(iovec * vec, int max) const;
+    QList<QByteArray> head(int count) const;
+    void consume(qint64 count);
+
+    static const int MaxSegments;
+
+private:
+    struct Segment {
+        QByteArray data;
+        int fd;            // -1 for data
+        bool isPipe;
+        qint64 offset;     // in file
+        qint64 size;
+    };
+    QList<Segment> segments_;
+    qint64 offset_;    // already sent bytes of first segment
+    qint64 size_;
+};
+
+}}}    // namespace
@@ -0,0 +1,122 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include <cflib/net/dns.h>
+#include <cflib/util/test.h>
+
+using namespace cflib::net;
+
+namespace {
+
+class Result
+{
+public:
+    Result() : calls(0), thread(0) {}
+
+    DNSResolver::Callback callback()
+    {
+        return [this](const QList<QByteArray> & ips) {
+            QMutexLocker ml(&mutex);
+            this->ips = ips;
+            ++calls;
+            thread = QThread::currentThread();
+            sem.release();
+        };
+    }
+
+    QMutex mutex;
+    QSemaphore sem;
+    QList<QByteArray> ips;
+    int calls;
+    QThread * thread;
+};
+
+}
+
+class DNS_Test: public QObject
+{
+    Q_OBJECT
+private slots:
+
+    void init()
+    {
+        DNSResolver::clearCache();
+    }
+
+    void test_ipAddress()
+    {
+        DNSResolver resolver;
+        Result res;
+        resolver.resolve("127.0.0.1", false, res.callback());
+        // no lookup needed
+        QCOMPARE(res.calls, 1);
+        QCOMPARE(res.thread, QThread::currentThread());
+        QCOMPARE(res.ips, QList<QByteArray>() << "127.0.0.1");
+    }
+
+    void test_cache()
+    {
+        DNSResolver resolver;
+        QList<QByteArray> ips;
+        QVERIFY(!DNSResolver::cached("localhost", false, ips));
+
+        Result first;
+        resolver.resolve("localhost", false, first.callback());
+        first.sem.acquire();
+        QVERIFY(!first.ips.isEmpty());
+        QVERIFY(first.thread != QThread::currentThread());
+
+        // second lookup is answered from cache
+        Result second;
+        resolver.resolve("localhost", false, second.callback());
+        QCOMPARE(second.calls, 1);
+        QCOMPARE(second.thread, QThread::currentThread());
+        QCOMPARE(second.ips, first.ips);
+        QVERIFY(DNSResolver::cached("localhost", false, ips));
+        QCOMPARE(ips, first.ips);
+        QCOMPARE(getCachedIPFromDNS("localhost"), first.ips);
+    }
+
+    void test_negativeCache()
+    {
+        DNSResolver resolver;
+        Result first;
+        resolver.resolve("does.not.exist.invalid", false, first.callback());
+        first.sem.acquire();
+        QVERIFY(first.ips.isEmpty());
+
+        QList<QByteArray> ips;
+        QVERIFY(DNSResolver::cached("does.not.exist.invalid", false, ips));
+        QVERIFY(ips.isEmpty());
+    }
+
+    void test_expiry()
+    {
+        DNSResolver::setCacheTTL(0, 0);
+        DNSResolver resolver;
+        Result res;
+        resolver.resolve("localhost", false, res.callback());
+        res.sem.acquire();
+        QList<QByteArray> ips;
+        QVERIFY(!DNSResolver::cached("localhost", false, ips));
+        DNSResolver::setCacheTTL(60, 5);
+    }
+
+    void test_mergedLookups()
+    {
+        const int Count = 20;
+        DNSResolver resolver;
+        Result res;
+        for (int i = 0 ; i < Count ; ++i) resolver.resolve("localhost", false, res.callback());
+        res.sem.acquire(Count);
+        QCOMPARE(res.calls, Count);
+        QVERIFY(!res.ips.isEmpty());
+    }
+
+};
+#include "dns_test.moc"
+ADD_TEST(DNS_Test)
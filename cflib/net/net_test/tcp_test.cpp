@@ -7,12 +7,16 @@
 
 #include <cflib/crypt/crypt_test/certs.h>
 #include <cflib/crypt/tlscredentials.h>
+#include <cflib/net/net_test/tcpfixtures.h>
 #include <cflib/net/tcpconn.h>
 #include <cflib/net/tcpmanager.h>
 #include <cflib/util/test.h>
 
+#include <unistd.h>
+
 using namespace cflib::crypt;
 using namespace cflib::net;
+using namespace tcpfixtures;
 
 namespace {
 
@@ -74,17 +78,166 @@ protected:
 class Server : public TCPManager
 {
 public:
-    Server(uint tlsThreadCount = 0) : TCPManager(tlsThreadCount) {}
+    Server(uint tlsThreadCount = 0, uint reactorCount = 1, IOBackend backend = LibEVBackend) :
+        TCPManager(tlsThreadCount, 0, reactorCount, backend) {}
 
     QList<TCPConn *> conns;
 
 protected:
     virtual void newConnection(TCPConnData * data)
     {
-        conns << new ServerConn(data);
+        // called by all reactors
+        TCPConn * conn = new ServerConn(data);
+        QMutexLocker ml(&mutex);
+        conns << conn;
+    }
+};
+
+// collects everything until the peer closes
+class SinkConn : public TCPConn
+{
+public:
+    SinkConn(TCPConnData * data) : TCPConn(data) { startReadWatcher(); }
+
+    QByteArray received;
+
+protected:
+    virtual void newBytesAvailable()
+    {
+        received += read();
+        startReadWatcher();
+    }
+
+    virtual void closed(CloseType type)
+    {
+        msg(QString("sink closed: %1, %2 bytes").arg((int)type).arg(received.size()));
+    }
+};
+
+class SinkServer : public TCPManager
+{
+public:
+    SinkServer(IOBackend backend = LibEVBackend) : TCPManager(0, 0, 1, backend) {}
+
+    SinkConn * conn = 0;
+
+protected:
+    virtual void newConnection(TCPConnData * data)
+    {
+        conn = new SinkConn(data);
+    }
+};
+
+// streaming read mode, returns the credit after reading if refill is set
+class StreamConn : public TCPConn
+{
+public:
+    StreamConn(TCPConnData * data, quint64 credit, bool refill) :
+        TCPConn(data), refill_(refill), notifications_(0)
+    {
+        startStreaming(credit);
+    }
+
+    QByteArray received() const
+    {
+        QMutexLocker ml(&mutex);
+        return received_;
+    }
+
+    int notifications() const
+    {
+        QMutexLocker ml(&mutex);
+        return notifications_;
+    }
+
+protected:
+    virtual void newBytesAvailable()
+    {
+        const QByteArray data = read();
+        {
+            QMutexLocker ml(&mutex);
+            received_ += data;
+            ++notifications_;
+        }
+        if (refill_) addReadCredit(data.size());
+    }
+
+    virtual void closed(CloseType type)
+    {
+        msg(QString("stream closed: %1, %2 bytes").arg((int)type).arg(received().size()));
+    }
+
+private:
+    const bool refill_;
+    QByteArray received_;
+    int notifications_;
+};
+
+class StreamServer : public TCPManager
+{
+public:
+    StreamServer(quint64 credit, bool refill, IOBackend backend = LibEVBackend) :
+        TCPManager(0, 0, 1, backend), credit_(credit), refill_(refill) {}
+
+    StreamConn * conn = 0;
+
+protected:
+    virtual void newConnection(TCPConnData * data)
+    {
+        conn = new StreamConn(data, credit_, refill_);
+        msg("stream new");
     }
+
+private:
+    const quint64 credit_;
+    const bool refill_;
 };
 
+// reports write backpressure
+class WatermarkConn : public TCPConn
+{
+public:
+    WatermarkConn(TCPConnData * data) : TCPConn(data) {}
+
+protected:
+    virtual void writeBufferFull()    { msg("full"); }
+    virtual void writeBufferDrained() { msg("drained"); }
+
+    virtual void closed(CloseType type)
+    {
+        msg(QString("wm closed: %1").arg((int)type));
+    }
+};
+
+void pingPong(const QString & name, TCPManager::IOBackend backend)
+{
+    const int Conns = 16;
+    const int Requests = 2000;
+
+    EchoServer serv(0, 2, backend);
+    QVERIFY(serv.start("127.0.0.1", 12302));
+    TCPManager cli(0, 0, 2, backend);
+
+    QElapsedTimer timer;
+    timer.start();
+    const quint64 syscalls = TCPManager::ioSyscalls();
+    QSemaphore done;
+    QList<PingConn *> conns;
+    for (int i = 0 ; i < Conns ; ++i) {
+        TCPConnData * data = cli.openConnection("127.0.0.1", 12302);
+        QVERIFY(data != 0);
+        conns << new PingConn(data, Requests, done);
+    }
+    done.acquire(Conns);
+    const qint64 nsecs = timer.nsecsElapsed();
+    const double perRequest = (double)(TCPManager::ioSyscalls() - syscalls) / (Conns * Requests);
+
+    QTextStream(stdout) << name << ": " << (qint64)Conns * Requests * 1000000000 / nsecs << " requests/sec, "
+        << perRequest << " syscalls/request" << Qt::endl;
+
+    qDeleteAll(conns);
+}
+
 class ClientConn : public TCPConn
 {
 public:
@@ -366,6 +519,118 @@ private slots:
         msgs.clear();
     }
 
+    void test_kernelTLS()
+    {
+        TLSCredentials serverCreds;
+        QCOMPARE((int)serverCreds.addCerts(cert1 + cert2 + cert3), 3);
+        QVERIFY(serverCreds.addPrivateKey(detach(cert1PrivateKey), "SuperSecure123"));
+
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        QCOMPARE(file.write("file over TLS"), (qint64)13);
+        QVERIFY(file.flush());
+
+        // without kernel support the TLS threads keep encrypting
+        bool kernelTLS = true;
+        foreach (TCPManager::IOBackend backend, QList<TCPManager::IOBackend>()
+            << TCPManager::LibEVBackend << TCPManager::IOUringBackend)
+        {
+            Server serv(1, 1, backend);
+            serv.setKernelTLS(true);
+            QVERIFY(serv.start("127.0.0.1", 12301, serverCreds));
+
+            TCPManager cli(1);
+            QCOMPARE((int)cli.clientCredentials().addCerts(cert3, true), 1);
+            QCOMPARE((int)cli.clientCredentials().addRevocationLists(cert2Crl), 1);
+
+            TCPConnData * data = cli.openTLSConnection("127.0.0.1", 12301);
+            QVERIFY(data != 0);
+            ClientConn * conn = new ClientConn(data);
+            msgSem.acquire(2);
+            msgs.clear();
+
+            for (int i = 1 ; i <= 3 ; ++i) {
+                conn->write("ping " + QByteArray::number(i), true);
+                msgSem.acquire(3);
+                QCOMPARE(msgs.size(), 3);
+                QVERIFY(msgs.contains("cli writeFinished"));
+                QVERIFY(msgs.contains(QString("srv read: ping %1").arg(i)));
+                QVERIFY(msgs.contains(QString("cli read: pong %1").arg(i)));
+                msgs.clear();
+            }
+
+            QCOMPARE(serv.conns.size(), 1);
+            if (serv.conns.first()->writeFile(file.handle(), 5, 8)) {
+                msgSem.acquire(1);
+                QCOMPARE(msgs, QStringList() << "cli read: over TLS");
+                msgs.clear();
+            } else {
+                kernelTLS = false;
+            }
+
+            delete conn;
+            msgSem.acquire(2);
+            QVERIFY(msgs.contains("cli deleted"));
+            QVERIFY(msgs.contains("srv closed: 1"));
+            msgs.clear();
+
+            foreach (TCPConn * sc, serv.conns) delete sc;
+            msgSem.acquire(1);
+            QVERIFY(msgs.contains("srv deleted"));
+            msgs.clear();
+        }
+
+        // only the fallback got tested
+        if (!kernelTLS) QSKIP("kernel TLS not available");
+    }
+
+    void test_tlsHandshakePool()
+    {
+        TLSCredentials serverCreds;
+        QCOMPARE((int)serverCreds.addCerts(cert1 + cert2 + cert3), 3);
+        QVERIFY(serverCreds.addPrivateKey(detach(cert1PrivateKey), "SuperSecure123"));
+
+        Server serv(2);
+        serv.setTLSHandshakeThreads(2, 100);
+        QVERIFY(serv.start("127.0.0.1", 12301, serverCreds));
+
+        TCPManager cli(1);
+        QCOMPARE((int)cli.clientCredentials().addCerts(cert3, true), 1);
+        QCOMPARE((int)cli.clientCredentials().addRevocationLists(cert2Crl), 1);
+
+        const int Conns = 4;
+        QList<ClientConn *> conns;
+        for (int i = 0 ; i < Conns ; ++i) {
+            TCPConnData * data = cli.openTLSConnection("127.0.0.1", 12301);
+            QVERIFY(data != 0);
+            conns << new ClientConn(data);
+        }
+        msgSem.acquire(2 * Conns);
+        QCOMPARE(msgs.count("srv new: 127.0.0.1"), Conns);
+        msgs.clear();
+
+        // written before the handshake has finished
+        for (int i = 0 ; i < Conns ; ++i) conns[i]->write("ping " + QByteArray::number(i));
+        msgSem.acquire(2 * Conns);
+        for (int i = 0 ; i < Conns ; ++i) {
+            QVERIFY(msgs.contains(QString("srv read: ping %1").arg(i)));
+            QVERIFY(msgs.contains(QString("cli read: pong %1").arg(i)));
+        }
+        msgs.clear();
+        QCOMPARE(serv.rejectedTLSHandshakes(), (quint64)0);
+
+        qDeleteAll(conns);
+        msgSem.acquire(2 * Conns);
+        QCOMPARE(msgs.count("cli deleted"), Conns);
+        QCOMPARE(msgs.count("srv closed: 1"), Conns);
+        msgs.clear();
+
+        foreach (TCPConn * sc, serv.conns) delete sc;
+        msgSem.acquire(Conns);
+        QCOMPARE(msgs.count("srv deleted"), Conns);
+        msgs.clear();
+    }
+
     void test_IPv6()
     {
         // Do we have an IPv6 loopback device?
@@ -414,6 +679,517 @@ private slots:
         msgs.clear();
     }
 
+    void test_multipleReactors()
+    {
+        const int Count = 16;
+        Server serv(0, 4);
+        QVERIFY(serv.start("127.0.0.1", 12301));
+        TCPManager cli(0, 0, 2);
+
+        QList<ClientConn *> conns;
+        for (int i = 0 ; i < Count ; ++i) {
+            TCPConnData * data = cli.openConnection("127.0.0.1", 12301);
+            QVERIFY(data != 0);
+            conns << new ClientConn(data);
+        }
+        msgSem.acquire(2 * Count);
+        QCOMPARE(msgs.size(), 2 * Count);
+        QCOMPARE(msgs.count("cli new: 127.0.0.1:12301"), Count);
+        QCOMPARE(msgs.count("srv new: 127.0.0.1"), Count);
+        msgs.clear();
+
+        for (int i = 0 ; i < Count ; ++i) conns[i]->write("ping " + QByteArray::number(i));
+        msgSem.acquire(2 * Count);
+        QCOMPARE(msgs.size(), 2 * Count);
+        for (int i = 0 ; i < Count ; ++i) {
+            QVERIFY(msgs.contains(QString("srv read: ping %1").arg(i)));
+            QVERIFY(msgs.contains(QString("cli read: pong %1").arg(i)));
+        }
+        msgs.clear();
+
+        foreach (ClientConn * conn, conns) delete conn;
+        msgSem.acquire(2 * Count);
+        QCOMPARE(msgs.count("cli deleted"), Count);
+        QCOMPARE(msgs.count("srv closed: 1"), Count);
+        msgs.clear();
+
+        foreach (TCPConn * sc, serv.conns) delete sc;
+        msgSem.acquire(Count);
+        QCOMPARE(msgs.count("srv deleted"), Count);
+        msgs.clear();
+    }
+
+    void test_manySegments()
+    {
+        SinkServer serv;
+        QVERIFY(serv.start("127.0.0.1", 12301));
+        TCPManager cli;
+        TCPConnData * data = cli.openConnection("127.0.0.1", 12301);
+        QVERIFY(data != 0);
+        ClientConn * conn = new ClientConn(data);
+        msgSem.acquire(1);
+        QVERIFY(msgs.contains("cli new: 127.0.0.1:12301"));
+        msgs.clear();
+
+        // more segments than fit into one sendmsg and one big segment in between
+        QByteArray expected;
+        for (int i = 0 ; i < 3000 ; ++i) {
+            const QByteArray seg(i == 1500 ? 0x1000000 : i % 1000 + 1, 'a' + i % 26);
+            expected += seg;
+            conn->write(seg, i == 2999);
+        }
+        conn->close(TCPConn::WriteClosed);
+        msgSem.acquire(2);
+        QCOMPARE(msgs.size(), 2);
+        QVERIFY(msgs.contains("cli writeFinished"));
+        QVERIFY(msgs.contains(QString("sink closed: 1, %1 bytes").arg(expected.size())));
+        msgs.clear();
+        QVERIFY(serv.conn->received == expected);
+
+        delete conn;
+        delete serv.conn;
+        msgSem.acquire(1);
+        QVERIFY(msgs.contains("cli deleted"));
+        msgs.clear();
+    }
+
+    void test_idleReadBuffers()
+    {
+        const int Count = 50;
+        const qint64 before = TCPManager::readBufferBytes();
+        Server serv;
+        QVERIFY(serv.start("127.0.0.1", 12301));
+        TCPManager cli;
+
+        QList<ClientConn *> conns;
+        for (int i = 0 ; i < Count ; ++i) {
+            TCPConnData * data = cli.openConnection("127.0.0.1", 12301);
+            QVERIFY(data != 0);
+            conns << new ClientConn(data);
+        }
+        msgSem.acquire(2 * Count);
+        msgs.clear();
+
+        foreach (ClientConn * conn, conns) conn->write("ping");
+        msgSem.acquire(2 * Count);
+        QCOMPARE(msgs.count("cli read: pong"), Count);
+        msgs.clear();
+
+        // all connections are idle: only the recv buffers of both reactors remain
+        QCOMPARE(TCPManager::readBufferBytes() - before, (qint64)2 * 0x10000);
+
+        foreach (ClientConn * conn, conns) delete conn;
+        msgSem.acquire(2 * Count);
+        msgs.clear();
+        foreach (TCPConn * sc, serv.conns) delete sc;
+        msgSem.acquire(Count);
+        msgs.clear();
+    }
+
+    void test_ioUring()
+    {
+        Server serv(0, 2, TCPManager::IOUringBackend);
+        QVERIFY(serv.start("127.0.0.1", 12301));
+        TCPManager cli(0, 0, 1, TCPManager::IOUringBackend);
+
+        TCPConnData * data = cli.openConnection("127.0.0.1", 12301);
+        QVERIFY(data != 0);
+        ClientConn * conn = new ClientConn(data);
+        msgSem.acquire(2);
+        QCOMPARE(msgs.size(), 2);
+        QVERIFY(msgs.contains("cli new: 127.0.0.1:12301"));
+        QVERIFY(msgs.contains("srv new: 127.0.0.1"));
+        msgs.clear();
+
+        conn->write("ping", true);
+        msgSem.acquire(3);
+        QCOMPARE(msgs.size(), 3);
+        QVERIFY(msgs.contains("cli writeFinished"));
+        QVERIFY(msgs.contains("srv read: ping"));
+        QVERIFY(msgs.contains("cli read: pong"));
+        msgs.clear();
+
+        conn->write("close");
+        msgSem.acquire(3);
+        QCOMPARE(msgs.size(), 3);
+        QVERIFY(msgs.contains("srv read: close"));
+        QVERIFY(msgs.contains("srv closed: 3"));
+        QVERIFY(msgs.contains("cli closed: 1"));
+        msgs.clear();
+
+        delete conn;
+        foreach (TCPConn * sc, serv.conns) delete sc;
+        msgSem.acquire(2);
+        QCOMPARE(msgs.size(), 2);
+        QVERIFY(msgs.contains("cli deleted"));
+        QVERIFY(msgs.contains("srv deleted"));
+        msgs.clear();
+    }
+
+    void test_ioUringManySegments()
+    {
+        SinkServer serv(TCPManager::IOUringBackend);
+        QVERIFY(serv.start("127.0.0.1", 12301));
+        TCPManager cli(0, 0, 1, TCPManager::IOUringBackend);
+        TCPConnData * data = cli.openConnection("127.0.0.1", 12301);
+        QVERIFY(data != 0);
+        ClientConn * conn = new ClientConn(data);
+        msgSem.acquire(1);
+        msgs.clear();
+
+        QByteArray expected;
+        for (int i = 0 ; i < 3000 ; ++i) {
+            const QByteArray seg(i == 1500 ? 0x1000000 : i % 1000 + 1, 'a' + i % 26);
+            expected += seg;
+            conn->write(seg, i == 2999);
+        }
+        conn->close(TCPConn::WriteClosed);
+        msgSem.acquire(2);
+        QCOMPARE(msgs.size(), 2);
+        QVERIFY(msgs.contains("cli writeFinished"));
+        QVERIFY(msgs.contains(QString("sink closed: 1, %1 bytes").arg(expected.size())));
+        msgs.clear();
+        QVERIFY(serv.conn->received == expected);
+
+        delete conn;
+        delete serv.conn;
+        msgSem.acquire(1);
+        msgs.clear();
+    }
+
+    void test_openConnectionAsync()
+    {
+        Server serv;
+        QVERIFY(serv.start("127.0.0.1", 12301));
+        TCPManager cli;
+
+        QSemaphore sem;
+        TCPConnData * data = 0;
+        cli.openConnectionAsync("localhost", 12301, [&](TCPConnData * d) { data = d; sem.release(); });
+        sem.acquire();
+        QVERIFY(data != 0);
+        ClientConn * conn = new ClientConn(data);
+        msgSem.acquire(2);
+        QCOMPARE(msgs.size(), 2);
+        QVERIFY(msgs.contains("srv new: 127.0.0.1") || msgs.contains("srv new: ::1"));
+        msgs.clear();
+
+        cli.openConnectionAsync("does.not.exist.invalid", 12301, [&](TCPConnData * d) { data = d; sem.release(); });
+        sem.acquire();
+        QVERIFY(data == 0);
+
+        delete conn;
+        msgSem.acquire(2);
+        QVERIFY(msgs.contains("cli deleted"));
+        msgs.clear();
+        foreach (TCPConn * sc, serv.conns) delete sc;
+        msgSem.acquire(1);
+        QVERIFY(msgs.contains("srv deleted"));
+        msgs.clear();
+    }
+
+    void test_connectionPool()
+    {
+        EchoServer serv(0, 1, TCPManager::LibEVBackend);
+        QVERIFY(serv.start("127.0.0.1", 12302));
+        TCPManager cli;
+
+        bool reused = true;
+        TCPConnData * data = cli.openPooledConnection("127.0.0.1", 12302, false, false, &reused);
+        QVERIFY(data != 0);
+        QVERIFY(!reused);
+        ClientConn * conn = new ClientConn(data);
+        conn->write("ping");
+        msgSem.acquire(2);
+        QVERIFY(msgs.contains("cli read: ping"));
+        msgs.clear();
+
+        // idle connection gets reused
+        cli.releaseConnection(conn->detach());
+        delete conn;
+        msgSem.acquire(1);
+        msgs.clear();
+        QVERIFY(cli.openPooledConnection("127.0.0.1", 12302, false, false, &reused) == data);
+        QVERIFY(reused);
+        conn = new ClientConn(data);
+        conn->write("pong");
+        msgSem.acquire(2);
+        QVERIFY(msgs.contains("cli read: pong"));
+        msgs.clear();
+        QCOMPARE(serv.conns.size(), 1);
+
+        // not after the peer has closed it
+        cli.releaseConnection(conn->detach());
+        delete conn;
+        msgSem.acquire(1);
+        msgs.clear();
+        qDeleteAll(serv.conns);
+        serv.conns.clear();
+        QThread::msleep(100);
+        data = cli.openPooledConnection("127.0.0.1", 12302, false, false, &reused);
+        QVERIFY(data != 0);
+        QVERIFY(!reused);
+        conn = new ClientConn(data);
+        conn->write("ping");
+        msgSem.acquire(2);
+        QVERIFY(msgs.contains("cli read: ping"));
+        msgs.clear();
+        QCOMPARE(serv.conns.size(), 1);
+
+        delete conn;
+        msgSem.acquire(1);
+        msgs.clear();
+    }
+
+    void test_writeFile()
+    {
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        QByteArray content;
+        for (int i = 0 ; i < 100000 ; ++i) content += QByteArray::number(i) + ' ';
+        QCOMPARE(file.write(content), (qint64)content.size());
+        QVERIFY(file.flush());
+
+        foreach (TCPManager::IOBackend backend, QList<TCPManager::IOBackend>()
+            << TCPManager::LibEVBackend << TCPManager::IOUringBackend)
+        {
+            SinkServer serv(backend);
+            QVERIFY(serv.start("127.0.0.1", 12301));
+            TCPManager cli;
+            TCPConnData * data = cli.openConnection("127.0.0.1", 12301);
+            QVERIFY(data != 0);
+            ClientConn * conn = new ClientConn(data);
+            msgSem.acquire(1);
+            msgs.clear();
+
+            int pipeFds[2];
+            QVERIFY(::pipe(pipeFds) == 0);
+            const QByteArray piped(1000, 'p');
+            QCOMPARE(::write(pipeFds[1], piped.constData(), piped.size()), (ssize_t)piped.size());
+            ::close(pipeFds[1]);
+
+            // order of buffers and files is kept
+            conn->write("head");
+            QVERIFY(conn->writeFile(file.handle(), 10, content.size() - 10));
+            conn->write("middle");
+            QVERIFY(conn->writeFile(pipeFds[0], 0, piped.size()));
+            ::close(pipeFds[0]);
+            conn->write("tail", true);
+            msgSem.acquire(1);
+            QCOMPARE(msgs, QStringList() << "cli writeFinished");
+            msgs.clear();
+
+            conn->close(TCPConn::WriteClosed);
+            msgSem.acquire(1);
+            const QByteArray expected = "head" + content.mid(10) + "middle" + piped + "tail";
+            QCOMPARE(msgs, QStringList() << QString("sink closed: 1, %1 bytes").arg(expected.size()));
+            msgs.clear();
+            QVERIFY(serv.conn->received == expected);
+
+            delete conn;
+            delete serv.conn;
+            msgSem.acquire(1);
+            QVERIFY(msgs.contains("cli deleted"));
+            msgs.clear();
+        }
+    }
+
+    void test_socketOptions()
+    {
+        Server serv;
+        TCPManager::SocketOptions opts;
+        opts.backlog           = 16;
+        opts.sendBufferSize    = 0x20000;
+        opts.receiveBufferSize = 0x20000;
+        opts.deferAcceptSecs   = 1;
+        opts.fastOpenQueue     = 16;
+        opts.noDelay           = true;
+        opts.keepAliveIdleSecs = 60;
+        opts.notSentLowat      = 0x4000;
+        serv.setSocketOptions(opts);
+        QVERIFY(serv.start("127.0.0.1", 12301));
+
+        TCPManager cli;
+        TCPManager::SocketOptions cliOpts;
+        cliOpts.fastOpenConnect       = true;
+        cliOpts.quickAck              = true;
+        cliOpts.keepAliveIdleSecs     = 60;
+        cliOpts.keepAliveIntervalSecs = 10;
+        cliOpts.keepAliveCount        = 3;
+        cli.setSocketOptions(cliOpts);
+        QCOMPARE(cli.socketOptions().keepAliveCount, 3);
+
+        TCPConnData * data = cli.openConnection("127.0.0.1", 12301);
+        QVERIFY(data != 0);
+        ClientConn * conn = new ClientConn(data);
+        // deferred accept: server gets the connection with the first bytes
+        conn->write("ping");
+        msgSem.acquire(4);
+        QVERIFY(msgs.contains("srv new: 127.0.0.1"));
+        QVERIFY(msgs.contains("srv read: ping"));
+        QVERIFY(msgs.contains("cli read: pong"));
+        msgs.clear();
+
+        // corked parts
+        conn->setCork(true);
+        conn->write("pi");
+        conn->write("ng2");
+        conn->setCork(false);
+        msgSem.acquire(2);
+        QVERIFY(msgs.contains("srv read: ping2"));
+        QVERIFY(msgs.contains("cli read: pong2"));
+        msgs.clear();
+
+        delete conn;
+        msgSem.acquire(2);
+        QVERIFY(msgs.contains("cli deleted"));
+        QVERIFY(msgs.contains("srv closed: 1"));
+        msgs.clear();
+        foreach (TCPConn * sc, serv.conns) delete sc;
+        msgSem.acquire(1);
+        QVERIFY(msgs.contains("srv deleted"));
+        msgs.clear();
+    }
+
+    void test_writeWatermarks()
+    {
+        const QByteArray chunk(0x10000, 'w');
+        const int Chunks = 1024;
+
+        StreamServer serv(0, true);
+        QVERIFY(serv.start("127.0.0.1", 12301));
+        TCPManager cli;
+        TCPConnData * data = cli.openConnection("127.0.0.1", 12301);
+        QVERIFY(data != 0);
+        WatermarkConn * conn = new WatermarkConn(data);
+        msgSem.acquire(1);
+        msgs.clear();
+
+        // peer does not read
+        conn->setWriteWatermarks(0x100000, 0x10000);
+        for (int i = 0 ; i < Chunks ; ++i) conn->write(chunk);
+        msgSem.acquire(1);
+        QCOMPARE(msgs, QStringList() << "full");
+        msgs.clear();
+        QVERIFY(conn->pendingWriteBytes() >= 0x100000);
+
+        serv.conn->addReadCredit(0x10000);
+        msgSem.acquire(1);
+        QCOMPARE(msgs, QStringList() << "drained");
+        msgs.clear();
+        QVERIFY(conn->pendingWriteBytes() <= 0x10000);
+        while (serv.conn->received().size() < Chunks * chunk.size()) QThread::msleep(10);
+        QCOMPARE(conn->pendingWriteBytes(), (quint64)0);
+
+        delete conn;
+        msgSem.acquire(1);
+        QCOMPARE(msgs, QStringList() << QString("stream closed: 1, %1 bytes").arg(Chunks * chunk.size()));
+        msgs.clear();
+        delete serv.conn;
+
+        // hard limit
+        StreamServer serv2(0, false);
+        QVERIFY(serv2.start("127.0.0.1", 12302));
+        data = cli.openConnection("127.0.0.1", 12302);
+        QVERIFY(data != 0);
+        conn = new WatermarkConn(data);
+        msgSem.acquire(1);
+        msgs.clear();
+
+        conn->setWriteWatermarks(0, 0, 0x100000);
+        for (int i = 0 ; i < Chunks ; ++i) conn->write(chunk);
+        msgSem.acquire(1);
+        QCOMPARE(msgs, QStringList() << "wm closed: 7");
+        msgs.clear();
+
+        delete conn;
+        delete serv2.conn;
+    }
+
+    void test_streaming()
+    {
+        foreach (TCPManager::IOBackend backend, QList<TCPManager::IOBackend>()
+            << TCPManager::LibEVBackend << TCPManager::IOUringBackend)
+        {
+            StreamServer serv(0x40000, true, backend);
+            QVERIFY(serv.start("127.0.0.1", 12301));
+            TCPManager cli;
+            TCPConnData * data = cli.openConnection("127.0.0.1", 12301);
+            QVERIFY(data != 0);
+            ClientConn * conn = new ClientConn(data);
+            msgSem.acquire(2);
+            msgs.clear();
+
+            const int Chunks = 256;
+            QByteArray expected;
+            for (int i = 0 ; i < Chunks ; ++i) {
+                const QByteArray chunk(0x4000, 'a' + i % 26);
+                expected += chunk;
+                conn->write(chunk);
+            }
+            conn->close(TCPConn::WriteClosed);
+            msgSem.acquire(1);
+            QCOMPARE(msgs.size(), 1);
+            QCOMPARE(msgs[0], QString("stream closed: 1, %1 bytes").arg(expected.size()));
+            msgs.clear();
+            QVERIFY(serv.conn->received() == expected);
+            // batched delivery
+            QVERIFY(serv.conn->notifications() <= Chunks);
+
+            delete conn;
+            delete serv.conn;
+            msgSem.acquire(1);
+            QVERIFY(msgs.contains("cli deleted"));
+            msgs.clear();
+        }
+    }
+
+    void test_streamingCredit()
+    {
+        StreamServer serv(1000, false);
+        QVERIFY(serv.start("127.0.0.1", 12301));
+        TCPManager cli;
+        TCPConnData * data = cli.openConnection("127.0.0.1", 12301);
+        QVERIFY(data != 0);
+        ClientConn * conn = new ClientConn(data);
+        msgSem.acquire(2);
+        msgs.clear();
+
+        const QByteArray sent(10000, 'x');
+        conn->write(sent, true);
+        conn->close(TCPConn::WriteClosed);
+        msgSem.acquire(1);
+        QVERIFY(msgs.contains("cli writeFinished"));
+        msgs.clear();
+
+        // no more bytes than credit and no close without credit
+        QThread::msleep(100);
+        QCOMPARE(serv.conn->received().size(), 1000);
+        QVERIFY(msgs.isEmpty());
+
+        // EOF needs credit, too
+        serv.conn->addReadCredit(10000);
+        msgSem.acquire(1);
+        QCOMPARE(msgs.size(), 1);
+        QCOMPARE(msgs[0], QString("stream closed: 1, 10000 bytes"));
+        msgs.clear();
+        QVERIFY(serv.conn->received() == sent);
+
+        delete conn;
+        delete serv.conn;
+        msgSem.acquire(1);
+        QVERIFY(msgs.contains("cli deleted"));
+        msgs.clear();
+    }
+
+    void test_pingPongBenchmark()
+    {
+        BENCHMARK_ONLY();
+
+        pingPong("libev   ", TCPManager::LibEVBackend);
+        pingPong("io_uring", TCPManager::IOUringBackend);
+    }
+
 //    forever { msgSem.acquire(); QTextStream(stdout) << msgs.join("|") << Qt::endl; }
 
 };
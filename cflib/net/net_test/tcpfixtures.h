@@ -0,0 +1,88 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include <cflib/net/tcpconn.h>
+#include <cflib/net/tcpmanager.h>
+
+// connections and servers shared by the TCP tests and benchmarks
+namespace tcpfixtures {
+
+// answers everything with the same bytes
+class EchoConn : public cflib::net::TCPConn
+{
+public:
+    EchoConn(cflib::net::TCPConnData * data) : TCPConn(data) { startReadWatcher(); }
+
+protected:
+    virtual void newBytesAvailable()
+    {
+        write(read());
+        startReadWatcher();
+    }
+};
+
+class EchoServer : public cflib::net::TCPManager
+{
+public:
+    EchoServer(uint tlsThreadCount = 0, uint reactorCount = 1, IOBackend backend = LibEVBackend) :
+        TCPManager(tlsThreadCount, 0, reactorCount, backend) {}
+    ~EchoServer() { qDeleteAll(conns); }
+
+    QList<cflib::net::TCPConn *> conns;
+
+protected:
+    virtual void newConnection(cflib::net::TCPConnData * data)
+    {
+        cflib::net::TCPConn * conn = new EchoConn(data);
+        QMutexLocker ml(&mutex_);
+        conns << conn;
+    }
+
+private:
+    QMutex mutex_;
+};
+
+// one request at a time, releases done after count answers
+// (the first request includes the handshake and is not measured)
+class PingConn : public cflib::net::TCPConn
+{
+public:
+    PingConn(cflib::net::TCPConnData * data, int count, QSemaphore & done) :
+        TCPConn(data), remaining_(count), first_(true), done_(done)
+    {
+        startReadWatcher();
+        timer_.start();
+        write("ping");
+    }
+
+    QVector<qint64> nsecs;
+
+protected:
+    virtual void newBytesAvailable()
+    {
+        read();
+        if (first_) first_ = false;
+        else        nsecs << timer_.nsecsElapsed();
+        if (--remaining_ > 0) {
+            timer_.start();
+            write("ping");
+        } else {
+            done_.release();
+        }
+        startReadWatcher();
+    }
+
+private:
+    int remaining_;
+    bool first_;
+    QSemaphore & done_;
+    QElapsedTimer timer_;
+};
+
+}    // namespace
@@ -0,0 +1,86 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include <cflib/net/httpclient.h>
+#include <cflib/net/httpserver.h>
+#include <cflib/net/tcpmanager.h>
+#include <cflib/net/threadstatshandler.h>
+#include <cflib/util/test.h>
+#include <cflib/util/threadstats.h>
+
+using namespace cflib::net;
+using namespace cflib::util;
+
+namespace {
+
+QSemaphore replySem;
+QByteArray lastReply;
+
+class StatsClient : public HttpClient
+{
+public:
+    StatsClient(TCPManager & mgr) : HttpClient(mgr, false) {}
+
+protected:
+    virtual void reply(const QByteArray & raw)
+    {
+        lastReply = raw;
+        replySem.release();
+    }
+};
+
+QByteArray body(const QByteArray & raw)
+{
+    const int pos = raw.indexOf("\r\n\r\n");
+    return pos == -1 ? QByteArray() : raw.mid(pos + 4);
+}
+
+}
+
+class ThreadStatsHandler_Test: public QObject
+{
+    Q_OBJECT
+private slots:
+
+    void test_endpoints()
+    {
+        // threads started after ThreadStats are counted
+        ThreadStats stats;
+        ThreadStatsHandler hdl(stats);
+        HttpServer server;
+        server.registerHandler(hdl);
+        QVERIFY(server.start("127.0.0.1", 12301));
+
+        TCPManager mgr;
+        StatsClient cli(mgr);
+
+        cli.get("127.0.0.1", 12301, "/threadstats");
+        QVERIFY(replySem.tryAcquire(1, 5000));
+        QVERIFY(lastReply.startsWith("HTTP/1.1 200 OK\r\n"));
+        QVERIFY(lastReply.contains("Content-Type: application/json"));
+        const QJsonDocument doc = QJsonDocument::fromJson(body(lastReply));
+        QVERIFY(doc.isArray());
+        QVERIFY(!doc.array().isEmpty());
+        foreach (const QJsonValue & thread, doc.array()) {
+            QVERIFY(thread.toObject().contains("name"));
+            QVERIFY(thread.toObject().contains("calls"));
+            QVERIFY(thread.toObject().contains("lanes"));
+        }
+
+        cli.get("127.0.0.1", 12301, "/threadstats/prometheus");
+        QVERIFY(replySem.tryAcquire(1, 5000));
+        QVERIFY(lastReply.startsWith("HTTP/1.1 200 OK\r\n"));
+        QVERIFY(lastReply.contains("Content-Type: text/plain; version=0.0.4"));
+        const QByteArray text = body(lastReply);
+        QVERIFY(text.contains("# TYPE cflib_thread_calls_total counter\n"));
+        QVERIFY(text.contains("# TYPE cflib_thread_wait_seconds summary\n"));
+        QVERIFY(text.contains("cflib_thread_calls_total{thread=\""));
+    }
+
+};
+#include "threadstatshandler_test.moc"
+ADD_TEST(ThreadStatsHandler_Test)
@@ -0,0 +1,182 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include <cflib/crypt/crypt_test/certs.h>
+#include <cflib/crypt/tlscredentials.h>
+#include <cflib/crypt/tlssessions.h>
+#include <cflib/net/net_test/tcpfixtures.h>
+#include <cflib/net/tcpconn.h>
+#include <cflib/net/tcpmanager.h>
+#include <cflib/util/test.h>
+
+#include <algorithm>
+
+using namespace cflib::crypt;
+using namespace cflib::net;
+using namespace tcpfixtures;
+
+namespace {
+
+QSemaphore doneSem;
+
+// writes everything at once and waits for the echo
+class BulkConn : public TCPConn
+{
+public:
+    BulkConn(TCPConnData * data, int chunkSize, int chunks) :
+        TCPConn(data), remaining_((qint64)chunkSize * chunks)
+    {
+        startReadWatcher();
+        const QByteArray chunk(chunkSize, 'x');
+        for (int i = 0 ; i < chunks ; ++i) write(chunk);
+    }
+
+protected:
+    virtual void newBytesAvailable()
+    {
+        remaining_ -= read().size();
+        if (remaining_ > 0) startReadWatcher();
+        else                doneSem.release();
+    }
+
+private:
+    qint64 remaining_;
+};
+
+const quint16 Port = 12311;
+
+void prepareClient(TCPManager & cli)
+{
+    QCOMPARE((int)cli.clientCredentials().addCerts(cert3, true), 1);
+    QCOMPARE((int)cli.clientCredentials().addRevocationLists(cert2Crl), 1);
+}
+
+void handshakes(const QString & name, uint tlsThreadCount, TLSCredentials & serverCreds, bool resume)
+{
+    const int Conns = 16;
+    const int Rounds = 10;
+
+    EchoServer serv(tlsThreadCount);
+    serv.setTLSSessionResumption(resume ? 3600 : 0);
+    QVERIFY(serv.start("127.0.0.1", Port, serverCreds));
+    TCPManager cli(tlsThreadCount);
+    prepareClient(cli);
+
+    // stores a session ticket in the client
+    if (resume) {
+        PingConn * conn = new PingConn(cli.openTLSConnection("127.0.0.1", Port), 1, doneSem);
+        doneSem.acquire();
+        delete conn;
+    }
+
+    const quint64 resumed = serv.tlsServerSessions().resumedHandshakes();
+    QElapsedTimer timer;
+    timer.start();
+    for (int r = 0 ; r < Rounds ; ++r) {
+        QList<PingConn *> conns;
+        for (int i = 0 ; i < Conns ; ++i) {
+            TCPConnData * data = cli.openTLSConnection("127.0.0.1", Port);
+            QVERIFY(data != 0);
+            conns << new PingConn(data, 1, doneSem);
+        }
+        doneSem.acquire(Conns);
+        qDeleteAll(conns);
+    }
+    const qint64 nsecs = timer.nsecsElapsed();
+
+    QTextStream(stdout) << name << ": " << (qint64)Conns * Rounds * 1000000000 / nsecs << " handshakes/sec, "
+        << serv.tlsServerSessions().resumedHandshakes() - resumed << " resumed" << Qt::endl;
+}
+
+void bulk(const QString & name, uint tlsThreadCount, TLSCredentials & serverCreds, int chunkSize, int chunks)
+{
+    const int Conns = 4;
+
+    EchoServer serv(tlsThreadCount);
+    QVERIFY(serv.start("127.0.0.1", Port, serverCreds));
+    TCPManager cli(tlsThreadCount);
+    prepareClient(cli);
+
+    QElapsedTimer timer;
+    timer.start();
+    QList<BulkConn *> conns;
+    for (int i = 0 ; i < Conns ; ++i) {
+        TCPConnData * data = cli.openTLSConnection("127.0.0.1", Port);
+        QVERIFY(data != 0);
+        conns << new BulkConn(data, chunkSize, chunks);
+    }
+    doneSem.acquire(Conns);
+    const qint64 nsecs = timer.nsecsElapsed();
+    qDeleteAll(conns);
+
+    // both directions
+    const double mb = 2.0 * Conns * chunkSize * chunks / (1024 * 1024);
+    QTextStream out(stdout);
+    out << name << ": " << mb * 1000000000 / nsecs << " MB/s";
+    foreach (const TCPManager::TLSThreadStats & stats, serv.tlsThreadStats()) {
+        out << ", " << stats.botanNsecs * 100 / nsecs << "%";
+    }
+    out << " in Botan" << Qt::endl;
+}
+
+void latency(const QString & name, uint tlsThreadCount, TLSCredentials & serverCreds)
+{
+    const int Conns = 16;
+    const int Requests = 1000;
+
+    EchoServer serv(tlsThreadCount);
+    QVERIFY(serv.start("127.0.0.1", Port, serverCreds));
+    TCPManager cli(tlsThreadCount);
+    prepareClient(cli);
+
+    QList<PingConn *> conns;
+    for (int i = 0 ; i < Conns ; ++i) {
+        TCPConnData * data = cli.openTLSConnection("127.0.0.1", Port);
+        QVERIFY(data != 0);
+        conns << new PingConn(data, Requests + 1, doneSem);
+    }
+    doneSem.acquire(Conns);
+
+    QVector<qint64> all;
+    foreach (PingConn * conn, conns) all << conn->nsecs;
+    qDeleteAll(conns);
+    std::sort(all.begin(), all.end());
+    QCOMPARE(all.size(), Conns * Requests);
+
+    QTextStream(stdout) << name << ": p50 " << all[all.size() / 2] / 1000 << " usec, p99 "
+        << all[all.size() * 99 / 100] / 1000 << " usec" << Qt::endl;
+}
+
+}
+
+class TLSBenchmark_Test: public QObject
+{
+    Q_OBJECT
+private slots:
+
+    void test_benchmark()
+    {
+        BENCHMARK_ONLY();
+
+        TLSCredentials serverCreds;
+        QCOMPARE((int)serverCreds.addCerts(cert1 + cert2 + cert3), 3);
+        QVERIFY(serverCreds.addPrivateKey(detach(cert1PrivateKey), "SuperSecure123"));
+
+        const uint maxThreads = qBound(1, QThread::idealThreadCount() / 2, 4);
+        for (uint threads = 1 ; threads <= maxThreads ; ++threads) {
+            const QString prefix = QString("%1 TLS thread(s), ").arg(threads);
+            handshakes(prefix + "full   ", threads, serverCreds, false);
+            handshakes(prefix + "resumed", threads, serverCreds, true);
+            bulk(prefix + "256 byte records ", threads, serverCreds, 256, 4096);
+            bulk(prefix + "16 KiB records   ", threads, serverCreds, 16 * 1024, 1024);
+            latency(prefix + "latency", threads, serverCreds);
+        }
+    }
+
+};
+#include "tlsbenchmark_test.moc"
+ADD_TEST(TLSBenchmark_Test)
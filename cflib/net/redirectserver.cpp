@@ -27,13 +27,7 @@ class TCPForwarder;
 class TCPReader : public TCPConn, public ThreadVerify
 {
 public:
-    TCPReader(TCPConnData * data, TCPForwarder * forwarder) :
-        TCPConn(data),
-        ThreadVerify(manager().networkThread()),
-        forwarder_(forwarder)
-    {
-        startReadWatcher();
-    }
+    TCPReader(TCPConnData * data, TCPForwarder * forwarder);
 
     ~TCPReader()
     {
@@ -59,7 +53,7 @@ class TCPForwarder : public TCPConn, public ThreadVerify
 public:
     TCPForwarder(TCPConnData * data, const Request & request) :
         TCPConn(data),
-        ThreadVerify(manager().networkThread()),
+        ThreadVerify(networkThread()),
         reader_(0)
     {
         logFunctionTrace
@@ -126,6 +120,16 @@ private:
     TCPReader * reader_;
 };
 
+// both connections might be handled by different reactors,
+// but reader and forwarder must share one thread
+TCPReader::TCPReader(TCPConnData * data, TCPForwarder * forwarder) :
+    TCPConn(data),
+    ThreadVerify(forwarder),
+    forwarder_(forwarder)
+{
+    startReadWatcher();
+}
+
 void TCPReader::newBytesAvailable()
 {
     // we might get called by TLS-Thread here
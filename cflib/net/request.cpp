@@ -12,6 +12,12 @@
 #include <cflib/util/log.h>
 #include <cflib/util/util.h>
 
+#ifdef Q_OS_WIN
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
 USE_LOG(LogCat::Http)
 
 namespace cflib { namespace net {
@@ -121,6 +127,30 @@ public:
         parser->sendReply(requestId, header);
     }
 
+    // takes ownership of fd
+    void sendFile(QByteArray header, int fd, qint64 size)
+    {
+        if (replySent) {
+            logWarn("tried to send two replies for request %1", id);
+            ::close(fd);
+            return;
+        }
+        replySent = true;
+
+        QListIterator<QByteArray> it(sendHeaderLines);
+        while (it.hasNext()) header << it.next() << "\r\n";
+        header
+            << "Content-Length: " << QByteArray::number(size) << "\r\n"
+            << "\r\n";
+
+        if (method != Request::HEAD) {
+            parser->sendReply(requestId, header, fd, size);
+        } else {
+            ::close(fd);
+            parser->sendReply(requestId, header);
+        }
+    }
+
     void sendNotFound()
     {
         sendReply(
@@ -284,6 +314,20 @@ void Request::sendReply(const QByteArray & reply, const QByteArray & contentType
         reply, compression);
 }
 
+bool Request::sendFile(const QString & path, const QByteArray & contentType) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const int fd = ::dup(file.handle());
+    if (fd < 0) return false;
+    d->sendFile(
+        "HTTP/1.1 200 OK\r\n"
+        << d->defaultHeaders() <<
+        "Content-Type: " << contentType << "\r\n",
+        fd, file.size());
+    return true;
+}
+
 void Request::sendText(const QString & reply, const QByteArray & contentType, bool compression) const
 {
     sendReply(reply.toUtf8(), contentType + "; charset=utf-8", compression);
@@ -63,6 +63,8 @@ public:
     void sendNotFound() const;
     void sendRedirect(const QByteArray & url) const;
     void sendReply(const QByteArray & reply, const QByteArray & contentType, bool compression = true) const;
+    // sends the file without reading it into memory (no compression), returns false if it cannot be opened
+    bool sendFile(const QString & path, const QByteArray & contentType) const;
     void sendText(const QString & reply, const QByteArray & contentType = "text/html", bool compression = true) const;
     void sendRaw(const QByteArray & header, const QByteArray & body, bool compression) const;
     void addHeaderLine(const QByteArray & line) const;
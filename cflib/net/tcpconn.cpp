@@ -11,6 +11,10 @@
 #include <cflib/net/impl/tcpmanagerimpl.h>
 #include <cflib/util/log.h>
 
+#ifdef Q_OS_LINUX
+    #include <fcntl.h>
+#endif
+
 USE_LOG(LogCat::Network)
 
 namespace cflib { namespace net {
@@ -19,7 +23,7 @@ TCPConn::TCPConn(TCPConnData * data, uint readBufferSize, bool notifySomeBytesWr
     data_(data)
 {
     data_->conn = this;
-    data_->readBuf = QByteArray(readBufferSize, '\0');
+    data_->readBufferSize = readBufferSize;
     data_->notifySomeBytesWritten = notifySomeBytesWritten;
 }
 
@@ -28,32 +32,76 @@ TCPConn::~TCPConn()
     logFunctionTrace
     if (!data_) return;
     if (data_->tlsStream) data_->impl.tlsDeleteOnFinish(data_);
-    else                  data_->impl.deleteOnFinish(data_);
+    else                  data_->reactor.deleteOnFinish(data_);
 }
 
 QByteArray TCPConn::read()
 {
-    const QByteArray retval = data_->readData;
-    data_->readData.resize(0);
-    return retval;
+    return data_->takeReadData();
 }
 
 void TCPConn::write(const QByteArray & data, bool notifyFinished)
 {
-    if (data_->tlsStream) data_->impl.tlsWrite(data_, data, notifyFinished);
-    else                  data_->impl.writeToSocket(data_, data, notifyFinished);
+    if (data_->tlsStream) {
+        data_->impl.tlsWrite(data_, data, notifyFinished);
+    } else {
+        data_->pendingWrite.fetchAndAddRelaxed(data.size());
+        data_->reactor.writeToSocket(data_, data, notifyFinished);
+    }
+}
+
+bool TCPConn::writeFile(int fd, qint64 offset, qint64 length, bool notifyFinished)
+{
+#ifdef Q_OS_LINUX
+    // TLS threads need the plain bytes, unless the kernel encrypts
+    if (data_->tlsStream && !data_->kernelTLS.loadAcquire()) return false;
+    const int dupFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupFd < 0) return false;
+    data_->pendingWrite.fetchAndAddRelaxed(length);
+    // keeps the order of writes still passing the TLS thread
+    if (data_->tlsStream) data_->impl.tlsWriteFile(data_, dupFd, offset, length, notifyFinished);
+    else                  data_->reactor.writeFile(data_, dupFd, offset, length, notifyFinished);
+    return true;
+#else
+    Q_UNUSED(fd); Q_UNUSED(offset); Q_UNUSED(length); Q_UNUSED(notifyFinished);
+    return false;
+#endif
+}
+
+void TCPConn::setWriteWatermarks(quint64 highWatermark, quint64 lowWatermark, quint64 maxPending)
+{
+    data_->reactor.setWriteWatermarks(data_, highWatermark, lowWatermark, maxPending);
+}
+
+quint64 TCPConn::pendingWriteBytes() const
+{
+    return qMax(data_->pendingWrite.loadRelaxed(), (qint64)0);
 }
 
 void TCPConn::close(CloseType type, bool notifyClose)
 {
     if (data_->tlsStream) data_->impl.tlsCloseConn(data_, type, notifyClose);
-    else                  data_->impl.closeConn(data_, type, notifyClose);
+    else                  data_->reactor.closeConn(data_, type, notifyClose);
 }
 
 void TCPConn::startReadWatcher()
 {
     if (data_->tlsStream) data_->impl.tlsStartReadWatcher(data_);
-    else                  data_->impl.startReadWatcher(data_);
+    else                  data_->reactor.startReadWatcher(data_);
+}
+
+bool TCPConn::startStreaming(quint64 credit)
+{
+    // TLS threads decrypt readData in place
+    if (data_->tlsStream) return false;
+    data_->streaming = true;
+    data_->reactor.addReadCredit(data_, credit);
+    return true;
+}
+
+void TCPConn::addReadCredit(quint64 credit)
+{
+    if (data_->streaming) data_->reactor.addReadCredit(data_, credit);
 }
 
 TCPConn::CloseType TCPConn::isClosed() const
@@ -84,9 +132,20 @@ void TCPConn::setNoDelay(bool noDelay)
     impl::TCPManagerImpl::setNoDelay(data_->socket, noDelay);
 }
 
+void TCPConn::setCork(bool cork)
+{
+    if (data_->tlsStream) data_->impl.tlsSetCork(data_, cork);
+    else                  data_->reactor.setCork(data_, cork);
+}
+
 TCPManager & TCPConn::manager() const
 {
     return data_->impl.parent;
 }
 
+util::ThreadVerify * TCPConn::networkThread() const
+{
+    return &data_->reactor;
+}
+
 }}    // namespace
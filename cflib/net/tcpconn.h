@@ -9,11 +9,14 @@
 
 #include <QtCore>
 
+namespace cflib { namespace util { class ThreadVerify; }}
+
 namespace cflib { namespace net {
 
 class TCPConnData;
 class TCPManager;
 namespace impl { class TCPManagerImpl; }
+namespace impl { class TCPReactor; }
 namespace impl { class TLSThread; }
 
 class TCPConn
@@ -49,6 +52,22 @@ public:
     // if notifyFinished == true, function writeFinished will be called when all bytes got written.
     void write(const QByteArray & data, bool notifyFinished = false);
 
+    // queues length bytes of a file (sendfile) or a pipe (splice, offset is ignored) after all written bytes
+    // fd is duplicated and can be closed by the caller immediately.
+    // notifyFinished works like in write.
+    // returns false for TLS connections (unless encrypted by the kernel, see TCPManager::setKernelTLS)
+    // and on other systems than Linux
+    bool writeFile(int fd, qint64 offset, qint64 length, bool notifyFinished = false);
+
+    // Write backpressure (0 disables a limit):
+    // - writeBufferFull is called once, when the pending bytes reach highWatermark
+    // - writeBufferDrained is called once afterwards, when they dropped to lowWatermark
+    // - exceeding maxPending drops all pending bytes and closes the connection hard ("closed" is called)
+    // With TLS the encrypted bytes are counted.
+    void setWriteWatermarks(quint64 highWatermark, quint64 lowWatermark, quint64 maxPending = 0);
+    // bytes passed to write which have not been sent yet
+    quint64 pendingWriteBytes() const;
+
     // closes the socket
     // - WriteClosed closes the write channel after all bytes have been written
     // - HardClosed may abort pending writes
@@ -63,6 +82,14 @@ public:
     // has to be called repeatedly to get informed via function newBytesAvailable
     void startReadWatcher();
 
+    // Streaming read mode (instead of startReadWatcher, not available with TLS):
+    // The network thread keeps reading while credit is left, every received byte uses one byte of credit.
+    // newBytesAvailable is called once for all bytes received until the next call of read.
+    // More credit (e.g. after processing the data) is granted with addReadCredit.
+    // When the read channel gets closed, "closed" is called.
+    bool startStreaming(quint64 credit);
+    void addReadCredit(quint64 credit);
+
     CloseType isClosed() const;
     QByteArray peerIP() const;
     quint16 peerPort() const;
@@ -72,18 +99,29 @@ public:
     // sets TCP_NODELAY flag on socket
     void setNoDelay(bool noDelay);
 
+    // sets TCP_CORK flag on socket (Linux only) in order with write:
+    // partial segments of the following writes are sent after uncorking
+    void setCork(bool cork);
+
     TCPManager & manager() const;
 
+    // thread doing the socket operations of this connection
+    // TCPConn objects living in this thread avoid cross thread calls.
+    util::ThreadVerify * networkThread() const;
+
 protected:
     virtual void newBytesAvailable() {}
     virtual void closed(CloseType type) { Q_UNUSED(type); }
     virtual void writeFinished() {}
     virtual void someBytesWritten(quint64 count) { Q_UNUSED(count) }
+    virtual void writeBufferFull() {}
+    virtual void writeBufferDrained() {}
 
 private:
     TCPConnData * data_;
     friend class TCPConnData;
     friend class impl::TCPManagerImpl;
+    friend class impl::TCPReactor;
     friend class impl::TLSThread;
 };
 
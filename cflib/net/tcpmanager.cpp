@@ -7,14 +7,16 @@
 
 #include "tcpmanager.h"
 
+#include <cflib/net/impl/tcpconndata.h>
 #include <cflib/net/impl/tcpmanagerimpl.h>
+#include <cflib/net/impl/tlsthread.h>
 
 namespace cflib { namespace net {
 
-TCPManager::TCPManager(uint tlsThreadCount, util::ThreadVerify * other) :
+TCPManager::TCPManager(uint tlsThreadCount, util::ThreadVerify * other, uint reactorCount, IOBackend backend) :
     impl_(other ?
-        new impl::TCPManagerImpl(*this, tlsThreadCount, other) :
-        new impl::TCPManagerImpl(*this, tlsThreadCount))
+        new impl::TCPManagerImpl(*this, tlsThreadCount, qMax(reactorCount, 1u), backend, other) :
+        new impl::TCPManagerImpl(*this, tlsThreadCount, qMax(reactorCount, 1u), backend))
 {
 }
 
@@ -23,6 +25,16 @@ TCPManager::~TCPManager()
     delete impl_;
 }
 
+bool TCPManager::start(const QByteArray & ip, quint16 port)
+{
+    return impl_->start(ip, port, 0);
+}
+
+bool TCPManager::start(const QByteArray & ip, quint16 port, crypt::TLSCredentials & credentials)
+{
+    return impl_->start(ip, port, &credentials);
+}
+
 void TCPManager::stop()
 {
     impl_->stop();
@@ -55,6 +67,34 @@ TCPConnData * TCPManager::openTLSConnection(const QByteArray & destAddress, quin
     return impl_->openConnection(destAddress, destPort, sourceIP, sourcePort, &impl_->clientCredentials, preferIPv6);
 }
 
+void TCPManager::openConnectionAsync(const QByteArray & destAddress, quint16 destPort,
+    const ConnectCallback & callback, bool preferIPv6)
+{
+    impl_->openConnection(destAddress, destPort, QByteArray(), 0, 0, preferIPv6, callback);
+}
+
+void TCPManager::openTLSConnectionAsync(const QByteArray & destAddress, quint16 destPort,
+    const ConnectCallback & callback, bool preferIPv6)
+{
+    impl_->openConnection(destAddress, destPort, QByteArray(), 0, &impl_->clientCredentials, preferIPv6, callback);
+}
+
+TCPConnData * TCPManager::openPooledConnection(const QByteArray & destAddress, quint16 destPort,
+    bool tls, bool preferIPv6, bool * reused)
+{
+    return impl_->openPooledConnection(destAddress, destPort, tls ? &impl_->clientCredentials : 0, preferIPv6, reused);
+}
+
+void TCPManager::releaseConnection(TCPConnData * data)
+{
+    impl_->releaseConnection(data);
+}
+
+void TCPManager::setConnectionPool(uint maxIdle, uint maxIdlePerHost, uint idleTimeoutSec)
+{
+    impl_->setConnectionPool(maxIdle, maxIdlePerHost, idleTimeoutSec);
+}
+
 int TCPManager::openListenSocket(const QByteArray & ip, quint16 port)
 {
     return impl::TCPManagerImpl::openListenSocket(ip, port);
@@ -80,9 +120,60 @@ crypt::TLSCredentials & TCPManager::clientCredentials()
     return impl_->clientCredentials;
 }
 
+void TCPManager::setTLSSessionResumption(uint ticketKeyLifetimeSec, uint maxCachedSessions)
+{
+    impl_->serverSessions.setResumption(ticketKeyLifetimeSec, maxCachedSessions);
+}
+
+const crypt::TLSSessions & TCPManager::tlsServerSessions() const
+{
+    return impl_->serverSessions;
+}
+
+void TCPManager::setKernelTLS(bool enable)
+{
+    impl_->kernelTLS = enable;
+}
+
+void TCPManager::setTLSHandshakeThreads(uint threadCount, uint maxPendingHandshakes)
+{
+    impl_->setTLSHandshakeThreads(threadCount, maxPendingHandshakes);
+}
+
+quint64 TCPManager::rejectedTLSHandshakes() const
+{
+    const impl::TLSHandshakePool * pool = impl_->handshakePool();
+    return pool ? pool->rejected() : 0;
+}
+
+QList<TCPManager::TLSThreadStats> TCPManager::tlsThreadStats() const
+{
+    return impl_->tlsThreadStats();
+}
+
+void TCPManager::setSocketOptions(const SocketOptions & options)
+{
+    impl_->socketOptions = options;
+}
+
+const TCPManager::SocketOptions & TCPManager::socketOptions() const
+{
+    return impl_->socketOptions;
+}
+
+qint64 TCPManager::readBufferBytes()
+{
+    return TCPConnData::readBufferBytes.loadRelaxed();
+}
+
+quint64 TCPManager::ioSyscalls()
+{
+    return TCPConnData::ioSyscalls.loadRelaxed();
+}
+
 void TCPManager::newConnection(TCPConnData * data)
 {
-    impl_->deleteOnFinish(data);
+    data->reactor.deleteOnFinish(data);
 }
 
 }}    // namespace
@@ -9,7 +9,9 @@
 
 #include <QtCore>
 
-namespace cflib { namespace crypt { class TLSCredentials; }}
+#include <functional>
+
+namespace cflib { namespace crypt { class TLSCredentials; class TLSSessions; }}
 namespace cflib { namespace util  { class ThreadVerify; }}
 
 namespace cflib { namespace net {
@@ -20,17 +22,53 @@ namespace impl { class TCPManagerImpl; }
 class TCPManager
 {
     Q_DISABLE_COPY(TCPManager)
+public:
+    enum IOBackend {
+        LibEVBackend,     // readiness based: libev watchers with recv / send / accept
+        IOUringBackend    // completion based (Linux >= 6.0), falls back to LibEVBackend if not available
+    };
+
+    // data is 0, if the connection could not be opened
+    typedef std::function<void (TCPConnData * data)> ConnectCallback;
+
+    // Options of the sockets of a TCPManager (0 / false keeps the system default).
+    // Listen sockets use backlog, buffer sizes, deferAcceptSecs and fastOpenQueue,
+    // accepted and opened sockets all others and the buffer sizes.
+    // Options not supported by the system are ignored.
+    struct SocketOptions {
+        int  backlog               = 1024;
+        int  sendBufferSize        = 0;        // SO_SNDBUF
+        int  receiveBufferSize     = 0;        // SO_RCVBUF
+        int  deferAcceptSecs       = 0;        // TCP_DEFER_ACCEPT: accept not before the first data
+        int  fastOpenQueue         = 0;        // TCP_FASTOPEN: pending TFO requests of listen sockets
+        bool fastOpenConnect       = false;    // TCP_FASTOPEN_CONNECT: first write goes with the SYN
+        bool noDelay               = false;    // TCP_NODELAY
+        bool quickAck              = false;    // TCP_QUICKACK (set again after every read)
+        int  keepAliveIdleSecs     = 0;        // SO_KEEPALIVE with TCP_KEEPIDLE
+        int  keepAliveIntervalSecs = 0;        // TCP_KEEPINTVL
+        int  keepAliveCount        = 0;        // TCP_KEEPCNT
+        int  busyPollUsecs         = 0;        // SO_BUSY_POLL
+        int  notSentLowat          = 0;        // TCP_NOTSENT_LOWAT
+    };
+
 public:
     // tlsThreadCount must be set > 0 when TLS is used
-    TCPManager(uint tlsThreadCount = 0, util::ThreadVerify * other = 0);
+    // reactorCount libev threads share the sockets (the first one is networkThread()).
+    // With more than one reactor
+    // - start(ip, port) opens one SO_REUSEPORT socket per reactor (one shared socket, if not supported)
+    // - start(listenSocket) lets all reactors accept on the given socket
+    // - newConnection is called in the thread of the accepting reactor
+    // IOUringBackend is used by reactors with an own thread (not with other as first reactor).
+    TCPManager(uint tlsThreadCount = 0, util::ThreadVerify * other = 0, uint reactorCount = 1,
+        IOBackend backend = LibEVBackend);
     virtual ~TCPManager();
 
-    bool start(const QByteArray & ip, quint16 port) { return start(openListenSocket(ip, port)); }
-    bool start(const QByteArray & ip, quint16 port, crypt::TLSCredentials & credentials) {
-        return start(openListenSocket(ip, port), credentials); }
+    bool start(const QByteArray & ip, quint16 port);
+    bool start(const QByteArray & ip, quint16 port, crypt::TLSCredentials & credentials);
     void stop();
     bool isRunning() const;
 
+    // connections opened in a reactor thread belong to this reactor, others are spread round robin
     TCPConnData * openConnection(const QByteArray & destAddress, quint16 destPort, bool preferIPv6 = false);
     TCPConnData * openConnection(const QByteArray & destAddress, quint16 destPort,
         const QByteArray & sourceIP, quint16 sourcePort, bool preferIPv6 = false);
@@ -39,6 +77,27 @@ public:
     TCPConnData * openTLSConnection(const QByteArray & destAddress, quint16 destPort,
         const QByteArray & sourceIP, quint16 sourcePort, bool preferIPv6 = false);
 
+    // The functions above block while resolving names, which are not cached (see DNSResolver).
+    // These do not block: names are resolved by resolver threads of this TCPManager.
+    // callback is called directly for IP addresses and cached names, otherwise in a resolver thread.
+    void openConnectionAsync(const QByteArray & destAddress, quint16 destPort,
+        const ConnectCallback & callback, bool preferIPv6 = false);
+    void openTLSConnectionAsync(const QByteArray & destAddress, quint16 destPort,
+        const ConnectCallback & callback, bool preferIPv6 = false);
+
+    // Outbound connections can be reused for the same destAddress, destPort and TLS usage:
+    // - releaseConnection takes a detached connection (see TCPConn::detach) which was opened
+    //   by openPooledConnection and keeps it idle in its reactor
+    // - openPooledConnection returns an idle connection, if the peer has neither closed it nor sent anything
+    //   (only of the own reactor, if called in a reactor thread), otherwise it opens a new one
+    //   (reused tells which one, the peer may still close an idle connection at any time)
+    // Connections which are closed, have pending bytes or exceed the limits get closed instead.
+    // Limits apply per reactor (defaults: 64 idle connections, 8 per destination, 30 seconds idle).
+    TCPConnData * openPooledConnection(const QByteArray & destAddress, quint16 destPort,
+        bool tls = false, bool preferIPv6 = false, bool * reused = 0);
+    void releaseConnection(TCPConnData * data);
+    void setConnectionPool(uint maxIdle, uint maxIdlePerHost, uint idleTimeoutSec);
+
     static int openListenSocket(const QByteArray & ip, quint16 port);
     bool start(int listenSocket);
     bool start(int listenSocket, crypt::TLSCredentials & credentials);
@@ -47,6 +106,55 @@ public:
 
     crypt::TLSCredentials & clientCredentials();
 
+    // Resumption of TLS sessions of accepted connections (default: 3600, 10000).
+    // Session tickets are encrypted with a key replaced every ticketKeyLifetimeSec,
+    // up to maxCachedSessions session ids are kept for TLS 1.2 clients without ticket support.
+    // ticketKeyLifetimeSec == 0 disables resumption.
+    void setTLSSessionResumption(uint ticketKeyLifetimeSec, uint maxCachedSessions = 10000);
+    // handshake counters: fullHandshakes / resumedHandshakes
+    const crypt::TLSSessions & tlsServerSessions() const;
+
+    // Records of accepted TLS 1.3 connections are encrypted by the kernel after the handshake (Linux kTLS).
+    // Reading and writing do not pass the TLS threads anymore and TCPConn::writeFile becomes possible.
+    // Connections stay in the TLS threads, if the kernel or the cipher does not support it.
+    // Received records other than application data (e.g. a TLS 1.3 KeyUpdate) fail with EIO
+    // and close the connection, since plain reads do not return the record type.
+    // Has to be called before start.
+    void setKernelTLS(bool enable);
+
+    // Reads of TLS handshakes are done by threadCount separate threads (default: off).
+    // Thus handshake storms do not delay the records of established connections.
+    // New handshakes are rejected (connection closed), if maxPendingHandshakes reads are waiting (0: unlimited).
+    // Established connections are assigned to the TLS thread with the fewest connections.
+    // Has to be called before start.
+    void setTLSHandshakeThreads(uint threadCount, uint maxPendingHandshakes = 0);
+    quint64 rejectedTLSHandshakes() const;
+
+    // Counters of the TLS threads for monitoring (one entry per thread).
+    // Handshakes done by the handshake pool are counted for the TLS thread of the connection.
+    struct TLSThreadStats {
+        uint    connections;          // current
+        quint64 handshakes;           // finished
+        quint64 handshakeFailures;
+        quint64 bytesReceived;        // encrypted
+        quint64 bytesSent;            // encrypted
+        quint64 botanNsecs;           // spent in en- and decryption, including handshakes
+    };
+    QList<TLSThreadStats> tlsThreadStats() const;
+
+    // has to be called before start and openConnection
+    void setSocketOptions(const SocketOptions & options);
+    const SocketOptions & socketOptions() const;
+
+    // Bytes currently held by read buffers of all TCPManagers:
+    // one recv buffer per reactor and received bytes not yet taken by TCPConn::read.
+    // Idle connections do not hold any read buffer.
+    static qint64 readBufferBytes();
+
+    // Socket syscalls of all TCPManagers made by cflib (recv, send, accept, io_uring_enter, ...).
+    // Syscalls of libev (epoll_wait, epoll_ctl) are not included.
+    static quint64 ioSyscalls();
+
 protected:
     virtual void newConnection(TCPConnData * data);
 
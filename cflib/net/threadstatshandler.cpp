@@ -0,0 +1,35 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include "threadstatshandler.h"
+
+#include <cflib/net/request.h>
+#include <cflib/util/threadstats.h>
+
+using namespace cflib::util;
+
+namespace cflib { namespace net {
+
+ThreadStatsHandler::ThreadStatsHandler(const ThreadStats & stats, const QByteArray & path) :
+    stats_(stats),
+    path_(path)
+{
+}
+
+void ThreadStatsHandler::handleRequest(const Request & request)
+{
+    if (!request.isGET()) return;
+
+    const QByteArray uri = request.getUri();
+    if (uri == path_) {
+        request.sendReply(ThreadStats::toJson(stats_.snapshot()), "application/json");
+    } else if (uri == path_ + "/prometheus") {
+        request.sendReply(ThreadStats::toPrometheus(stats_.snapshot()), "text/plain; version=0.0.4");
+    }
+}
+
+}}    // namespace
@@ -0,0 +1,34 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include <cflib/net/requesthandler.h>
+
+#include <QtCore>
+
+namespace cflib { namespace util { class ThreadStats; }}
+
+namespace cflib { namespace net {
+
+// serves ThreadStats::snapshot()
+// <path>            -> JSON
+// <path>/prometheus -> Prometheus text format
+class ThreadStatsHandler : public RequestHandler
+{
+public:
+    ThreadStatsHandler(const util::ThreadStats & stats, const QByteArray & path = "/threadstats");
+
+protected:
+    void handleRequest(const Request & request) override;
+
+private:
+    const util::ThreadStats & stats_;
+    const QByteArray path_;
+};
+
+}}    // namespace
@@ -37,7 +37,8 @@ public:
         isBinary_(false),
         isDeflated_(false),
         ping_("\x89\x00", 2),
-        deflateEnabled_(deflate)
+        deflateEnabled_(deflate),
+        timer_(this, &WSConnHandler::checkTimeout)
     {
         logTrace("WSConnHandler(%1)", connId_);
         setNoDelay(true);
@@ -45,6 +46,7 @@ public:
         if (connectionTimeoutSec > 0) {
             lastRead_  = QDateTime::currentDateTimeUtc();
             lastWrite_ = QDateTime::currentDateTimeUtc();
+            timer_.start(connectionTimeoutSec / 4.0);
         }
         if (deflateEnabled_) logDebug("using deflate on connection: %1", connId);
     }
@@ -110,12 +112,14 @@ public:
         write(frame);
     }
 
-    void checkTimeout(const QDateTime & now)
+    void checkTimeout()
     {
+        const QDateTime now = QDateTime::currentDateTimeUtc();
         uint last = qMax(lastRead_.secsTo(now), lastWrite_.secsTo(now));
         if (last < connectionSendInterval_) return;
         if (last > connectionDataTimeout_) {
             logInfo("timeout on connection %1", connId_);
+            timer_.stop();
             close(HardClosed, true);
         } else {
             write(ping_);
@@ -137,6 +141,7 @@ protected:
         if (!verifyThreadCall(&WSConnHandler::closed, type)) return;
 
         if ((type & ReadClosed) && (type & WriteClosed)) {
+            timer_.stop();
             service_.connections_.remove(connId_);
             util::deleteNext(this);
         }
@@ -261,6 +266,7 @@ private:
     QDateTime lastWrite_;
     const QByteArray ping_;
     const bool deflateEnabled_;
+    util::EVTimer timer_;
 };
 
 // ============================================================================
@@ -272,16 +278,13 @@ WebSocketService::WebSocketService(const QString & path, const QRegularExpressio
     path_(path),
     allowedOrigin_(allowedOrigin),
     connectionTimeoutSec_(connectionTimeoutSec),
-    lastConnId_(0),
-    timer_(connectionTimeoutSec > 0 ? new util::EVTimer(this, &WebSocketService::checkTimeout) : 0)
+    lastConnId_(0)
 {
     setThreadPrio(QThread::HighPriority);
-    if (timer_) startTimer();
 }
 
 WebSocketService::~WebSocketService()
 {
-    delete timer_;
 }
 
 void WebSocketService::saveHeaderField(const QByteArray & field)
@@ -308,6 +311,13 @@ QByteArray WebSocketService::getRemoteIP(uint connId) const
     return QByteArray();
 }
 
+quint64 WebSocketService::pendingWriteBytes(uint connId) const
+{
+    WSConnHandler * wsHdl = connections_.value(connId);
+    if (wsHdl) return wsHdl->pendingWriteBytes();
+    return 0;
+}
+
 QByteArray WebSocketService::getHeader(uint connId, const QByteArray & header) const
 {
     WSConnHandler * wsHdl = connections_.value(connId);
@@ -391,17 +401,4 @@ void WebSocketService::addConnection(TCPConnData * connData, const QByteArray &
     newConnection(connId);
 }
 
-void WebSocketService::startTimer()
-{
-    if (!verifyThreadCall(&WebSocketService::startTimer)) return;
-    timer_->start(connectionTimeoutSec_ / 4.0);
-}
-
-void WebSocketService::checkTimeout()
-{
-    const QDateTime now = QDateTime::currentDateTimeUtc();
-    QHashIterator<uint, WSConnHandler *> it(connections_);
-    while (it.hasNext()) it.next().value()->checkTimeout(now);
-}
-
 }}    // namespace
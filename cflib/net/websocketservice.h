@@ -12,8 +12,6 @@
 #include <cflib/net/tcpconn.h>
 #include <cflib/util/threadverify.h>
 
-namespace cflib { namespace util { class EVTimer; }}
-
 namespace cflib { namespace net {
 
 class WebSocketService : public RequestHandler, public util::ThreadVerify
@@ -31,6 +29,8 @@ protected:
     void continueRead(uint connId);
 
     QByteArray getRemoteIP(uint connId) const;
+    // not yet sent bytes (for throttling or dropping of messages)
+    quint64 pendingWriteBytes(uint connId) const;
     QByteArray getHeader(uint connId, const QByteArray & header) const;
 
     virtual void newConnection(uint connId);
@@ -42,8 +42,6 @@ protected:
 private:
     void addConnection(TCPConnData * connData, const QByteArray & wsKey, bool deflate,
         const Request::KeyVal & savedHeaders);
-    void startTimer();
-    void checkTimeout();
 
 private:
     const QString path_;
@@ -53,7 +51,6 @@ private:
     class WSConnHandler;
     QHash<uint, WSConnHandler *> connections_;
     uint lastConnId_;
-    util::EVTimer * timer_;
 };
 
 }}    // namespace
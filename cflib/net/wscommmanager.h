@@ -125,14 +125,16 @@ private:
         ConnInfo() : connData(), connDataVerified(true) {}
         C connData;
         ConnIds connIds;
-        QDateTime lastClosed;
+        QByteArray clientId;
+        QDeadlineTimer expires;    // set when the last connection closed
         bool connDataVerified;
     };
+    typedef QPair<QDeadlineTimer, uint> Expiry;
 
 private:
-    void init();
     uint sendNewClientId(uint connId, bool & stopRead);
     void checkTimeout();
+    void stopTimer();
     bool connDataOk(ConnInfo & info, uint connDataId);
 
 private:
@@ -145,6 +147,8 @@ private:
     QHash<uint, ConnInfo> connInfos_;
     QMap<QByteArray, uint> clientIds_;
 
+    // sessions without connections in order of expiry (all have the same timeout)
+    QQueue<Expiry> expiries_;
     util::EVTimer timer_;
     uint sessionTimeoutSec_;
 };
@@ -180,12 +184,12 @@ WSCommManager<C>::WSCommManager(const QString & path, const QRegularExpression &
     connDataChecker_(0),
     timer_(this, &WSCommManager::checkTimeout), sessionTimeoutSec_(sessionTimeoutSec)
 {
-    init();
 }
 
 template<typename C>
 WSCommManager<C>::~WSCommManager()
 {
+    stopTimer();
     stopVerifyThread();
 }
 
@@ -351,7 +355,9 @@ void WSCommManager<C>::closed(uint connId, TCPConn::CloseType)
     const bool isLast = info.connIds.isEmpty();
     if (isLast) {
         info.connDataVerified = false;
-        info.lastClosed = QDateTime::currentDateTimeUtc();
+        info.expires = QDeadlineTimer(sessionTimeoutSec_ * 1000LL);
+        expiries_.enqueue(Expiry(info.expires, dataId));
+        if (!timer_.isActive()) timer_.start(sessionTimeoutSec_, 0);
     }
 
     // inform state listener
@@ -359,13 +365,6 @@ void WSCommManager<C>::closed(uint connId, TCPConn::CloseType)
     while (it.hasNext()) it.next()->connectionClosed(info.connData, dataId, connId, isLast);
 }
 
-template<typename C>
-void WSCommManager<C>::init()
-{
-    if (!verifyThreadCall(&WSCommManager::init)) return;
-    timer_.start(sessionTimeoutSec_ / 10.0);
-}
-
 template<typename C>
 uint WSCommManager<C>::sendNewClientId(uint connId, bool & stopRead)
 {
@@ -381,6 +380,7 @@ uint WSCommManager<C>::sendNewClientId(uint connId, bool & stopRead)
 
     connId2dataId_[connId] = dataId;
     info.connIds << connId;
+    info.clientId = clId;
     clientIds_[clId] = dataId;
     if (connDataChecker_) {
         info.connDataVerified = false;
@@ -396,26 +396,35 @@ uint WSCommManager<C>::sendNewClientId(uint connId, bool & stopRead)
 template<typename C>
 void WSCommManager<C>::checkTimeout()
 {
-    logFunctionTrace
+    // only the oldest entries have to be checked
+    while (!expiries_.isEmpty()) {
+        const Expiry & expiry = expiries_.head();
+        const uint connDataId = expiry.second;
+        typename QHash<uint, ConnInfo>::iterator it = connInfos_.find(connDataId);
+
+        // session got reused or closed again later (then a newer entry exists)
+        if (it == connInfos_.end() || !it->connIds.isEmpty() || it->expires != expiry.first) {
+            expiries_.dequeue();
+            continue;
+        }
 
-    QSet<uint> removedIds;
-    {
-        const QDateTime now = QDateTime::currentDateTimeUtc();
-        QMutableHashIterator<uint, ConnInfo> it(connInfos_);
-        while (it.hasNext()) {
-            ConnInfo & info = it.next().value();
-            if (info.connIds.isEmpty() && info.lastClosed.secsTo(now) > sessionTimeoutSec_) {
-                removedIds << it.key();
-                it.remove();
-            }
+        if (!expiry.first.hasExpired()) {
+            timer_.start(expiry.first.remainingTimeNSecs() / 1e9, 0);
+            return;
         }
-    }
 
-    if (!removedIds.isEmpty()) {
-        QMutableMapIterator<QByteArray, uint> it(clientIds_);
-        while (it.hasNext()) if (removedIds.contains(it.next().value())) it.remove();
-        logDebug("timeout of %1 sessions", removedIds.size());
+        clientIds_.remove(it->clientId);
+        connInfos_.erase(it);
+        expiries_.dequeue();
+        logDebug("timeout of session %1", connDataId);
     }
 }
 
+template<typename C>
+void WSCommManager<C>::stopTimer()
+{
+    if (!verifySyncedThreadCall(&WSCommManager<C>::stopTimer)) return;
+    timer_.stop();
+}
+
 }}    // namespace
@@ -7,42 +7,38 @@
 
 #include "evtimer.h"
 
-#include <cflib/util/libev.h>
 #include <cflib/util/log.h>
-#include <cflib/util/threadverify.h>
 
 USE_LOG(LogCat::Etc)
 
 namespace cflib { namespace util {
 
-void EVTimer::init()
-{
-    timer_ = new ev_timer;
-    ev_init(timer_, &EVTimer::timeout);
-    timer_->data = this;
-}
-
 EVTimer::~EVTimer()
 {
-    delete timer_;
     delete func_;
 }
 
 void EVTimer::start(double after, double repeat)
 {
-    ev_timer_set(timer_, after, repeat);
-    ev_timer_start(libEVLoopOfThread(), timer_);
+    wheel_ = TimerWheel::ofThread();
+    if (!wheel_) {
+        logWarn("EVTimer started outside of a libev thread");
+        return;
+    }
+    repeat_ = repeat;
+    wheel_->start(this, after);
 }
 
 void EVTimer::stop()
 {
-    ev_timer_stop(libEVLoopOfThread(), timer_);
+    if (isActive()) wheel_->stop(this);
 }
 
-void EVTimer::timeout(ev_loop *, ev_timer * w, int)
+void EVTimer::expired()
 {
-    EVTimer * timer = (EVTimer *)w->data;
-    (*timer->func_)();
+    // relative to the scheduled expiry, so that processing delays do not add up
+    if (repeat_ > 0) wheel_->startAt(this, expiresAt() + qMax(qRound64(repeat_ * 1000), Q_INT64_C(1)));
+    (*func_)();
 }
 
 }}    // namespace
@@ -8,35 +8,34 @@
 #pragma once
 
 #include <cflib/util/functor.h>
-
-struct ev_loop;
-struct ev_timer;
+#include <cflib/util/timerwheel.h>
 
 namespace cflib { namespace util {
 
-class EVTimer
+// timer of a libev thread (uses the TimerWheel of the thread calling start)
+class EVTimer : private TimerWheel::Entry
 {
 public:
     template<typename C>
     EVTimer(C * obj, void (C::*method)()) :
-        timer_(0),
-        func_(new Functor0<C>(obj, method))
-    {
-        init();
-    }
+        func_(new Functor0<C>(obj, method)),
+        wheel_(0),
+        repeat_(0)
+    {}
     ~EVTimer();
 
     void start(double after, double repeat);
     void start(double repeat) { start(repeat, repeat); }
     void stop();
+    bool isActive() const { return TimerWheel::Entry::isActive(); }
 
-private:
-    void init();
-    static void timeout(ev_loop * loop, ev_timer * w, int revents);
+protected:
+    void expired() override;
 
 private:
-    ev_timer * timer_;
     Functor * func_;
+    TimerWheel * wheel_;
+    double repeat_;
 };
 
 }}    // namespace
@@ -9,6 +9,8 @@
 
 #include <QtCore>
 
+#include <cflib/util/impl/functorpool.h>
+
 namespace cflib { namespace util {
 
 template<typename T> struct RemoveConstRef            { typedef T Type; };
@@ -16,11 +18,30 @@ template<typename T> struct RemoveConstRef<const T &> { typedef T Type; };
 
 // ============================================================================
 
+// Calls of higher priority get executed first.
+// Lower priorities still get a share, so they cannot starve.
+enum CallPriority {
+    CallCritical = 0,
+    CallNormal   = 1,
+    CallBulk     = 2
+};
+const uint CallPriorityCount = 3;
+
+// ============================================================================
+
 class Functor
 {
 public:
     virtual ~Functor() {}
     virtual void operator()() const = 0;
+
+    // set by the receiving thread for its stats (0: not measured)
+    mutable qint64 queuedAt = 0;
+    mutable CallPriority priority = CallNormal;
+
+    // functors are mostly created in one thread and deleted in another
+    static void * operator new(std::size_t size)           { return impl::functorAlloc(size); }
+    static void operator delete(void * ptr, std::size_t size) { impl::functorFree(ptr, size); }
 };
 
 template<typename C>
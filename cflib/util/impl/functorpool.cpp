@@ -0,0 +1,182 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include "functorpool.h"
+
+#include <QtCore>
+
+#include <new>
+
+namespace cflib { namespace util { namespace impl {
+
+namespace {
+
+const std::size_t Granularity = 32;
+const uint ClassCount = 8;              // blocks up to 256 bytes
+const uint BatchSize = 64;              // blocks moved at once between thread and central pool
+const uint MaxCentralBatches = 256;     // per size class
+
+struct FreeBlock
+{
+    FreeBlock * next;
+    FreeBlock * nextBatch;
+};
+
+inline uint sizeClass(std::size_t size)
+{
+    return (uint)((size - 1) / Granularity);
+}
+
+inline void freeList(FreeBlock * block)
+{
+    while (block) {
+        FreeBlock * next = block->next;
+        ::operator delete(block);
+        block = next;
+    }
+}
+
+class CentralPool
+{
+public:
+    CentralPool()
+    {
+        for (uint i = 0 ; i < ClassCount ; ++i) {
+            batches_[i] = 0;
+            count_[i] = 0;
+        }
+    }
+
+    ~CentralPool()
+    {
+        for (uint i = 0 ; i < ClassCount ; ++i) {
+            FreeBlock * batch = batches_[i];
+            while (batch) {
+                FreeBlock * next = batch->nextBatch;
+                freeList(batch);
+                batch = next;
+            }
+        }
+    }
+
+    FreeBlock * take(uint cls)
+    {
+        QMutexLocker ml(&mutex_);
+        FreeBlock * batch = batches_[cls];
+        if (!batch) return 0;
+        batches_[cls] = batch->nextBatch;
+        --count_[cls];
+        return batch;
+    }
+
+    void put(uint cls, FreeBlock * batch)
+    {
+        {
+            QMutexLocker ml(&mutex_);
+            if (count_[cls] < MaxCentralBatches) {
+                batch->nextBatch = batches_[cls];
+                batches_[cls] = batch;
+                ++count_[cls];
+                return;
+            }
+        }
+        freeList(batch);
+    }
+
+private:
+    QMutex mutex_;
+    FreeBlock * batches_[ClassCount];
+    uint count_[ClassCount];
+};
+
+Q_GLOBAL_STATIC(CentralPool, centralPool)
+
+// Functors may still be deleted after threadCache (e.g. by other thread_local destructors).
+// Trivially destructible, so it can be read at any time.
+thread_local bool threadCacheDestroyed = false;
+
+class ThreadCache
+{
+public:
+    ThreadCache()
+    {
+        for (uint i = 0 ; i < ClassCount ; ++i) {
+            free_[i] = 0;
+            count_[i] = 0;
+        }
+    }
+
+    ~ThreadCache()
+    {
+        for (uint i = 0 ; i < ClassCount ; ++i) {
+            freeList(free_[i]);
+            free_[i] = 0;
+            count_[i] = 0;
+        }
+        threadCacheDestroyed = true;
+    }
+
+    void * alloc(uint cls)
+    {
+        FreeBlock * block = free_[cls];
+        if (!block) {
+            CentralPool * central = centralPool();
+            block = central ? central->take(cls) : 0;
+            if (!block) return ::operator new((cls + 1) * Granularity);
+            count_[cls] = BatchSize;
+        }
+        free_[cls] = block->next;
+        --count_[cls];
+        return block;
+    }
+
+    void free(uint cls, void * ptr)
+    {
+        FreeBlock * block = (FreeBlock *)ptr;
+        block->next = free_[cls];
+        free_[cls] = block;
+        if (++count_[cls] < 2 * BatchSize) return;
+
+        // give one batch back to the central pool
+        FreeBlock * last = block;
+        for (uint i = 1 ; i < BatchSize ; ++i) last = last->next;
+        free_[cls] = last->next;
+        last->next = 0;
+        count_[cls] -= BatchSize;
+        CentralPool * central = centralPool();
+        if (central) central->put(cls, block);
+        else         freeList(block);
+    }
+
+private:
+    FreeBlock * free_[ClassCount];
+    uint count_[ClassCount];
+};
+
+thread_local ThreadCache threadCache;
+
+}
+
+void * functorAlloc(std::size_t size)
+{
+    if (size == 0) size = 1;
+    const uint cls = sizeClass(size);
+    if (cls >= ClassCount) return ::operator new(size);
+    if (threadCacheDestroyed) return ::operator new((cls + 1) * Granularity);
+    return threadCache.alloc(cls);
+}
+
+void functorFree(void * ptr, std::size_t size)
+{
+    if (!ptr) return;
+    if (size == 0) size = 1;
+    const uint cls = sizeClass(size);
+    if (cls >= ClassCount || threadCacheDestroyed) ::operator delete(ptr);
+    else                                          threadCache.free(cls, ptr);
+}
+
+}}}    // namespace
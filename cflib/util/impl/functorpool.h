@@ -0,0 +1,22 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+// Memory for small objects created in one thread and deleted in another.
+// Every thread keeps a cache of free blocks per size class.
+// Surplus blocks are exchanged in batches via a central pool,
+// so in steady state no call to malloc / free happens.
+
+namespace cflib { namespace util { namespace impl {
+
+void * functorAlloc(std::size_t size);
+void functorFree(void * ptr, std::size_t size);
+
+}}}    // namespace
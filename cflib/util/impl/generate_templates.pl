@@ -12,12 +12,15 @@ my $maxParams = 8;
 
 sub verifyThreadCall
 {
-    my ($paramCount, $sync, $const) = @_;
+    my ($paramCount, $sync, $const, $prio) = @_;
 
     my $synced = $sync ? "Synced" : "";
+    my $prio1  = $prio ? "CallPriority prio, " : "";
+    my $prio2  = $prio ? ", false, prio" : "";
     my $sem1   = $sync ? "\n        QSemaphore sem;" : "";
     my $sem2   = $sync ? ", &sem" : "";
     my $sem3   = $sync ? "\n        sem.acquire();" : "";
+    my $sem4   = $sync ? ", true" : "";
     my $const1 = $const ? " const" : "";
     my $const2 = $const ? "const " : "";
     my $const3 = $const ? "C" : "";
@@ -38,10 +41,10 @@ sub verifyThreadCall
     print
 <<"EOF"
     template<typename C$typesP$typesA>
-    bool verify${synced}ThreadCall(void (C::*f)($tempP2)$const1$paramD)$const1
+    bool verify${synced}ThreadCall(${prio1}void (C::*f)($tempP2)$const1$paramD)$const1
     {
         if (verifyThread_->isOwnThread()) return true;$sem1
-        execCall(new Functor$paramCount$const3<C$tempP1>((${const2}C *)this, f$paramU$sem2));$sem3
+        execCall(new Functor$paramCount$const3<C$tempP1>((${const2}C *)this, f$paramU$sem2)$sem4$prio2);$sem3
         return false;
     }
 
@@ -76,7 +79,7 @@ sub verify
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor$paramCount$const3<C, R$tempP1>((${const2}C *)tv_, f, retval_$paramU, &sem));
+            tv_->execCall(new RFunctor$paramCount$const3<C, R$tempP1>((${const2}C *)tv_, f, retval_$paramU, &sem), true);
             sem.acquire();
             return false;
         }
@@ -89,6 +92,8 @@ sub genVerify
     for (my $i = 0 ; $i <= $maxParams ; ++$i) {
         verifyThreadCall($i, 0, 0);
         verifyThreadCall($i, 0, 1);
+        verifyThreadCall($i, 0, 0, 1);
+        verifyThreadCall($i, 0, 1, 1);
         verifyThreadCall($i, 1, 0);
         verifyThreadCall($i, 1, 1);
         print "    // ------------------------------------------------------------------------\n\n";
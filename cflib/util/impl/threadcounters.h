@@ -0,0 +1,113 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include <cflib/util/functor.h>
+
+#include <chrono>
+
+namespace cflib { namespace util { namespace impl {
+
+inline qint64 monotonicNsecs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Counters are written by one thread only and may be read by any thread.
+// So no atomic read-modify-write is needed.
+inline void counterAdd(QAtomicInteger<quint64> & counter, quint64 value)
+{
+    counter.storeRelaxed(counter.loadRelaxed() + value);
+}
+
+inline void counterMax(QAtomicInteger<quint64> & counter, quint64 value)
+{
+    if (value > counter.loadRelaxed()) counter.storeRelaxed(value);
+}
+
+// HDR style histogram:
+// values 0 .. 7 are exact, above that each power of two is split into 8 buckets (max error 12.5%)
+class AtomicHistogram
+{
+public:
+    enum {
+        SubBits     = 3,
+        SubCount    = 1 << SubBits,
+        BucketCount = (64 - SubBits + 1) * SubCount
+    };
+
+public:
+    static uint bucket(quint64 value)
+    {
+        if (value < SubCount) return (uint)value;
+        const uint exp = 63 - qCountLeadingZeroBits(value);
+        return (exp - SubBits + 1) * SubCount + (uint)((value >> (exp - SubBits)) & (SubCount - 1));
+    }
+
+    static quint64 lowerBound(uint bucket)
+    {
+        if (bucket < SubCount) return bucket;
+        const uint exp = bucket / SubCount + SubBits - 1;
+        return (quint64)(SubCount + bucket % SubCount) << (exp - SubBits);
+    }
+
+    void record(quint64 value) { counterAdd(counts_[bucket(value)], 1); }
+
+    QVector<quint64> counts() const
+    {
+        QVector<quint64> rv(BucketCount);
+        for (uint i = 0 ; i < BucketCount ; ++i) rv[i] = counts_[i].loadRelaxed();
+        return rv;
+    }
+
+private:
+    QAtomicInteger<quint64> counts_[BucketCount];
+};
+
+// statistics of one OS thread
+class ThreadCounters
+{
+    Q_DISABLE_COPY(ThreadCounters)
+public:
+    ThreadCounters(const QString & threadName, int threadId) :
+        threadName(threadName), threadId(threadId) {}
+
+    const QString threadName;
+    const int threadId;
+
+    QAtomicInteger<quint64> calls;
+    QAtomicInteger<quint64> busyNsecs;
+    QAtomicInteger<quint64> waitNsecs;
+    QAtomicInteger<quint64> contention;
+    QAtomicInteger<quint64> overflows;
+    QAtomicInteger<quint64> maxQueueDepth;
+    AtomicHistogram waitTime;       // nsecs from enqueue to start
+    AtomicHistogram execTime;       // nsecs per call
+    AtomicHistogram queueDepth;     // calls waiting when a call starts
+    QAtomicInteger<quint64> laneCalls[CallPriorityCount];
+    AtomicHistogram laneWaitTime[CallPriorityCount];
+
+    void recordCall(CallPriority lane, qint64 queuedAt, qint64 start, qint64 end, quint64 depth)
+    {
+        counterAdd(calls, 1);
+        counterAdd(laneCalls[lane], 1);
+        counterAdd(busyNsecs, end - start);
+        if (queuedAt > 0) {
+            const quint64 wait = start > queuedAt ? start - queuedAt : 0;
+            counterAdd(waitNsecs, wait);
+            waitTime.record(wait);
+            laneWaitTime[lane].record(wait);
+        }
+        execTime.record(end - start);
+        queueDepth.record(depth);
+        counterMax(maxQueueDepth, depth);
+    }
+};
+
+}}}    // namespace
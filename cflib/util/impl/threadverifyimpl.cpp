@@ -9,26 +9,51 @@
 
 #include <cflib/util/libev.h>
 #include <cflib/util/log.h>
+#include <cflib/util/threadplacement.h>
 #include <cflib/util/threadstats.h>
+#include <cflib/util/timerwheel.h>
+
+#include <atomic>
 
 USE_LOG(LogCat::Etc)
 
 namespace cflib { namespace util { namespace impl {
 
-ThreadObject::ThreadObject(int threadId, ThreadStats * stats) :
-    threadId_(threadId), stats_(stats)
+namespace {
+
+// Lanes are searched from the highest priority on.
+// But every 8th call starts with CallNormal and every 64th with CallBulk.
+const uint LaneOrder[CallPriorityCount][CallPriorityCount] = {
+    { CallCritical, CallNormal,   CallBulk   },
+    { CallNormal,   CallCritical, CallBulk   },
+    { CallBulk,     CallCritical, CallNormal }
+};
+
+inline uint firstLane(uint turn)
+{
+    return turn % 64 == 0 ? CallBulk : turn % 8 == 0 ? CallNormal : CallCritical;
+}
+
+// auto scaling: busy ratio is measured over this interval and at most one thread is started per GrowInterval
+const qint64 LoadCheckInterval = 100 * 1000 * 1000;
+const qint64 GrowInterval      =  10 * 1000 * 1000;
+
+inline int qtEventPriority(CallPriority prio)
+{
+    return prio == CallCritical ? Qt::HighEventPriority : prio == CallBulk ? Qt::LowEventPriority : Qt::NormalEventPriority;
+}
+
+}
+
+ThreadObject::ThreadObject(ThreadHolderQt & thread) :
+    thread_(thread)
 {
 }
 
 bool ThreadObject::event(QEvent * event)
 {
     if (event->type() == QEvent::User) {
-        QElapsedTimer elapsed;
-        if (stats_) elapsed.start();
-        const Functor * func = ((ThreadHolderEvent *)event)->func;
-        (*func)();
-        delete func;
-        if (stats_) stats_->externNewCallTime(threadId_, elapsed.nsecsElapsed());
+        thread_.processCalls();
         return true;
     }
     return QObject::event(event);
@@ -37,6 +62,7 @@ bool ThreadObject::event(QEvent * event)
 ThreadHolder::ThreadHolder(const QString & threadName, int threadId, ThreadStats * stats, bool disable) :
     threadName(threadName),
     threadId_(threadId), stats_(stats),
+    counters_(stats ? stats->externNewCounters(threadName, threadId) : 0),
     disabled_(disable), isActive_(true)
 {
     setObjectName(threadName);
@@ -47,25 +73,94 @@ ThreadHolder::~ThreadHolder()
     logTrace("~ThreadHolder()");
 }
 
+bool ThreadHolder::setCallQueueLimit(uint, FifoFullPolicy)
+{
+    return false;
+}
+
+bool ThreadHolder::setAutoScaling(uint, double, double, double)
+{
+    return false;
+}
+
+void ThreadHolder::applyPlacement(const QString & loopType)
+{
+    const QString placement = applyThreadPlacement(threadName, loopType);
+    if (stats_) stats_->externPlacement(threadId_, threadName, placement);
+}
+
 ThreadHolderQt::ThreadHolderQt(const QString & threadName, int threadId, ThreadStats * stats, bool disable) :
-    ThreadHolder(threadName, threadId, stats, disable)
+    ThreadHolder(threadName, threadId, stats, disable),
+    eventPosted_(0),
+    turn_(0)
 {
-    threadObject_ = new ThreadObject(threadId, stats);
+    threadObject_ = new ThreadObject(*this);
     if (!disable) {
         threadObject_->moveToThread(this);
         start();
     }
 }
 
-bool ThreadHolderQt::doCall(const Functor * func)
+ThreadHolderQt::~ThreadHolderQt()
 {
-    QCoreApplication::postEvent(threadObject_, new impl::ThreadHolderEvent(func));
-    return true;
+    // calls which arrived after the loop stopped
+    for (uint lane = 0 ; lane < CallPriorityCount ; ++lane) {
+        while (const Functor * func = calls_[lane].take()) delete func;
+    }
+}
+
+bool ThreadHolderQt::doCall(const Functor * func, bool ignoreLimit)
+{
+    return queueCall(func, ignoreLimit);
 }
 
 void ThreadHolderQt::execLater(const Functor * func) const
 {
-    QCoreApplication::postEvent(threadObject_, new impl::ThreadHolderEvent(func));
+    // own thread must never block
+    const_cast<ThreadHolderQt *>(this)->queueCall(func, true);
+}
+
+bool ThreadHolderQt::setCallQueueLimit(uint maxCalls, FifoFullPolicy policy)
+{
+    for (uint lane = 0 ; lane < CallPriorityCount ; ++lane) calls_[lane].setLimit(maxCalls, policy);
+    return true;
+}
+
+bool ThreadHolderQt::queueCall(const Functor * func, bool ignoreLimit)
+{
+    markQueued(func);
+    if (func->priority == CallCritical) ignoreLimit = true;
+    if (!calls_[func->priority].put(func, ignoreLimit)) return false;
+
+    // only the first call after the last processCalls posts an event
+    if (eventPosted_.loadRelaxed() == 0 && eventPosted_.testAndSetOrdered(0, 1)) {
+        QCoreApplication::postEvent(threadObject_, new QEvent(QEvent::User), qtEventPriority(func->priority));
+    }
+    return true;
+}
+
+void ThreadHolderQt::processCalls()
+{
+    // Calls queued from now on post a new event,
+    // so they do not delay Qt events which arrived in the meantime.
+    eventPosted_.fetchAndStoreOrdered(0);
+    quint64 count = 0;
+    for (uint lane = 0 ; lane < CallPriorityCount ; ++lane) count += calls_[lane].size();
+
+    for (quint64 i = 0 ; i < count ; ++i) {
+        const uint * order = LaneOrder[firstLane(++turn_)];
+        const Functor * func = 0;
+        for (uint l = 0 ; l < CallPriorityCount && !func ; ++l) func = calls_[order[l]].take();
+        if (!func) break;
+        execFunctor(func, count - i - 1);
+    }
+
+    if (counters_) {
+        for (uint lane = 0 ; lane < CallPriorityCount ; ++lane) {
+            counterAdd(counters_->contention, calls_[lane].takeContentionCount());
+            counterAdd(counters_->overflows,  calls_[lane].takeOverflowCount());
+        }
+    }
 }
 
 void ThreadHolderQt::stopLoop()
@@ -81,6 +176,7 @@ void ThreadHolderQt::stopLoop()
 
 void ThreadHolderQt::run()
 {
+    applyPlacement("qt");
     logDebug("thread %1 started with Qt event loop", threadName);
     exec();
     isActive_ = false;
@@ -92,12 +188,17 @@ void ThreadHolderQt::run()
 
 ThreadHolderLibEV::ThreadHolderLibEV(const QString & threadName, int threadId, ThreadStats * stats, bool isWorkerOnly, bool disable) :
     ThreadHolder(threadName, threadId, stats, disable),
+    isWorkerOnly_(isWorkerOnly),
     loop_(ev_loop_new((uint)EVFLAG_NOSIGMASK | (isWorkerOnly ? EVBACKEND_SELECT : EVBACKEND_ALL))),
-    wakeupWatcher_(new ev_async)
+    wakeupWatcher_(new ev_async),
+    laterWatcher_(new ev_timer),
+    timerWheel_(0)
 {
     ev_async_init(wakeupWatcher_, &ThreadHolderLibEV::asyncCallback);
     wakeupWatcher_->data = this;
     ev_async_start(loop_, wakeupWatcher_);
+    ev_timer_init(laterWatcher_, &ThreadHolderLibEV::execLaterCall, 0.0, 0.0);
+    laterWatcher_->data = this;
 }
 
 ThreadHolderLibEV::~ThreadHolderLibEV()
@@ -105,6 +206,10 @@ ThreadHolderLibEV::~ThreadHolderLibEV()
     ev_async_stop(loop_, wakeupWatcher_);
     wakeupWatcher_->data = 0;
     delete wakeupWatcher_;
+    ev_timer_stop(loop_, laterWatcher_);
+    delete laterWatcher_;
+    foreach (const Functor * func, laterCalls_) delete func;
+    delete timerWheel_;
     ev_loop_destroy(loop_);
 }
 
@@ -115,14 +220,32 @@ void ThreadHolderLibEV::stopLoop()
 
 void ThreadHolderLibEV::execLater(const Functor * func) const
 {
-    ev_once(loop_, -1, 0, 0.0, &ThreadHolderLibEV::execLaterCall, (void *)func);
+    // only called from own thread
+    markQueued(func);
+    laterCalls_ << func;
+    if (!ev_is_active(laterWatcher_)) ev_timer_start(loop_, laterWatcher_);
 }
 
-void ThreadHolderLibEV::execLaterCall(int, void * arg)
+void ThreadHolderLibEV::execLaterCall(ev_loop *, ev_timer * w, int)
 {
-    const Functor * func = (const Functor *)arg;
-    (*func)();
-    delete func;
+    ThreadHolderLibEV * th = (ThreadHolderLibEV *)w->data;
+
+    // calls added while running are executed in the next loop iteration
+    th->runningLaterCalls_.swap(th->laterCalls_);
+    const int count = th->runningLaterCalls_.size();
+    for (int i = 0 ; i < count ; ++i) th->execFunctor(th->runningLaterCalls_[i], count - i - 1);
+    th->runningLaterCalls_.resize(0);
+}
+
+TimerWheel * ThreadHolderLibEV::timerWheel()
+{
+    if (!timerWheel_) timerWheel_ = new TimerWheel(loop_);
+    return timerWheel_;
+}
+
+bool ThreadHolderLibEV::hasPendingWork() const
+{
+    return !laterCalls_.isEmpty() || (timerWheel_ && timerWheel_->count() > 0);
 }
 
 void ThreadHolderLibEV::wakeUp()
@@ -132,6 +255,7 @@ void ThreadHolderLibEV::wakeUp()
 
 void ThreadHolderLibEV::run()
 {
+    applyPlacement(isWorkerOnly_ ? "worker" : "net");
     logDebug("thread %1 started with libev backend %2", threadName, ev_backend(loop_));
     ev_run(loop_, 0);
     isActive_ = false;
@@ -148,38 +272,123 @@ ThreadHolderWorkerPool::ThreadHolderWorkerPool(const QString & threadName,
 :
     ThreadHolderLibEV(threadCount > 1 ? QString("%1 1/%2").arg(threadName).arg(threadCount) : threadName,
         threadId, stats, isWorkerOnly, threadCount == 0),
-    externalCalls_(1024),
-    stopLoop_(false)
+    nextQueue_(0),
+    stopLoop_(0),
+    queued_(0),
+    maxCalls_(0),
+    policy_(FifoGrow),
+    waiting_(0),
+    autoScaling_(0),
+    minThreads_(threadCount),
+    busyRatio_(1),
+    maxWaitNsecs_(0),
+    idleSecs_(0),
+    activeThreads_(threadCount),
+    nextLoadCheck_(0),
+    nextGrow_(0),
+    lastLoadCheck_(0),
+    lastBusyNsecs_(0)
 {
-    if (!disabled_) start();
+    // all queues have to exist before any thread starts
+    queues_ << new CallQueue(this);
     for (uint i = 2 ; i <= threadCount ; ++i) {
-        Worker * thread = new Worker(QString("%1 %2/%3").arg(threadName).arg(i).arg(threadCount), threadId, stats, i - 1, externalCalls_);
+        Worker * thread = new Worker(QString("%1 %2/%3").arg(threadName).arg(i).arg(threadCount), threadId, stats, i - 1, *this);
         workers_ << thread;
+        queues_ << new CallQueue(thread);
     }
+
+    if (!disabled_) start();
+    foreach (Worker * w, workers_) w->start();
 }
 
 ThreadHolderWorkerPool::~ThreadHolderWorkerPool()
 {
     foreach (Worker * w, workers_) delete w;
+    foreach (CallQueue * q, queues_) {
+        // pinned calls which arrived while stopping
+        while (const Functor * func = q->pinned.take()) delete func;
+        delete q;
+    }
 }
 
-bool ThreadHolderWorkerPool::doCall(const Functor * func)
+bool ThreadHolderWorkerPool::doCall(const Functor * func, bool ignoreLimit)
 {
-    if (!externalCalls_.put(func)) {
-        if (stats_) stats_->externOverflow(threadId_);
-        const impl::ThreadHolder * thread = dynamic_cast<const impl::ThreadHolder *>(QThread::currentThread());
-        logWarn("queue of thread %1 full (called by %2)", threadName, thread ? thread->threadName : "?");
-        return false;
+    const uint count = queues_.size();
+    const uint start = nextQueue_.fetchAndAddRelaxed(1);
+    const uint lane = func->priority;
+    if (autoScaling_.loadRelaxed()) func->queuedAt = monotonicNsecs();
+    else                            markQueued(func);
+
+    // critical calls are never limited
+    if (lane == CallCritical) ignoreLimit = true;
+    if (!reserveCall(ignoreLimit)) return false;
+
+    // hand the call directly to one parked thread
+    for (uint i = 0 ; i < count ; ++i) {
+        CallQueue & q = *queues_[(start + i) % count];
+        if (q.parked.loadRelaxed() == 1 && q.parked.testAndSetOrdered(1, 0)) {
+            q.calls[lane].put(func, true);
+            q.thread->wakeUp();
+            return true;
+        }
+    }
+
+    // All threads are busy. The call will be taken by the owner of the queue
+    // or stolen by the first thread running out of work.
+    queues_[start % count]->calls[lane].put(func, true);
+
+    // a thread may have parked in the meantime
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (uint i = 0 ; i < count ; ++i) {
+        CallQueue & q = *queues_[(start + i) % count];
+        if (q.parked.loadRelaxed() == 1 && q.parked.testAndSetOrdered(1, 0)) {
+            q.thread->wakeUp();
+            break;
+        }
     }
-    wakeUp();
-    foreach (Worker * w, workers_) w->wakeUp();
     return true;
 }
 
+bool ThreadHolderWorkerPool::doThreadCall(const Functor * func)
+{
+    if (disabled_) return doCall(func, true);
+    return callThread(0, func);
+}
+
+bool ThreadHolderWorkerPool::callThread(uint threadNo, const Functor * func)
+{
+    // stopping pool: no restart of retired threads, caller deletes func
+    if (stopLoop_.loadAcquire()) return false;
+
+    if (autoScaling_.loadRelaxed()) func->queuedAt = monotonicNsecs();
+    else                            markQueued(func);
+
+    CallQueue & q = *queues_[threadNo];
+    q.pinned.put(func, true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // a retired thread has to run again
+    if (threadNo > 0 && q.running.loadAcquire() == 0 && q.running.testAndSetOrdered(0, 1)) {
+        activeThreads_.fetchAndAddOrdered(1);
+        logDebug("auto scaling: restarting thread %1 for a pinned call", q.thread->threadName);
+        workers_[threadNo - 1]->restart();
+        return true;
+    }
+    if (q.parked.loadRelaxed() == 1 && q.parked.testAndSetOrdered(1, 0)) q.thread->wakeUp();
+    return true;
+}
+
+void ThreadHolderWorkerPool::execLater(const Functor * func) const
+{
+    // calls with priority go through the lanes
+    if (func->priority == CallNormal) ThreadHolderLibEV::execLater(func);
+    else                              const_cast<ThreadHolderWorkerPool *>(this)->doCall(func, true);
+}
+
 void ThreadHolderWorkerPool::stopLoop()
 {
     if (!disabled_) {
-        stopLoop_ = true;
+        stopLoop_.storeRelease(1);
         wakeUp();
         foreach (Worker * w, workers_) w->stopLoop();
     } else {
@@ -200,20 +409,74 @@ uint ThreadHolderWorkerPool::threadCount() const
     return 1 + workers_.size();
 }
 
+bool ThreadHolderWorkerPool::setCallQueueLimit(uint maxCalls, FifoFullPolicy policy)
+{
+    // The limit counts the calls of all lanes and threads together, since every
+    // thread may steal from every queue. The lanes themselves are unlimited.
+    maxCalls_.storeRelaxed(maxCalls);
+    policy_.storeRelease(policy);
+    if (waiting_.loadAcquire() > 0) {
+        QMutexLocker ml(&waitMutex_);
+        waitCond_.wakeAll();
+    }
+    return true;
+}
+
+bool ThreadHolderWorkerPool::reserveCall(bool ignoreLimit)
+{
+    forever {
+        const uint queued = queued_.loadAcquire();
+        const int policy = policy_.loadAcquire();
+        const uint max = ignoreLimit || policy == FifoGrow ? 0 : maxCalls_.loadRelaxed();
+        if (max == 0 || queued < max) {
+            if (queued_.testAndSetOrdered(queued, queued + 1)) return true;
+            continue;
+        }
+        if (policy == FifoReject) return false;
+        waitForSpace();
+        // a stopping pool does not take calls anymore
+        if (stopLoop_.loadAcquire()) ignoreLimit = true;
+    }
+}
+
+void ThreadHolderWorkerPool::waitForSpace()
+{
+    waiting_.fetchAndAddOrdered(1);
+    {
+        QMutexLocker ml(&waitMutex_);
+        while (policy_.loadAcquire() == FifoBlock && !stopLoop_.loadAcquire()) {
+            const uint max = maxCalls_.loadRelaxed();
+            if (max == 0 || queued_.loadAcquire() < max) break;
+            waitCond_.wait(&waitMutex_, 10);
+        }
+    }
+    waiting_.fetchAndAddOrdered(-1);
+}
+
+bool ThreadHolderWorkerPool::setAutoScaling(uint minThreads, double busyRatio, double maxWaitMsecs, double idleSecs)
+{
+    // Net pools may have io watchers in every thread, which must not be retired.
+    if (!isWorkerOnly() || workers_.isEmpty()) return false;
+
+    minThreads_.storeRelaxed(qBound(1u, minThreads, threadCount()));
+    busyRatio_.store(busyRatio, std::memory_order_relaxed);
+    maxWaitNsecs_.storeRelaxed((qint64)(maxWaitMsecs * 1000000));
+    idleSecs_.store(idleSecs, std::memory_order_relaxed);
+    lastLoadCheck_.storeRelaxed(monotonicNsecs());
+    autoScaling_.storeRelease(1);
+
+    // idle threads arm their retire timer when woken up
+    foreach (Worker * w, workers_) if (queues_[w->threadNo()]->running.loadAcquire()) w->wakeUp();
+    return true;
+}
+
 void ThreadHolderWorkerPool::wokeUp()
 {
-    if (stopLoop_) {
+    if (stopLoop_.loadAcquire()) {
         ThreadHolderLibEV::stopLoop();
         return;
     }
-
-    QElapsedTimer elapsed;
-    if (stats_) elapsed.start();
-    while (const Functor * func = externalCalls_.take()) {
-        (*func)();
-        delete func;
-    }
-    if (stats_) stats_->externNewCallTime(threadId_, elapsed.nsecsElapsed());
+    processCalls(0);
 }
 
 void ThreadHolderWorkerPool::run()
@@ -222,15 +485,207 @@ void ThreadHolderWorkerPool::run()
     foreach (Worker * w, workers_) w->wait();
 }
 
+void ThreadHolderWorkerPool::processCalls(uint threadNo)
+{
+    CallQueue & own = *queues_[threadNo];
+    own.parked.storeRelease(0);
+
+    ThreadHolderLibEV & thread = *own.thread;
+    const bool autoScaling = autoScaling_.loadAcquire();
+    qint64 busySince = 0;
+    if (autoScaling) {
+        busySince = monotonicNsecs();
+        own.busySince.storeRelaxed(busySince);
+    }
+    quint64 queueDepth;
+    forever {
+        const Functor * func = nextCall(threadNo, queueDepth);
+        if (!func) {
+            // Announce parking before looking a last time,
+            // so that either we see a new call or the caller sees us parked.
+            own.parked.fetchAndStoreOrdered(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            func = nextCall(threadNo, queueDepth);
+            if (!func) break;
+
+            // If this fails, a caller already claimed our wakeup.
+            // We just get woken up once more than needed.
+            own.parked.testAndSetOrdered(1, 0);
+        }
+        if (autoScaling) {
+            const qint64 now = monotonicNsecs();
+            checkLoad(now, now - func->queuedAt);
+        }
+        thread.execFunctor(func, queueDepth);
+    }
+    if (autoScaling) {
+        own.busySince.storeRelaxed(0);
+        counterAdd(own.busyNsecs, monotonicNsecs() - busySince);
+    }
+    if (ThreadCounters * counters = thread.counters()) {
+        for (uint lane = 0 ; lane < CallPriorityCount ; ++lane) {
+            counterAdd(counters->contention, own.calls[lane].takeContentionCount());
+            counterAdd(counters->overflows,  own.calls[lane].takeOverflowCount());
+        }
+    }
+}
+
+void ThreadHolderWorkerPool::checkLoad(qint64 now, qint64 waited)
+{
+    if (waited > maxWaitNsecs_.loadRelaxed()) {
+        growPool(now);
+        return;
+    }
+
+    // one thread measures the busy ratio of the last interval
+    const qint64 checkAt = nextLoadCheck_.loadRelaxed();
+    if (now < checkAt || !nextLoadCheck_.testAndSetRelaxed(checkAt, now + LoadCheckInterval)) return;
+
+    qint64 busy = 0;
+    foreach (CallQueue * q, queues_) {
+        busy += (qint64)q->busyNsecs.loadRelaxed();
+        const qint64 since = q->busySince.loadRelaxed();
+        if (since > 0 && since < now) busy += now - since;
+    }
+    const qint64 elapsed = now - lastLoadCheck_.loadRelaxed();
+    const double ratio = elapsed > 0 ? (double)(busy - lastBusyNsecs_.loadRelaxed()) / elapsed / activeThreads_.loadRelaxed() : 0;
+    lastLoadCheck_.storeRelaxed(now);
+    lastBusyNsecs_.storeRelaxed(busy);
+    if (ratio > busyRatio_.load(std::memory_order_relaxed)) growPool(now);
+}
+
+void ThreadHolderWorkerPool::growPool(qint64 now)
+{
+    const qint64 growAt = nextGrow_.loadRelaxed();
+    if (now < growAt || !nextGrow_.testAndSetRelaxed(growAt, now + GrowInterval)) return;
+    if (stopLoop_.loadAcquire()) return;
+
+    foreach (Worker * w, workers_) {
+        CallQueue & q = *queues_[w->threadNo()];
+        if (q.running.loadAcquire() == 0 && q.running.testAndSetOrdered(0, 1)) {
+            activeThreads_.fetchAndAddOrdered(1);
+            logDebug("auto scaling: starting thread %1", w->threadName);
+            w->restart();
+            return;
+        }
+    }
+}
+
+// called in thread threadNo after it has been idle for idleSecs_
+bool ThreadHolderWorkerPool::retireWorker(uint threadNo)
+{
+    if (stopLoop_.loadAcquire() || !autoScaling_.loadAcquire()) return false;
+    CallQueue & q = *queues_[threadNo];
+    if (q.thread->hasPendingWork() || !q.pinned.isEmpty()) return false;
+
+    int active = activeThreads_.loadRelaxed();
+    do {
+        if (active <= (int)minThreads_.loadRelaxed()) return false;
+    } while (!activeThreads_.testAndSetOrdered(active, active - 1, active));
+
+    // After this no caller hands calls to us anymore.
+    // Calls put into our queue are stolen by the other threads.
+    if (!q.parked.testAndSetOrdered(1, 0)) {
+        activeThreads_.fetchAndAddOrdered(1);
+        return false;
+    }
+    logDebug("auto scaling: retiring thread %1", q.thread->threadName);
+    return true;
+}
+
+const Functor * ThreadHolderWorkerPool::nextCall(uint threadNo, quint64 & queueDepth)
+{
+    CallQueue & own = *queues_[threadNo];
+    if (const Functor * func = own.pinned.take()) {
+        queueDepth = counters_ ? own.pinned.size() : 0;
+        return func;
+    }
+    const uint * order = LaneOrder[firstLane(++own.turn)];
+    for (uint i = 0 ; i < CallPriorityCount ; ++i) {
+        if (const Functor * func = takeCall(threadNo, order[i], queueDepth)) return func;
+    }
+    return 0;
+}
+
+const Functor * ThreadHolderWorkerPool::takeCall(uint threadNo, uint lane, quint64 & queueDepth)
+{
+    // own queue first, then steal from the others
+    const uint count = queues_.size();
+    for (uint i = 0 ; i < count ; ++i) {
+        ThreadFifo<const Functor *> & calls = queues_[(threadNo + i) % count]->calls[lane];
+        if (const Functor * func = calls.take()) {
+            queued_.fetchAndSubOrdered(1);
+            if (waiting_.loadAcquire() > 0) {
+                QMutexLocker ml(&waitMutex_);
+                waitCond_.wakeAll();
+            }
+            queueDepth = counters_ ? calls.size() : 0;
+            return func;
+        }
+    }
+    return 0;
+}
+
+class ThreadHolderWorkerPool::Worker::IdleTimer : public TimerWheel::Entry
+{
+public:
+    IdleTimer(Worker & worker) : worker_(worker) {}
+
+protected:
+    void expired() override
+    {
+        if (worker_.pool_.retireWorker(worker_.threadNo_)) worker_.ThreadHolderLibEV::stopLoop();
+    }
+
+private:
+    Worker & worker_;
+};
+
 ThreadHolderWorkerPool::Worker::Worker(const QString & threadName,
-    int threadId, ThreadStats * stats, uint threadNo, ThreadFifo<const Functor *> & externalCalls)
+    int threadId, ThreadStats * stats, uint threadNo, ThreadHolderWorkerPool & pool)
 :
     ThreadHolderLibEV(threadName, threadId, stats, true, false),
     threadNo_(threadNo),
-    externalCalls_(externalCalls),
-    stopLoop_(false)
+    pool_(pool),
+    stopLoop_(false),
+    idleTimer_(new IdleTimer(*this))
 {
+}
+
+ThreadHolderWorkerPool::Worker::~Worker()
+{
+    delete idleTimer_;
+}
+
+void ThreadHolderWorkerPool::Worker::restart()
+{
+    // previous run may not have returned yet
+    wait();
+    isActive_ = true;
     start();
+    wakeUp();
+}
+
+void ThreadHolderWorkerPool::Worker::run()
+{
+    CallQueue & q = *pool_.queues_[threadNo_];
+    forever {
+        ThreadHolderLibEV::run();
+        q.running.storeRelease(0);
+
+        // a pinned call may have arrived while retiring
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (stopLoop_ || q.pinned.isEmpty() || !q.running.testAndSetOrdered(0, 1)) break;
+        pool_.activeThreads_.fetchAndAddOrdered(1);
+        isActive_ = true;
+        wakeUp();
+    }
+}
+
+void ThreadHolderWorkerPool::Worker::execLater(const Functor * func) const
+{
+    if (func->priority == CallNormal) ThreadHolderLibEV::execLater(func);
+    else                              pool_.doCall(func, true);
 }
 
 void ThreadHolderWorkerPool::Worker::stopLoop()
@@ -245,11 +700,8 @@ void ThreadHolderWorkerPool::Worker::wokeUp()
         ThreadHolderLibEV::stopLoop();
         return;
     }
-
-    while (const Functor * func = externalCalls_.take()) {
-        (*func)();
-        delete func;
-    }
+    pool_.processCalls(threadNo_);
+    if (pool_.autoScaling_.loadAcquire()) timerWheel()->start(idleTimer_, pool_.idleSecs_.load(std::memory_order_relaxed));
 }
 
 }}}    // namespace
@@ -9,36 +9,31 @@
 
 #include <cflib/util/functor.h>
 #include <cflib/util/threadfifo.h>
+#include <cflib/util/impl/threadcounters.h>
+
+#include <atomic>
 
 struct ev_async;
 struct ev_loop;
+struct ev_timer;
 
 namespace cflib { namespace util {
 
 class ThreadStats;
+class TimerWheel;
 
 namespace impl {
 
-class ThreadHolderEvent : public QEvent
-{
-public:
-    ThreadHolderEvent(const Functor * func) :
-        QEvent(QEvent::User),
-        func(func)
-    {}
-
-    const Functor * func;
-};
+class ThreadHolderQt;
 
 class ThreadObject : public QObject
 {
 public:
-    ThreadObject(int threadId, ThreadStats * stats);
+    ThreadObject(ThreadHolderQt & thread);
     bool event(QEvent * event) override;
 
 private:
-    const int threadId_;
-    ThreadStats * const stats_;
+    ThreadHolderQt & thread_;
 };
 
 class ThreadHolder : public QThread
@@ -49,35 +44,78 @@ public:
 
     const QString threadName;
     bool isActive() const { return isActive_; }
-    virtual bool doCall(const Functor * func) = 0;
+    // returns false, if the call got rejected
+    virtual bool doCall(const Functor * func, bool ignoreLimit) = 0;
+    // like doCall, but never executed by another thread of a pool (no limit)
+    // returns false for stopped threads (func is not deleted)
+    virtual bool doThreadCall(const Functor * func) { return isActive_ && doCall(func, true); }
     virtual void stopLoop() = 0;
     virtual bool isOwnThread() const { return QThread::currentThread() == this || disabled_; }
     virtual uint threadCount() const { return 1; }
     virtual uint threadNo() const    { return 0; }
     virtual void execLater(const Functor * func) const = 0;
+    virtual bool setCallQueueLimit(uint maxCalls, FifoFullPolicy policy);
+    virtual bool setAutoScaling(uint minThreads, double busyRatio, double maxWaitMsecs, double idleSecs);
+    void setRejectCallback(const std::function<void()> & rejected) { rejected_ = rejected; }
+    void callRejected() const { if (rejected_) rejected_(); }
+
+    ThreadCounters * counters() const { return counters_; }
+
+    // called in own thread, deletes func
+    void execFunctor(const Functor * func, quint64 queueDepth)
+    {
+        if (!counters_) {
+            (*func)();
+            delete func;
+            return;
+        }
+        const qint64 queuedAt = func->queuedAt;
+        const CallPriority lane = func->priority;
+        const qint64 start = monotonicNsecs();
+        (*func)();
+        delete func;
+        counters_->recordCall(lane, queuedAt, start, monotonicNsecs(), queueDepth);
+    }
+
+protected:
+    void applyPlacement(const QString & loopType);
+    void markQueued(const Functor * func) const { if (counters_) func->queuedAt = monotonicNsecs(); }
 
 protected:
     const int threadId_;
     ThreadStats * const stats_;
+    ThreadCounters * const counters_;
     const bool disabled_;
     bool isActive_;
+    std::function<void()> rejected_;
 };
 
 class ThreadHolderQt : public ThreadHolder
 {
 public:
     ThreadHolderQt(const QString & threadName, int threadId, ThreadStats * stats, bool disable);
+    ~ThreadHolderQt();
 
     ThreadObject * threadObject() const { return threadObject_; }
-    bool doCall(const Functor * func) override;
+    bool doCall(const Functor * func, bool ignoreLimit) override;
     void stopLoop() override;
     void execLater(const Functor * func) const override;
+    bool setCallQueueLimit(uint maxCalls, FifoFullPolicy policy) override;
 
 protected:
     void run() override;
 
+private:
+    bool queueCall(const Functor * func, bool ignoreLimit);
+    void processCalls();
+
 private:
     ThreadObject * threadObject_;
+    // Calls are queued here and one posted event executes all calls queued so far.
+    ThreadFifo<const Functor *> calls_[CallPriorityCount];
+    QAtomicInt eventPosted_;
+    uint turn_;    // only used by own thread
+    friend class ThreadObject;
 };
 
 class ThreadHolderLibEV : public ThreadHolder
@@ -88,7 +126,11 @@ public:
     void stopLoop() override;
     void execLater(const Functor * func) const override;
     ev_loop * loop() const { return loop_; }
+    bool isWorkerOnly() const { return isWorkerOnly_; }
     void wakeUp();
+    // only called from own thread
+    TimerWheel * timerWheel();
+    bool hasPendingWork() const;
 
 protected:
     ThreadHolderLibEV(const QString & threadName, int threadId, ThreadStats * stats, bool isWorkerOnly, bool disable);
@@ -97,11 +139,16 @@ protected:
 
 private:
     static void asyncCallback(ev_loop * loop, ev_async * w, int revents);
-    static void execLaterCall(int revents, void * arg);
+    static void execLaterCall(ev_loop * loop, ev_timer * w, int revents);
 
 private:
+    const bool isWorkerOnly_;
     ev_loop * loop_;
     ev_async * wakeupWatcher_;
+    ev_timer * laterWatcher_;
+    TimerWheel * timerWheel_;
+    mutable QVector<const Functor *> laterCalls_;
+    QVector<const Functor *> runningLaterCalls_;
 };
 
 class ThreadHolderWorkerPool : public ThreadHolderLibEV
@@ -110,38 +157,97 @@ public:
     ThreadHolderWorkerPool(const QString & threadName, int threadId, ThreadStats * stats, bool isWorkerOnly, uint threadCount);
     ~ThreadHolderWorkerPool();
 
-    bool doCall(const Functor * func) override;
+    bool doCall(const Functor * func, bool ignoreLimit) override;
+    bool doThreadCall(const Functor * func) override;
+    void execLater(const Functor * func) const override;
     void stopLoop() override;
     bool isOwnThread() const override;
     uint threadCount() const override;
+    bool setCallQueueLimit(uint maxCalls, FifoFullPolicy policy) override;
+    bool setAutoScaling(uint minThreads, double busyRatio, double maxWaitMsecs, double idleSecs) override;
 
 protected:
     void run() override;
     void wokeUp() override;
 
 private:
+    struct CallQueue
+    {
+        CallQueue(ThreadHolderLibEV * thread) :
+            thread(thread), parked(1), running(1), busyNsecs(0), busySince(0), turn(0) {}
+        ThreadHolderLibEV * const thread;
+        ThreadFifo<const Functor *> calls[CallPriorityCount];    // one lane per priority
+        ThreadFifo<const Functor *> pinned;   // calls for this thread only (never stolen)
+        QAtomicInt parked;    // thread waits for wakeUp
+        QAtomicInt running;   // 0 if the thread got retired by auto scaling
+        QAtomicInteger<quint64> busyNsecs;   // only with auto scaling
+        QAtomicInteger<qint64> busySince;
+        uint turn;            // only used by owning thread
+    };
+
     class Worker : public ThreadHolderLibEV
     {
     public:
         Worker(const QString & threadName,
-            int threadId, ThreadStats * stats, uint threadNo, ThreadFifo<const Functor *> & externalCalls);
+            int threadId, ThreadStats * stats, uint threadNo, ThreadHolderWorkerPool & pool);
+
+        ~Worker();
 
-        bool doCall(const Functor *) override { return false; }
+        bool doCall(const Functor * func, bool ignoreLimit) override { return pool_.doCall(func, ignoreLimit); }
+        bool doThreadCall(const Functor * func) override { return pool_.callThread(threadNo_, func); }
+        void execLater(const Functor * func) const override;
         void stopLoop() override;
         uint threadNo() const override { return threadNo_; }
+        void restart();
 
     protected:
+        void run() override;
         void wokeUp() override;
 
     private:
+        class IdleTimer;
         const uint threadNo_;
-        ThreadFifo<const Functor *> & externalCalls_;
+        ThreadHolderWorkerPool & pool_;
         bool stopLoop_;
+        IdleTimer * idleTimer_;
     };
 
-    ThreadFifo<const Functor *> externalCalls_;
+    bool callThread(uint threadNo, const Functor * func);
+    void processCalls(uint threadNo);
+    void checkLoad(qint64 now, qint64 waited);
+    void growPool(qint64 now);
+    bool retireWorker(uint threadNo);
+    const Functor * nextCall(uint threadNo, quint64 & queueDepth);
+    const Functor * takeCall(uint threadNo, uint lane, quint64 & queueDepth);
+    bool reserveCall(bool ignoreLimit);
+    void waitForSpace();
+
+    // one queue per thread (index is threadNo)
+    QVector<CallQueue *> queues_;
     QList<Worker *> workers_;
-    bool stopLoop_;
+    QAtomicInteger<uint> nextQueue_;
+    QAtomicInt stopLoop_;    // read by callers of callThread
+
+    // call queue limit for the whole pool (lanes of all threads, pinned calls are not counted)
+    QAtomicInteger<uint> queued_;
+    QAtomicInteger<uint> maxCalls_;
+    QAtomicInt policy_;
+    QAtomicInt waiting_;
+    QMutex waitMutex_;
+    QWaitCondition waitCond_;
+
+    // auto scaling (threadCount is the maximum, threads keep their threadNo)
+    QAtomicInt autoScaling_;
+    // config may be changed by setAutoScaling while pool threads read it
+    QAtomicInteger<uint> minThreads_;
+    std::atomic<double> busyRatio_;
+    QAtomicInteger<qint64> maxWaitNsecs_;
+    std::atomic<double> idleSecs_;
+    QAtomicInt activeThreads_;
+    QAtomicInteger<qint64> nextLoadCheck_;
+    QAtomicInteger<qint64> nextGrow_;
+    QAtomicInteger<qint64> lastLoadCheck_;    // written by the thread doing the load check
+    QAtomicInteger<qint64> lastBusyNsecs_;
 };
 
 }}}    // namespace
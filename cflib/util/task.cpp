@@ -0,0 +1,31 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include "task.h"
+
+namespace cflib { namespace util { namespace impl {
+
+void resumeOnThread(QThread * thread, std::coroutine_handle<> handle)
+{
+    ThreadHolder * holder = dynamic_cast<ThreadHolder *>(thread);
+    if (holder) {
+        // same thread, not any thread of a pool (retired pool threads get restarted)
+        const Functor * func = new StdFunctor([handle]() { handle.resume(); });
+        if (holder->doThreadCall(func)) return;
+        delete func;
+    }
+
+    // main thread without ThreadVerify
+    QCoreApplication * app = QCoreApplication::instance();
+    if (!holder && app && app->thread() == thread &&
+        QMetaObject::invokeMethod(app, [handle]() { handle.resume(); }, Qt::QueuedConnection)) return;
+
+    // no event loop to return to
+    handle.resume();
+}
+
+}}}    // namespace
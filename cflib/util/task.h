@@ -0,0 +1,227 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include <cflib/util/threadverify.h>
+
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// C++20 coroutines on top of ThreadVerify
+//
+// Task<T> is a lazily started coroutine. It runs when awaited by another task or when start() is called.
+// onThread(obj, &C::method, args...) calls method on the thread of obj (which must derive publicly
+// from ThreadVerify) and resumes the awaiting coroutine on its own thread when the result is ready.
+// The calling thread is not blocked in the meantime.
+// If the calling thread has no event loop (neither ThreadVerify nor main thread), the coroutine
+// continues in the called thread.
+// Exceptions of the called method are rethrown in the coroutine. If the call cannot be queued
+// (terminated thread, full queue), co_await throws ThreadCallDropped.
+//
+// example:
+//   Task<int> Service::loadCount(int id)
+//   {
+//       const QByteArray data = co_await onThread(db_, &DB::load, id);
+//       co_await onThread(kafka_, &Kafka::produce, data);
+//       co_return data.size();
+//   }
+//   ...
+//   loadCount(42).start();
+
+namespace cflib { namespace util {
+
+template<typename T = void> class Task;
+
+namespace impl {
+
+class TaskPromiseBase
+{
+public:
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+
+        template<typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept
+        {
+            TaskPromiseBase & promise = handle.promise();
+            if (promise.continuation_) return promise.continuation_;
+            if (promise.detached_) handle.destroy();
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+public:
+    TaskPromiseBase() : detached_(false) {}
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() { exception_ = std::current_exception(); }
+
+    void setContinuation(std::coroutine_handle<> continuation) { continuation_ = continuation; }
+    void setDetached() { detached_ = true; }
+
+protected:
+    void rethrow() const { if (exception_) std::rethrow_exception(exception_); }
+
+private:
+    std::coroutine_handle<> continuation_;
+    std::exception_ptr exception_;
+    bool detached_;
+};
+
+template<typename T>
+class TaskPromise : public TaskPromiseBase
+{
+public:
+    Task<T> get_return_object();
+    void return_value(T value) { value_ = std::move(value); }
+    T result() { rethrow(); return std::move(value_); }
+
+private:
+    T value_;
+};
+
+template<>
+class TaskPromise<void> : public TaskPromiseBase
+{
+public:
+    Task<void> get_return_object();
+    void return_void() {}
+    void result() { rethrow(); }
+};
+
+void resumeOnThread(QThread * thread, std::coroutine_handle<> handle);
+
+}
+
+template<typename T>
+class Task
+{
+    Q_DISABLE_COPY(Task)
+public:
+    typedef impl::TaskPromise<T> promise_type;
+
+public:
+    Task(Task && other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    ~Task() { if (handle_) handle_.destroy(); }
+
+    // runs the task without awaiting it
+    // The coroutine frame deletes itself when finished.
+    void start() &&
+    {
+        std::coroutine_handle<promise_type> handle = std::exchange(handle_, {});
+        handle.promise().setDetached();
+        handle.resume();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+    {
+        handle_.promise().setContinuation(continuation);
+        return handle_;
+    }
+
+    T await_resume() { return handle_.promise().result(); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    friend class impl::TaskPromise<T>;
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template<typename T>
+inline Task<T> impl::TaskPromise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> impl::TaskPromise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// ----------------------------------------------------------------------------
+
+class ThreadCallDropped : public std::runtime_error
+{
+public:
+    ThreadCallDropped() : std::runtime_error("thread call dropped") {}
+};
+
+template<typename R>
+class ThreadCallAwaiter
+{
+public:
+    ThreadCallAwaiter(const ThreadVerify * tv, std::function<R()> && call) :
+        tv_(tv), call_(std::move(call)), done_(false) {}
+
+    bool await_ready() const { return tv_->verifyThread_->isOwnThread(); }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        QThread * caller = QThread::currentThread();
+        const bool queued = tv_->execCall(new StdFunctor([this, caller, handle]() {
+            try {
+                run();
+            } catch (...) {
+                exception_ = std::current_exception();
+            }
+            impl::resumeOnThread(caller, handle);
+        }), true);
+        if (queued) return true;
+
+        // functor has been deleted, continue at once
+        exception_ = std::make_exception_ptr(ThreadCallDropped());
+        return false;
+    }
+
+    R await_resume()
+    {
+        if (exception_) std::rethrow_exception(exception_);
+        if (!done_) run();
+        if constexpr (!std::is_void_v<R>) return std::move(result_);
+    }
+
+private:
+    void run()
+    {
+        if constexpr (std::is_void_v<R>) call_();
+        else                             result_ = call_();
+        done_ = true;
+    }
+
+private:
+    const ThreadVerify * tv_;
+    std::function<R()> call_;
+    std::conditional_t<std::is_void_v<R>, bool, R> result_;
+    std::exception_ptr exception_;
+    bool done_;
+};
+
+template<typename C, typename R, typename... P, typename... A>
+inline ThreadCallAwaiter<R> onThread(C * obj, R (C::*f)(P...), A &&... args)
+{
+    return ThreadCallAwaiter<R>(obj, [obj, f, ...args = std::forward<A>(args)]() -> R { return (obj->*f)(args...); });
+}
+
+template<typename C, typename R, typename... P, typename... A>
+inline ThreadCallAwaiter<R> onThread(const C * obj, R (C::*f)(P...) const, A &&... args)
+{
+    return ThreadCallAwaiter<R>(obj, [obj, f, ...args = std::forward<A>(args)]() -> R { return (obj->*f)(args...); });
+}
+
+}}    // namespace
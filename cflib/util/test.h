@@ -15,6 +15,11 @@
         Q_CONSTRUCTOR_FUNCTION(cflib_util_test_add_##Class) \
     }
 
+// Benchmarks are skipped unless CFLIB_BENCHMARK is set, e.g.:
+// CFLIB_BENCHMARK=1 ./net_test TLSBenchmark_Test
+#define BENCHMARK_ONLY() \
+    if (!qEnvironmentVariableIsSet("CFLIB_BENCHMARK")) QSKIP("benchmark, set CFLIB_BENCHMARK=1 to run")
+
 namespace cflib { namespace util {
 
 void addTest(QObject * test);
@@ -11,44 +11,250 @@
 
 // Threadsafe Fifo
 // put and take from multiple threads possible
+//
+// Lock free segmented queue:
+// - Entries live in segments of segmentSize slots. Each slot carries a sequence number,
+//   so put and take only need one compare and swap on the write resp. read position.
+// - Fully consumed segments get recycled at the end of the queue. Memory is bounded by
+//   the peak queue length and never freed before destruction.
+// - The segment list itself is only changed once per segment under a mutex.
 
 namespace cflib { namespace util {
 
+// behaviour of put, if maxSize entries are queued
+enum FifoFullPolicy {
+    FifoGrow   = 0,    // ignore maxSize
+    FifoBlock  = 1,    // wait until some entry got taken
+    FifoReject = 2     // return false
+};
+
 template<typename T>
 class ThreadFifo
 {
     Q_DISABLE_COPY(ThreadFifo)
 public:
-    ThreadFifo(int size) : max_(size), buffer_(new T[size]), count_(0), reader_(0), writer_(0) {}
-    ~ThreadFifo() { delete[] buffer_; }
+    // maxSize == 0 means unlimited
+    ThreadFifo(uint maxSize = 0, FifoFullPolicy policy = FifoReject, uint segmentSize = 0x100) :
+        segSize_(segmentSize > 1 ? segmentSize : 2),
+        maxSize_(maxSize), policy_(policy),
+        writer_(0), reader_(0),
+        tail_(new Segment(segSize_, 0)),
+        waiting_(0)
+    {
+        head_.storeRelaxed(tail_);
+        writeSeg_.storeRelaxed(tail_);
+        readSeg_.storeRelaxed(tail_);
+    }
+
+    ~ThreadFifo()
+    {
+        Segment * seg = head_.loadRelaxed();
+        while (seg) {
+            Segment * next = seg->next.loadRelaxed();
+            delete seg;
+            seg = next;
+        }
+    }
+
+    void setLimit(uint maxSize, FifoFullPolicy policy)
+    {
+        maxSize_.storeRelaxed(maxSize);
+        policy_.storeRelease(policy);
+        if (waiting_.loadAcquire() > 0) wakeWaiting();
+    }
+
+    // returns false only with policy FifoReject
+    inline bool put(T data, bool ignoreLimit = false)
+    {
+        forever {
+            // reader first: reader_ <= writer_ always holds, so pos - read cannot underflow
+            const quint64 read = reader_.loadAcquire();
+            const quint64 pos = writer_.loadAcquire();
+
+            // full?
+            const uint max = ignoreLimit ? 0 : maxSize_.loadRelaxed();
+            if (max > 0 && pos - read >= max) {
+                const FifoFullPolicy policy = (FifoFullPolicy)policy_.loadAcquire();
+                if (policy == FifoReject) {
+                    overflows_.fetchAndAddRelaxed(1);
+                    return false;
+                }
+                if (policy == FifoBlock) {
+                    overflows_.fetchAndAddRelaxed(1);
+                    waitForSpace();
+                    continue;
+                }
+            }
+
+            Segment * seg = writeSeg_.loadAcquire();
+            Cell * cell = findCell(seg, pos, true);
+            if (!cell) continue;
+
+            if (cell->seq.loadAcquire() != pos || !writer_.testAndSetOrdered(pos, pos + 1)) {
+                contention_.fetchAndAddRelaxed(1);
+                continue;
+            }
+            cell->data = data;
+            cell->seq.storeRelease(pos + 1);
+            if (writeSeg_.loadRelaxed() != seg) writeSeg_.storeRelease(seg);
+            return true;
+        }
+    }
+
+    // returns T() if empty
+    inline T take()
+    {
+        uint spins = 0;
+        forever {
+            const quint64 pos = reader_.loadAcquire();
+            if (pos >= writer_.loadAcquire()) return T();
+
+            Segment * seg = readSeg_.loadAcquire();
+            Cell * cell = findCell(seg, pos, false);
+            if (!cell) continue;
+
+            const quint64 seq = cell->seq.loadAcquire();
+            if (seq == pos) {
+                // a writer got the slot but did not publish its data yet
+                contention_.fetchAndAddRelaxed(1);
+                if (++spins > 16) QThread::yieldCurrentThread();
+                continue;
+            }
+            if (seq != pos + 1 || !reader_.testAndSetOrdered(pos, pos + 1)) {
+                contention_.fetchAndAddRelaxed(1);
+                continue;
+            }
+            T rv = cell->data;
+            cell->data = T();
+            if (readSeg_.loadRelaxed() != seg) readSeg_.storeRelease(seg);
+            if ((uint)seg->consumed.fetchAndAddOrdered(1) + 1 == segSize_) recycle();
+            if (waiting_.loadAcquire() > 0) wakeWaiting();
+            return rv;
+        }
+    }
+
+    quint64 size() const
+    {
+        const quint64 r = reader_.loadAcquire();
+        const quint64 w = writer_.loadAcquire();
+        return w > r ? w - r : 0;
+    }
+    bool isEmpty() const { return size() == 0; }
+
+    // statistics since last call
+    quint64 takeContentionCount() { return contention_.fetchAndStoreRelaxed(0); }
+    quint64 takeOverflowCount()   { return overflows_.fetchAndStoreRelaxed(0); }
+
+private:
+    struct Cell
+    {
+        QAtomicInteger<quint64> seq;
+        T data;
+    };
+
+    struct Segment
+    {
+        Segment(uint size, quint64 firstPos) : cells(new Cell[size]) { init(size, firstPos); }
+        ~Segment() { delete[] cells; }
+
+        // Readers with an outdated pointer detect reuse by the sequence numbers.
+        void init(uint size, quint64 firstPos)
+        {
+            next.storeRelaxed(0);
+            consumed.storeRelaxed(0);
+            for (uint i = 0 ; i < size ; ++i) cells[i].seq.storeRelaxed(firstPos + i);
+            first.storeRelease(firstPos);
+        }
+
+        Cell * const cells;
+        QAtomicInteger<quint64> first;
+        QAtomicInteger<uint> consumed;
+        QAtomicPointer<Segment> next;
+    };
+
+private:
+    // starts searching at seg and returns the slot for pos
+    // returns 0 if pos is outdated or the segment had to be appended
+    Cell * findCell(Segment *& seg, quint64 pos, bool append)
+    {
+        if (pos < seg->first.loadAcquire()) seg = head_.loadAcquire();
+        forever {
+            const quint64 first = seg->first.loadAcquire();
+            if (pos < first) return 0;
+            if (pos - first < segSize_) return seg->cells + (pos - first);
+            Segment * next = seg->next.loadAcquire();
+            if (!next) {
+                if (!append) return 0;
+                appendSegments(pos);
+                return 0;
+            }
+            seg = next;
+        }
+    }
+
+    void appendSegments(quint64 pos)
+    {
+        QMutexLocker ml(&segMutex_);
+        while (tail_->first.loadRelaxed() + segSize_ <= pos) {
+            Segment * seg = new Segment(segSize_, tail_->first.loadRelaxed() + segSize_);
+            tail_->next.storeRelease(seg);
+            tail_ = seg;
+        }
+    }
+
+    void recycle()
+    {
+        QMutexLocker ml(&segMutex_);
+        forever {
+            Segment * seg = head_.loadRelaxed();
+            if ((uint)seg->consumed.loadAcquire() != segSize_) return;
+            if (seg == tail_) {
+                seg->init(segSize_, seg->first.loadRelaxed() + segSize_);
+                return;
+            }
+            head_.storeRelease(seg->next.loadRelaxed());
+            seg->init(segSize_, tail_->first.loadRelaxed() + segSize_);
+            tail_->next.storeRelease(seg);
+            tail_ = seg;
+        }
+    }
 
-    inline bool put(T data) {
-        while (!sl_.testAndSetAcquire(0, 1));
-        if (count_ == max_) { sl_.storeRelease(0); return false; }
-        ++count_;
-        buffer_[writer_] = data;
-        writer_ = (writer_ + 1) % max_;
-        sl_.storeRelease(0);
-        return true;
+    void waitForSpace()
+    {
+        waiting_.fetchAndAddOrdered(1);
+        {
+            QMutexLocker ml(&waitMutex_);
+            while (policy_.loadAcquire() == FifoBlock) {
+                const uint max = maxSize_.loadRelaxed();
+                if (max == 0 || writer_.loadAcquire() - reader_.loadAcquire() < max) break;
+                waitCond_.wait(&waitMutex_, 10);
+            }
+        }
+        waiting_.fetchAndAddOrdered(-1);
     }
 
-    inline T take() {
-        while (!sl_.testAndSetAcquire(0, 1));
-        if (count_ == 0) { sl_.storeRelease(0); return T(); }
-        --count_;
-        T rv = buffer_[reader_];
-        reader_ = (reader_ + 1) % max_;
-        sl_.storeRelease(0);
-        return rv;
+    void wakeWaiting()
+    {
+        QMutexLocker ml(&waitMutex_);
+        waitCond_.wakeAll();
     }
 
 private:
-    const int max_;
-    T * buffer_;
-    int count_;
-    int reader_;
-    int writer_;
-    QAtomicInt sl_;
+    const uint segSize_;
+    QAtomicInteger<uint> maxSize_;
+    QAtomicInt policy_;
+    alignas(64) QAtomicInteger<quint64> writer_;
+    alignas(64) QAtomicInteger<quint64> reader_;
+    alignas(64) QAtomicPointer<Segment> writeSeg_;
+    QAtomicPointer<Segment> readSeg_;
+    QAtomicPointer<Segment> head_;
+    Segment * tail_;
+    QMutex segMutex_;
+    QAtomicInteger<quint64> contention_;
+    QAtomicInteger<quint64> overflows_;
+    QAtomicInt waiting_;
+    QMutex waitMutex_;
+    QWaitCondition waitCond_;
 };
 
 }}    // namespace
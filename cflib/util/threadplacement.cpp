@@ -0,0 +1,203 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include "threadplacement.h"
+
+#include <cflib/util/log.h>
+
+#ifdef Q_OS_LINUX
+    #include <errno.h>
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+USE_LOG(LogCat::Etc)
+
+namespace cflib { namespace util {
+
+namespace {
+
+struct Rule
+{
+    QList<int> cpus;
+    int node;
+    int fifoPrio;
+
+    Rule() : node(-1), fifoPrio(0) {}
+};
+typedef QHash<QString, Rule> Rules;
+
+bool parseCpuList(const QString & str, const QChar & sep, QList<int> & cpus)
+{
+    for (const QString & part : str.split(sep, Qt::SkipEmptyParts)) {
+        const int pos = part.indexOf('-');
+        bool ok1;
+        bool ok2 = true;
+        const int from = part.left(pos).trimmed().toInt(&ok1);
+        const int to   = pos == -1 ? from : part.mid(pos + 1).trimmed().toInt(&ok2);
+        if (!ok1 || !ok2 || from < 0 || to < from) return false;
+        for (int cpu = from ; cpu <= to ; ++cpu) cpus << cpu;
+    }
+    return true;
+}
+
+bool parseRules(const QString & str, Rules & rules)
+{
+    for (const QString & ruleStr : str.split(';', Qt::SkipEmptyParts)) {
+        const int pos = ruleStr.indexOf(':');
+        const QString selector = ruleStr.left(pos).trimmed();
+        if (pos == -1 || selector.isEmpty()) return false;
+
+        Rule rule;
+        for (const QString & option : ruleStr.mid(pos + 1).split(',', Qt::SkipEmptyParts)) {
+            const QString key   = option.section('=', 0, 0).trimmed();
+            const QString value = option.section('=', 1).trimmed();
+            bool ok = true;
+            if      (key == "cpus") ok = parseCpuList(value, '|', rule.cpus) && !rule.cpus.isEmpty();
+            else if (key == "node") rule.node     = value.toInt(&ok);
+            else if (key == "fifo") rule.fifoPrio = value.toInt(&ok);
+            else                    ok = false;
+            if (!ok || rule.node < -1 || rule.fifoPrio < 0) return false;
+        }
+        rules[selector] = rule;
+    }
+    return true;
+}
+
+class Placement
+{
+public:
+    Placement()
+    {
+        const QString env = QString::fromLocal8Bit(qgetenv("CFLIB_THREAD_PLACEMENT"));
+        if (!env.isEmpty() && !parseRules(env, rules_)) {
+            rules_.clear();
+            logWarn("invalid CFLIB_THREAD_PLACEMENT: %1", env);
+        }
+    }
+
+    bool set(const QString & str)
+    {
+        Rules rules;
+        if (!parseRules(str, rules)) return false;
+        QMutexLocker ml(&mutex_);
+        rules_ = rules;
+        return true;
+    }
+
+    bool find(const QString & threadName, const QString & loopType, Rule & rule) const
+    {
+        QMutexLocker ml(&mutex_);
+        Rules::const_iterator it = rules_.constFind(threadName);
+        if (it == rules_.constEnd()) it = rules_.constFind('@' + loopType);
+        if (it == rules_.constEnd()) return false;
+        rule = *it;
+        return true;
+    }
+
+private:
+    mutable QMutex mutex_;
+    Rules rules_;
+};
+
+Q_GLOBAL_STATIC(Placement, placement)
+
+#ifdef Q_OS_LINUX
+
+const int MPOL_PREFERRED_ = 1;
+
+QList<int> nodeCpus(int node)
+{
+    QFile file(QString("/sys/devices/system/node/node%1/cpulist").arg(node));
+    QList<int> cpus;
+    if (!file.open(QIODevice::ReadOnly) || !parseCpuList(QString::fromLatin1(file.readAll()).trimmed(), ',', cpus)) {
+        cpus.clear();
+    }
+    return cpus;
+}
+
+QString cpuListString(const QList<int> & cpus)
+{
+    QStringList rv;
+    for (int cpu : cpus) rv << QString::number(cpu);
+    return rv.join('|');
+}
+
+#endif
+
+}
+
+bool setThreadPlacement(const QString & rules)
+{
+    if (placement()->set(rules)) return true;
+    logWarn("invalid thread placement: %1", rules);
+    return false;
+}
+
+namespace impl {
+
+QString applyThreadPlacement(const QString & threadName, const QString & loopType)
+{
+    // threads of a pool are named "<name> <no>/<count>"
+    static const QRegularExpression poolRE(" (\\d+)/\\d+$");
+    const QRegularExpressionMatch match = poolRE.match(threadName);
+    const QString name = match.hasMatch() ? threadName.left(match.capturedStart()) : threadName;
+    const int threadNo = match.hasMatch() ? match.captured(1).toInt() - 1 : -1;
+
+    Rule rule;
+    if (!placement()->find(name, loopType, rule)) return QString();
+
+#ifdef Q_OS_LINUX
+    QStringList desc;
+
+    QList<int> cpus = rule.cpus;
+    if (rule.node >= 0) {
+        if (cpus.isEmpty()) cpus = nodeCpus(rule.node);
+        if (cpus.isEmpty()) logWarn("no cpus found for NUMA node %1 (thread %2)", rule.node, threadName);
+
+        unsigned long nodeMask[16] = {};
+        const uint bits = sizeof(unsigned long) * 8;
+        if ((uint)rule.node < sizeof(nodeMask) * 8) nodeMask[rule.node / bits] = 1UL << (rule.node % bits);
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED_, nodeMask, sizeof(nodeMask) * 8) == 0) {
+            desc << QString("node %1").arg(rule.node);
+        } else {
+            logWarn("cannot set memory policy of thread %1 to node %2 (errno: %3)", threadName, rule.node, errno);
+        }
+    }
+
+    if (!cpus.isEmpty()) {
+        if (threadNo >= 0 && !rule.cpus.isEmpty()) cpus = QList<int>() << cpus[threadNo % cpus.size()];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err == 0) desc << "cpus " + cpuListString(cpus);
+        else          logWarn("cannot set affinity of thread %1 to cpus %2 (errno: %3)", threadName, cpuListString(cpus), err);
+    }
+
+    if (rule.fifoPrio > 0) {
+        sched_param param;
+        param.sched_priority = rule.fifoPrio;
+        const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err == 0) desc << QString("fifo %1").arg(rule.fifoPrio);
+        else          logWarn("cannot set SCHED_FIFO for thread %1 (errno: %2)", threadName, err);
+    }
+
+    const QString rv = desc.join(", ");
+    if (!rv.isEmpty()) logInfo("thread %1 placed on %2", threadName, rv);
+    return rv;
+#else
+    logWarn("thread placement not supported on this platform (thread %1)", threadName);
+    return QString();
+#endif
+}
+
+}
+
+}}    // namespace
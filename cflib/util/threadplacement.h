@@ -0,0 +1,42 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include <QtCore>
+
+// Placement of ThreadVerify threads on cores and NUMA nodes (Linux only)
+//
+// rules: "<selector>:<option>[,<option>...][;<selector>:...]"
+// selector:
+//   thread name (threads of a pool are matched without their " 2/4" suffix)
+//   or loop type: @qt, @net, @worker
+// options:
+//   cpus=2|4-7  pins the thread to these cores (separated by '|'),
+//               threads of a pool get one core each (round robin)
+//   node=1      runs the thread on the cores of NUMA node 1 and prefers its memory for allocations
+//   fifo=10     SCHED_FIFO with priority 10 (needs CAP_SYS_NICE)
+// Name rules take precedence over loop type rules.
+//
+// example: CFLIB_THREAD_PLACEMENT="TCPManager:cpus=2,fifo=10;@worker:node=1"
+
+namespace cflib { namespace util {
+
+// Initial rules are read from environment variable CFLIB_THREAD_PLACEMENT.
+// New rules replace all previous rules and apply to threads started afterwards.
+// Returns false on syntax errors (old rules stay active).
+bool setThreadPlacement(const QString & rules);
+
+namespace impl {
+
+// applies matching rule to current thread
+// returns a description of the placement (empty if no rule matched)
+QString applyThreadPlacement(const QString & threadName, const QString & loopType);
+
+}
+
+}}    // namespace
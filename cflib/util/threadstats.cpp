@@ -0,0 +1,207 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include "threadstats.h"
+
+#include <cflib/util/util.h>
+
+#include <cmath>
+
+namespace cflib { namespace util {
+
+namespace {
+
+const double Percentiles[] = { 50, 90, 99, 99.9 };
+const char * const LaneNames[CallPriorityCount] = { "critical", "normal", "bulk" };
+
+QJsonObject histogramToJson(const ThreadStats::Histogram & hist)
+{
+    QJsonObject rv;
+    rv["count"] = (qint64)hist.count();
+    for (double p : Percentiles) rv[QString("p%1").arg(p)] = (qint64)hist.percentile(p);
+    rv["max"] = (qint64)hist.max();
+
+    // sparse buckets: [upper bound, count]
+    QJsonArray buckets;
+    for (int i = 0 ; i < hist.counts.size() ; ++i) {
+        if (hist.counts[i] > 0) buckets << QJsonArray({ (qint64)ThreadStats::Histogram::bucketUpperBound(i), (qint64)hist.counts[i] });
+    }
+    rv["buckets"] = buckets;
+    return rv;
+}
+
+QByteArray promLabel(const QString & str)
+{
+    QByteArray rv = str.toUtf8();
+    rv.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return rv;
+}
+
+void promSummary(QByteArray & out, const char * name, const char * help, const ThreadStats::Snapshot & snapshot,
+    std::function<const ThreadStats::Histogram & (const ThreadStats::ThreadSnapshot &)> hist,
+    std::function<quint64 (const ThreadStats::ThreadSnapshot &)> sum, double scale)
+{
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " summary\n";
+    for (const ThreadStats::ThreadSnapshot & ts : snapshot) {
+        const QByteArray thread = promLabel(ts.name);
+        const ThreadStats::Histogram & h = hist(ts);
+        for (double p : Percentiles) {
+            out << name << "{thread=\"" << thread << "\",quantile=\"" << QByteArray::number(p / 100) << "\"} "
+                << QByteArray::number(h.percentile(p) * scale) << '\n';
+        }
+        if (sum) out << name << "_sum{thread=\"" << thread << "\"} " << QByteArray::number(sum(ts) * scale) << '\n';
+        out << name << "_count{thread=\"" << thread << "\"} " << QByteArray::number(h.count()) << '\n';
+    }
+}
+
+void promCounter(QByteArray & out, const char * name, const char * type, const char * help, const ThreadStats::Snapshot & snapshot,
+    std::function<QByteArray (const ThreadStats::ThreadSnapshot &)> value)
+{
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+    for (const ThreadStats::ThreadSnapshot & ts : snapshot) {
+        out << name << "{thread=\"" << promLabel(ts.name) << "\"} " << value(ts) << '\n';
+    }
+}
+
+}
+
+quint64 ThreadStats::Histogram::count() const
+{
+    quint64 rv = 0;
+    for (quint64 c : counts) rv += c;
+    return rv;
+}
+
+quint64 ThreadStats::Histogram::percentile(double p) const
+{
+    const quint64 total = count();
+    if (total == 0) return 0;
+    quint64 rank = (quint64)std::ceil(total * p / 100);
+    if (rank == 0) rank = 1;
+    quint64 sum = 0;
+    for (int i = 0 ; i < counts.size() ; ++i) {
+        sum += counts[i];
+        if (sum >= rank) return bucketUpperBound(i);
+    }
+    return bucketUpperBound(counts.size() - 1);
+}
+
+quint64 ThreadStats::Histogram::bucketUpperBound(uint bucket)
+{
+    if (bucket + 1 >= impl::AtomicHistogram::BucketCount) return Q_UINT64_C(0xFFFFFFFFFFFFFFFF);
+    return impl::AtomicHistogram::lowerBound(bucket + 1) - 1;
+}
+
+ThreadStats::Snapshot ThreadStats::snapshot() const
+{
+    QList<impl::ThreadCounters *> counters;
+    {
+        QMutexLocker ml(&countersMutex_);
+        counters = counters_;
+    }
+
+    Snapshot rv;
+    rv.reserve(counters.size());
+    for (const impl::ThreadCounters * c : counters) {
+        ThreadSnapshot ts;
+        ts.name          = c->threadName;
+        ts.threadId      = c->threadId;
+        ts.calls         = c->calls.loadRelaxed();
+        ts.busyNsecs     = c->busyNsecs.loadRelaxed();
+        ts.waitNsecs     = c->waitNsecs.loadRelaxed();
+        ts.contention    = c->contention.loadRelaxed();
+        ts.overflows     = c->overflows.loadRelaxed();
+        ts.maxQueueDepth = c->maxQueueDepth.loadRelaxed();
+        ts.waitTime.counts   = c->waitTime.counts();
+        ts.execTime.counts   = c->execTime.counts();
+        ts.queueDepth.counts = c->queueDepth.counts();
+        for (uint lane = 0 ; lane < CallPriorityCount ; ++lane) {
+            ts.laneCalls[lane] = c->laneCalls[lane].loadRelaxed();
+            ts.laneWaitTime[lane].counts = c->laneWaitTime[lane].counts();
+        }
+        rv << ts;
+    }
+    return rv;
+}
+
+QByteArray ThreadStats::toJson(const Snapshot & snapshot)
+{
+    QJsonArray threads;
+    for (const ThreadSnapshot & ts : snapshot) {
+        QJsonObject obj;
+        obj["name"]          = ts.name;
+        obj["threadId"]      = ts.threadId;
+        obj["calls"]         = (qint64)ts.calls;
+        obj["busyNsecs"]     = (qint64)ts.busyNsecs;
+        obj["waitNsecs"]     = (qint64)ts.waitNsecs;
+        obj["contention"]    = (qint64)ts.contention;
+        obj["overflows"]     = (qint64)ts.overflows;
+        obj["maxQueueDepth"] = (qint64)ts.maxQueueDepth;
+        obj["waitTime"]      = histogramToJson(ts.waitTime);
+        obj["execTime"]      = histogramToJson(ts.execTime);
+        obj["queueDepth"]    = histogramToJson(ts.queueDepth);
+        QJsonObject lanes;
+        for (uint lane = 0 ; lane < CallPriorityCount ; ++lane) {
+            QJsonObject laneObj;
+            laneObj["calls"]    = (qint64)ts.laneCalls[lane];
+            laneObj["waitTime"] = histogramToJson(ts.laneWaitTime[lane]);
+            lanes[LaneNames[lane]] = laneObj;
+        }
+        obj["lanes"] = lanes;
+        threads << obj;
+    }
+    return QJsonDocument(threads).toJson(QJsonDocument::Compact);
+}
+
+QByteArray ThreadStats::toPrometheus(const Snapshot & snapshot)
+{
+    QByteArray rv;
+    promCounter(rv, "cflib_thread_calls_total", "counter", "Calls executed", snapshot,
+        [](const ThreadSnapshot & ts) { return QByteArray::number(ts.calls); });
+    promCounter(rv, "cflib_thread_busy_seconds_total", "counter", "Time spent executing calls", snapshot,
+        [](const ThreadSnapshot & ts) { return QByteArray::number(ts.busyNsecs / 1e9); });
+    promCounter(rv, "cflib_thread_queue_contention_total", "counter", "Retries of concurrent queue operations", snapshot,
+        [](const ThreadSnapshot & ts) { return QByteArray::number(ts.contention); });
+    promCounter(rv, "cflib_thread_queue_overflows_total", "counter", "Calls which found the queue full", snapshot,
+        [](const ThreadSnapshot & ts) { return QByteArray::number(ts.overflows); });
+    promCounter(rv, "cflib_thread_queue_depth_max", "gauge", "Highest number of waiting calls", snapshot,
+        [](const ThreadSnapshot & ts) { return QByteArray::number(ts.maxQueueDepth); });
+    promSummary(rv, "cflib_thread_wait_seconds", "Time from enqueue to start of call", snapshot,
+        [](const ThreadSnapshot & ts) -> const Histogram & { return ts.waitTime; },
+        [](const ThreadSnapshot & ts) { return ts.waitNsecs; }, 1e-9);
+    promSummary(rv, "cflib_thread_exec_seconds", "Execution time per call", snapshot,
+        [](const ThreadSnapshot & ts) -> const Histogram & { return ts.execTime; },
+        [](const ThreadSnapshot & ts) { return ts.busyNsecs; }, 1e-9);
+    promSummary(rv, "cflib_thread_queue_depth", "Waiting calls when a call starts", snapshot,
+        [](const ThreadSnapshot & ts) -> const Histogram & { return ts.queueDepth; },
+        std::function<quint64 (const ThreadSnapshot &)>(), 1);
+
+    rv << "# HELP cflib_thread_lane_calls_total Calls executed per priority lane\n"
+          "# TYPE cflib_thread_lane_calls_total counter\n";
+    for (const ThreadSnapshot & ts : snapshot) {
+        for (uint lane = 0 ; lane < CallPriorityCount ; ++lane) {
+            rv << "cflib_thread_lane_calls_total{thread=\"" << promLabel(ts.name) << "\",lane=\"" << LaneNames[lane] << "\"} "
+               << QByteArray::number(ts.laneCalls[lane]) << '\n';
+        }
+    }
+    rv << "# HELP cflib_thread_lane_wait_seconds Time from enqueue to start of call per priority lane\n"
+          "# TYPE cflib_thread_lane_wait_seconds summary\n";
+    for (const ThreadSnapshot & ts : snapshot) {
+        for (uint lane = 0 ; lane < CallPriorityCount ; ++lane) {
+            const QByteArray labels = "thread=\"" + promLabel(ts.name) + "\",lane=\"" + LaneNames[lane] + '"';
+            const Histogram & h = ts.laneWaitTime[lane];
+            for (double p : Percentiles) {
+                rv << "cflib_thread_lane_wait_seconds{" << labels << ",quantile=\"" << QByteArray::number(p / 100) << "\"} "
+                   << QByteArray::number(h.percentile(p) * 1e-9) << '\n';
+            }
+            rv << "cflib_thread_lane_wait_seconds_count{" << labels << "} " << QByteArray::number(h.count()) << '\n';
+        }
+    }
+    return rv;
+}
+
+}}    // namespace
@@ -9,6 +9,7 @@
 
 #include <cflib/util/threadverify.h>
 #include <cflib/util/evtimer.h>
+#include <cflib/util/impl/threadcounters.h>
 
 namespace cflib { namespace util {
 
@@ -23,12 +24,45 @@ public:
         qint64 total;
         qint64 peaks;
         qint64 overflows;
+        qint64 contention;
         qint64 avg;
+        QStringList placement;  // one entry per placed thread
 
-        ThreadInfo() : current(0), total(0), peaks(0), overflows(0), avg(0) {}
+        ThreadInfo() : current(0), total(0), peaks(0), overflows(0), contention(0), avg(0) {}
     };
     typedef QVector<ThreadInfo> ThreadInfos;
 
+    // HDR style histogram (see impl::AtomicHistogram)
+    struct Histogram
+    {
+        QVector<quint64> counts;
+
+        quint64 count() const;
+        // upper bound of the bucket containing the p-th percentile (p: 0 .. 100)
+        quint64 percentile(double p) const;
+        quint64 max() const { return percentile(100); }
+        static quint64 bucketUpperBound(uint bucket);
+    };
+
+    // one entry per OS thread (threads of a pool share threadId)
+    struct ThreadSnapshot
+    {
+        QString name;
+        int threadId;
+        quint64 calls;
+        quint64 busyNsecs;
+        quint64 waitNsecs;
+        quint64 contention;
+        quint64 overflows;
+        quint64 maxQueueDepth;
+        Histogram waitTime;     // nsecs from enqueue to start of call
+        Histogram execTime;     // nsecs per call
+        Histogram queueDepth;   // calls waiting when a call starts
+        quint64 laneCalls[CallPriorityCount];       // index is CallPriority
+        Histogram laneWaitTime[CallPriorityCount];
+    };
+    typedef QVector<ThreadSnapshot> Snapshot;
+
 public:
     ThreadStats() : ThreadVerify(), timer_(this, &ThreadStats::timeout)
     {
@@ -39,19 +73,33 @@ public:
 
     ~ThreadStats()
     {
+        setStats(0);
         stopVerifyThread();
+        foreach (impl::ThreadCounters * counters, counters_) delete counters;
     }
 
-    inline void externNewCallTime(int threadId, qint64 nsecs)
+    // called once for each thread by its ThreadHolder
+    impl::ThreadCounters * externNewCounters(const QString & threadName, int threadId)
     {
-        if (!verifyThreadCall(&ThreadStats::externNewCallTime, threadId, nsecs)) return;
-        infos_[threadId].current += nsecs;
+        impl::ThreadCounters * counters = new impl::ThreadCounters(threadName, threadId);
+        QMutexLocker ml(&countersMutex_);
+        counters_ << counters;
+        return counters;
     }
 
-    inline void externOverflow(int threadId)
+    // threads restarted by auto scaling are placed again (placement is empty if no rule matched)
+    inline void externPlacement(int threadId, const QString & threadName, const QString & placement)
     {
-        if (!verifyThreadCall(&ThreadStats::externOverflow, threadId)) return;
-        ++infos_[threadId].overflows;
+        if (!verifyThreadCall(&ThreadStats::externPlacement, threadId, threadName, placement)) return;
+        QStringList & entries = infos_[threadId].placement;
+        const QString prefix = threadName + ": ";
+        for (int i = 0 ; i < entries.size() ; ++i) {
+            if (!entries[i].startsWith(prefix)) continue;
+            if (placement.isEmpty()) entries.removeAt(i);
+            else                     entries[i] = prefix + placement;
+            return;
+        }
+        if (!placement.isEmpty()) entries << prefix + placement;
     }
 
     int externNewId(const QString & threadName)
@@ -62,6 +110,7 @@ public:
         ThreadInfo info;
         info.name = threadName;
         infos_ << info;
+        lastBusy_ << 0;
         return infos_.size() - 1;
     }
 
@@ -69,9 +118,25 @@ public:
     {
         SyncedThreadCall<ThreadInfos> stc(this);
         if (!stc.verify(&ThreadStats::current)) return stc.retval();
-        return infos_;
+
+        ThreadInfos rv = infos_;
+        const Snapshot snap = snapshot();
+        for (const ThreadSnapshot & ts : snap) {
+            ThreadInfo & info = rv[ts.threadId];
+            info.current    += ts.busyNsecs;
+            info.contention += ts.contention;
+            info.overflows  += ts.overflows;
+        }
+        for (int i = 0 ; i < rv.size() ; ++i) rv[i].current -= lastBusy_[i];
+        return rv;
     }
 
+    // reads counters of all threads without blocking any of them (callable from any thread)
+    Snapshot snapshot() const;
+
+    static QByteArray toJson(const Snapshot & snapshot);
+    static QByteArray toPrometheus(const Snapshot & snapshot);
+
 private:
     void init()
     {
@@ -83,24 +148,33 @@ private:
 
     void timeout()
     {
+        QVector<qint64> busy(infos_.size());
+        const Snapshot snap = snapshot();
+        for (const ThreadSnapshot & ts : snap) busy[ts.threadId] += ts.busyNsecs;
+
         qint64 dt = elapsed_.nsecsElapsed();
-        for (ThreadInfo & info : infos_) {
-            if (info.current > dt) {
+        for (int i = 0 ; i < infos_.size() ; ++i) {
+            ThreadInfo & info = infos_[i];
+            const qint64 current = busy[i] - lastBusy_[i];
+            if (current > dt) {
                 ++info.peaks;
                 info.avg = 10000;
             } else {
-                info.avg = info.current * 10000 / dt;
+                info.avg = current * 10000 / dt;
             }
-            info.total += info.current;
-            info.current = 0;
+            info.total = busy[i];
         }
+        lastBusy_ = busy;
         elapsed_.start();
     }
 
 private:
     ThreadInfos infos_;
+    QVector<qint64> lastBusy_;
     EVTimer timer_;
     QElapsedTimer elapsed_;
+    mutable QMutex countersMutex_;
+    QList<impl::ThreadCounters *> counters_;
 };
 
 }}    // namespace
@@ -86,13 +86,21 @@ ev_loop * ThreadVerify::libEVLoop() const
     return th->loop();
 }
 
-void ThreadVerify::execCall(const Functor * func) const
+bool ThreadVerify::execCall(const Functor * func, bool synced, CallPriority prio) const
 {
+    func->priority = prio;
     if (!verifyThread_->isActive()) {
         logWarn("execCall for already terminated thread %1", verifyThread_->threadName);
-        return;
+        delete func;
+        return false;
     }
-    while (!verifyThread_->doCall(func)) QThread::msleep(1000);
+    if (verifyThread_->doCall(func, synced)) return true;
+
+    const impl::ThreadHolder * thread = dynamic_cast<const impl::ThreadHolder *>(QThread::currentThread());
+    logWarn("queue of thread %1 full, call rejected (called by %2)", verifyThread_->threadName, thread ? thread->threadName : "?");
+    verifyThread_->callRejected();
+    delete func;
+    return false;
 }
 
 void ThreadVerify::execLater(const Functor * func) const
@@ -105,11 +113,33 @@ void ThreadVerify::setThreadPrio(QThread::Priority prio)
     verifyThread_->setPriority(prio);
 }
 
+void ThreadVerify::setCallQueueLimit(uint maxCalls, FifoFullPolicy policy, const std::function<void()> & rejected)
+{
+    verifyThread_->setRejectCallback(rejected);
+    if (!verifyThread_->setCallQueueLimit(maxCalls, policy)) {
+        logWarn("thread %1 does not support call queue limits", verifyThread_->threadName);
+    }
+}
+
+void ThreadVerify::setAutoScaling(uint minThreads, double busyRatio, double maxWaitMsecs, double idleSecs)
+{
+    if (!verifyThread_->setAutoScaling(minThreads, busyRatio, maxWaitMsecs, idleSecs)) {
+        logWarn("thread %1 does not support auto scaling", verifyThread_->threadName);
+    }
+}
+
 void ThreadVerify::execLater(const std::function<void ()> & func) const
 {
     execLater(new StdFunctor(func));
 }
 
+void ThreadVerify::execLater(CallPriority prio, const std::function<void ()> & func) const
+{
+    const Functor * functor = new StdFunctor(func);
+    functor->priority = prio;
+    execLater(functor);
+}
+
 void ThreadVerify::shutdownThread()
 {
     if (!verifyThreadCall(&ThreadVerify::shutdownThread)) return;
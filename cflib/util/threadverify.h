@@ -12,6 +12,7 @@
 namespace cflib { namespace util {
 
 class ThreadStats;
+template<typename R> class ThreadCallAwaiter;
 
 class ThreadVerify
 {
@@ -33,9 +34,30 @@ public:
     ev_loop * libEVLoop() const;
     void setThreadPrio(QThread::Priority prio);
 
+    // limits the number of queued calls of this thread (maxCalls == 0 means unlimited)
+    // for a pool, maxCalls is the total of all its threads and priority lanes
+    // - FifoGrow:   queue grows without limit (default)
+    // - FifoBlock:  calling thread waits until there is space in the queue
+    // - FifoReject: call gets dropped and rejected is called in the calling thread
+    // synced calls (verifySyncedThreadCall, SyncedThreadCall) and CallCritical calls are never blocked or rejected
+    void setCallQueueLimit(uint maxCalls, FifoFullPolicy policy,
+        const std::function<void()> & rejected = std::function<void()>());
+
+    // lets a Worker pool adapt its size (threadCount of the constructor is the maximum)
+    // - starts another thread, if a call waited longer than maxWaitMsecs
+    //   or the threads were busy more than busyRatio (0 - 1) of the time
+    // - retires threads which have been idle for idleSecs (but keeps minThreads)
+    // Threads keep their threadNo, so PerThread works as before.
+    // Threads with active timers or execLater calls are not retired.
+    void setAutoScaling(uint minThreads, double busyRatio = 0.8, double maxWaitMsecs = 10, double idleSecs = 30);
+
 protected:
+    // Calls with priority are executed in priority order by worker pools (also Net threads)
+    // and as Qt event priority by Qt threads.
+    // Calls of different priority may overtake each other.
     void execLater(const std::function<void()> & func) const;
     void execLater(const Functor * func) const;
+    void execLater(CallPriority prio, const std::function<void()> & func) const;
     virtual void deleteThreadData() {}
 
     // ------------------------------------------------------------------------
@@ -56,12 +78,28 @@ protected:
         return false;
     }
 
+    template<typename C>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)())
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor0<C>((C *)this, f), false, prio);
+        return false;
+    }
+
+    template<typename C>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)() const) const
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor0C<C>((const C *)this, f), false, prio);
+        return false;
+    }
+
     template<typename C>
     bool verifySyncedThreadCall(void (C::*f)())
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor0<C>((C *)this, f, &sem));
+        execCall(new Functor0<C>((C *)this, f, &sem), true);
         sem.acquire();
         return false;
     }
@@ -71,7 +109,7 @@ protected:
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor0C<C>((const C *)this, f, &sem));
+        execCall(new Functor0C<C>((const C *)this, f, &sem), true);
         sem.acquire();
         return false;
     }
@@ -94,12 +132,28 @@ protected:
         return false;
     }
 
+    template<typename C, typename P1, typename A1>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1), const A1 & a1)
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor1<C, P1>((C *)this, f, a1), false, prio);
+        return false;
+    }
+
+    template<typename C, typename P1, typename A1>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1) const, const A1 & a1) const
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor1C<C, P1>((const C *)this, f, a1), false, prio);
+        return false;
+    }
+
     template<typename C, typename P1, typename A1>
     bool verifySyncedThreadCall(void (C::*f)(P1), A1 & a1)
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor1<C, P1>((C *)this, f, a1, &sem));
+        execCall(new Functor1<C, P1>((C *)this, f, a1, &sem), true);
         sem.acquire();
         return false;
     }
@@ -109,7 +163,7 @@ protected:
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor1C<C, P1>((const C *)this, f, a1, &sem));
+        execCall(new Functor1C<C, P1>((const C *)this, f, a1, &sem), true);
         sem.acquire();
         return false;
     }
@@ -132,12 +186,28 @@ protected:
         return false;
     }
 
+    template<typename C, typename P1, typename P2, typename A1, typename A2>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2), const A1 & a1, const A2 & a2)
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor2<C, P1, P2>((C *)this, f, a1, a2), false, prio);
+        return false;
+    }
+
+    template<typename C, typename P1, typename P2, typename A1, typename A2>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2) const, const A1 & a1, const A2 & a2) const
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor2C<C, P1, P2>((const C *)this, f, a1, a2), false, prio);
+        return false;
+    }
+
     template<typename C, typename P1, typename P2, typename A1, typename A2>
     bool verifySyncedThreadCall(void (C::*f)(P1, P2), A1 & a1, A2 & a2)
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor2<C, P1, P2>((C *)this, f, a1, a2, &sem));
+        execCall(new Functor2<C, P1, P2>((C *)this, f, a1, a2, &sem), true);
         sem.acquire();
         return false;
     }
@@ -147,7 +217,7 @@ protected:
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor2C<C, P1, P2>((const C *)this, f, a1, a2, &sem));
+        execCall(new Functor2C<C, P1, P2>((const C *)this, f, a1, a2, &sem), true);
         sem.acquire();
         return false;
     }
@@ -170,12 +240,28 @@ protected:
         return false;
     }
 
+    template<typename C, typename P1, typename P2, typename P3, typename A1, typename A2, typename A3>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3), const A1 & a1, const A2 & a2, const A3 & a3)
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor3<C, P1, P2, P3>((C *)this, f, a1, a2, a3), false, prio);
+        return false;
+    }
+
+    template<typename C, typename P1, typename P2, typename P3, typename A1, typename A2, typename A3>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3) const, const A1 & a1, const A2 & a2, const A3 & a3) const
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor3C<C, P1, P2, P3>((const C *)this, f, a1, a2, a3), false, prio);
+        return false;
+    }
+
     template<typename C, typename P1, typename P2, typename P3, typename A1, typename A2, typename A3>
     bool verifySyncedThreadCall(void (C::*f)(P1, P2, P3), A1 & a1, A2 & a2, A3 & a3)
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor3<C, P1, P2, P3>((C *)this, f, a1, a2, a3, &sem));
+        execCall(new Functor3<C, P1, P2, P3>((C *)this, f, a1, a2, a3, &sem), true);
         sem.acquire();
         return false;
     }
@@ -185,7 +271,7 @@ protected:
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor3C<C, P1, P2, P3>((const C *)this, f, a1, a2, a3, &sem));
+        execCall(new Functor3C<C, P1, P2, P3>((const C *)this, f, a1, a2, a3, &sem), true);
         sem.acquire();
         return false;
     }
@@ -208,12 +294,28 @@ protected:
         return false;
     }
 
+    template<typename C, typename P1, typename P2, typename P3, typename P4, typename A1, typename A2, typename A3, typename A4>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3, P4), const A1 & a1, const A2 & a2, const A3 & a3, const A4 & a4)
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor4<C, P1, P2, P3, P4>((C *)this, f, a1, a2, a3, a4), false, prio);
+        return false;
+    }
+
+    template<typename C, typename P1, typename P2, typename P3, typename P4, typename A1, typename A2, typename A3, typename A4>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3, P4) const, const A1 & a1, const A2 & a2, const A3 & a3, const A4 & a4) const
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor4C<C, P1, P2, P3, P4>((const C *)this, f, a1, a2, a3, a4), false, prio);
+        return false;
+    }
+
     template<typename C, typename P1, typename P2, typename P3, typename P4, typename A1, typename A2, typename A3, typename A4>
     bool verifySyncedThreadCall(void (C::*f)(P1, P2, P3, P4), A1 & a1, A2 & a2, A3 & a3, A4 & a4)
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor4<C, P1, P2, P3, P4>((C *)this, f, a1, a2, a3, a4, &sem));
+        execCall(new Functor4<C, P1, P2, P3, P4>((C *)this, f, a1, a2, a3, a4, &sem), true);
         sem.acquire();
         return false;
     }
@@ -223,7 +325,7 @@ protected:
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor4C<C, P1, P2, P3, P4>((const C *)this, f, a1, a2, a3, a4, &sem));
+        execCall(new Functor4C<C, P1, P2, P3, P4>((const C *)this, f, a1, a2, a3, a4, &sem), true);
         sem.acquire();
         return false;
     }
@@ -246,12 +348,28 @@ protected:
         return false;
     }
 
+    template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename A1, typename A2, typename A3, typename A4, typename A5>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3, P4, P5), const A1 & a1, const A2 & a2, const A3 & a3, const A4 & a4, const A5 & a5)
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor5<C, P1, P2, P3, P4, P5>((C *)this, f, a1, a2, a3, a4, a5), false, prio);
+        return false;
+    }
+
+    template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename A1, typename A2, typename A3, typename A4, typename A5>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3, P4, P5) const, const A1 & a1, const A2 & a2, const A3 & a3, const A4 & a4, const A5 & a5) const
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor5C<C, P1, P2, P3, P4, P5>((const C *)this, f, a1, a2, a3, a4, a5), false, prio);
+        return false;
+    }
+
     template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename A1, typename A2, typename A3, typename A4, typename A5>
     bool verifySyncedThreadCall(void (C::*f)(P1, P2, P3, P4, P5), A1 & a1, A2 & a2, A3 & a3, A4 & a4, A5 & a5)
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor5<C, P1, P2, P3, P4, P5>((C *)this, f, a1, a2, a3, a4, a5, &sem));
+        execCall(new Functor5<C, P1, P2, P3, P4, P5>((C *)this, f, a1, a2, a3, a4, a5, &sem), true);
         sem.acquire();
         return false;
     }
@@ -261,7 +379,7 @@ protected:
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor5C<C, P1, P2, P3, P4, P5>((const C *)this, f, a1, a2, a3, a4, a5, &sem));
+        execCall(new Functor5C<C, P1, P2, P3, P4, P5>((const C *)this, f, a1, a2, a3, a4, a5, &sem), true);
         sem.acquire();
         return false;
     }
@@ -284,12 +402,28 @@ protected:
         return false;
     }
 
+    template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename A1, typename A2, typename A3, typename A4, typename A5, typename A6>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3, P4, P5, P6), const A1 & a1, const A2 & a2, const A3 & a3, const A4 & a4, const A5 & a5, const A6 & a6)
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor6<C, P1, P2, P3, P4, P5, P6>((C *)this, f, a1, a2, a3, a4, a5, a6), false, prio);
+        return false;
+    }
+
+    template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename A1, typename A2, typename A3, typename A4, typename A5, typename A6>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3, P4, P5, P6) const, const A1 & a1, const A2 & a2, const A3 & a3, const A4 & a4, const A5 & a5, const A6 & a6) const
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor6C<C, P1, P2, P3, P4, P5, P6>((const C *)this, f, a1, a2, a3, a4, a5, a6), false, prio);
+        return false;
+    }
+
     template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename A1, typename A2, typename A3, typename A4, typename A5, typename A6>
     bool verifySyncedThreadCall(void (C::*f)(P1, P2, P3, P4, P5, P6), A1 & a1, A2 & a2, A3 & a3, A4 & a4, A5 & a5, A6 & a6)
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor6<C, P1, P2, P3, P4, P5, P6>((C *)this, f, a1, a2, a3, a4, a5, a6, &sem));
+        execCall(new Functor6<C, P1, P2, P3, P4, P5, P6>((C *)this, f, a1, a2, a3, a4, a5, a6, &sem), true);
         sem.acquire();
         return false;
     }
@@ -299,7 +433,7 @@ protected:
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor6C<C, P1, P2, P3, P4, P5, P6>((const C *)this, f, a1, a2, a3, a4, a5, a6, &sem));
+        execCall(new Functor6C<C, P1, P2, P3, P4, P5, P6>((const C *)this, f, a1, a2, a3, a4, a5, a6, &sem), true);
         sem.acquire();
         return false;
     }
@@ -322,12 +456,28 @@ protected:
         return false;
     }
 
+    template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename A1, typename A2, typename A3, typename A4, typename A5, typename A6, typename A7>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3, P4, P5, P6, P7), const A1 & a1, const A2 & a2, const A3 & a3, const A4 & a4, const A5 & a5, const A6 & a6, const A7 & a7)
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor7<C, P1, P2, P3, P4, P5, P6, P7>((C *)this, f, a1, a2, a3, a4, a5, a6, a7), false, prio);
+        return false;
+    }
+
+    template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename A1, typename A2, typename A3, typename A4, typename A5, typename A6, typename A7>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3, P4, P5, P6, P7) const, const A1 & a1, const A2 & a2, const A3 & a3, const A4 & a4, const A5 & a5, const A6 & a6, const A7 & a7) const
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor7C<C, P1, P2, P3, P4, P5, P6, P7>((const C *)this, f, a1, a2, a3, a4, a5, a6, a7), false, prio);
+        return false;
+    }
+
     template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename A1, typename A2, typename A3, typename A4, typename A5, typename A6, typename A7>
     bool verifySyncedThreadCall(void (C::*f)(P1, P2, P3, P4, P5, P6, P7), A1 & a1, A2 & a2, A3 & a3, A4 & a4, A5 & a5, A6 & a6, A7 & a7)
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor7<C, P1, P2, P3, P4, P5, P6, P7>((C *)this, f, a1, a2, a3, a4, a5, a6, a7, &sem));
+        execCall(new Functor7<C, P1, P2, P3, P4, P5, P6, P7>((C *)this, f, a1, a2, a3, a4, a5, a6, a7, &sem), true);
         sem.acquire();
         return false;
     }
@@ -337,7 +487,7 @@ protected:
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor7C<C, P1, P2, P3, P4, P5, P6, P7>((const C *)this, f, a1, a2, a3, a4, a5, a6, a7, &sem));
+        execCall(new Functor7C<C, P1, P2, P3, P4, P5, P6, P7>((const C *)this, f, a1, a2, a3, a4, a5, a6, a7, &sem), true);
         sem.acquire();
         return false;
     }
@@ -360,12 +510,28 @@ protected:
         return false;
     }
 
+    template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename A1, typename A2, typename A3, typename A4, typename A5, typename A6, typename A7, typename A8>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3, P4, P5, P6, P7, P8), const A1 & a1, const A2 & a2, const A3 & a3, const A4 & a4, const A5 & a5, const A6 & a6, const A7 & a7, const A8 & a8)
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor8<C, P1, P2, P3, P4, P5, P6, P7, P8>((C *)this, f, a1, a2, a3, a4, a5, a6, a7, a8), false, prio);
+        return false;
+    }
+
+    template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename A1, typename A2, typename A3, typename A4, typename A5, typename A6, typename A7, typename A8>
+    bool verifyThreadCall(CallPriority prio, void (C::*f)(P1, P2, P3, P4, P5, P6, P7, P8) const, const A1 & a1, const A2 & a2, const A3 & a3, const A4 & a4, const A5 & a5, const A6 & a6, const A7 & a7, const A8 & a8) const
+    {
+        if (verifyThread_->isOwnThread()) return true;
+        execCall(new Functor8C<C, P1, P2, P3, P4, P5, P6, P7, P8>((const C *)this, f, a1, a2, a3, a4, a5, a6, a7, a8), false, prio);
+        return false;
+    }
+
     template<typename C, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename A1, typename A2, typename A3, typename A4, typename A5, typename A6, typename A7, typename A8>
     bool verifySyncedThreadCall(void (C::*f)(P1, P2, P3, P4, P5, P6, P7, P8), A1 & a1, A2 & a2, A3 & a3, A4 & a4, A5 & a5, A6 & a6, A7 & a7, A8 & a8)
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor8<C, P1, P2, P3, P4, P5, P6, P7, P8>((C *)this, f, a1, a2, a3, a4, a5, a6, a7, a8, &sem));
+        execCall(new Functor8<C, P1, P2, P3, P4, P5, P6, P7, P8>((C *)this, f, a1, a2, a3, a4, a5, a6, a7, a8, &sem), true);
         sem.acquire();
         return false;
     }
@@ -375,7 +541,7 @@ protected:
     {
         if (verifyThread_->isOwnThread()) return true;
         QSemaphore sem;
-        execCall(new Functor8C<C, P1, P2, P3, P4, P5, P6, P7, P8>((const C *)this, f, a1, a2, a3, a4, a5, a6, a7, a8, &sem));
+        execCall(new Functor8C<C, P1, P2, P3, P4, P5, P6, P7, P8>((const C *)this, f, a1, a2, a3, a4, a5, a6, a7, a8, &sem), true);
         sem.acquire();
         return false;
     }
@@ -394,7 +560,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor0<C, R>((C *)tv_, f, retval_, &sem));
+            tv_->execCall(new RFunctor0<C, R>((C *)tv_, f, retval_, &sem), true);
             sem.acquire();
             return false;
         }
@@ -404,7 +570,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor0C<C, R>((const C *)tv_, f, retval_, &sem));
+            tv_->execCall(new RFunctor0C<C, R>((const C *)tv_, f, retval_, &sem), true);
             sem.acquire();
             return false;
         }
@@ -414,7 +580,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor1<C, R, P1>((C *)tv_, f, retval_, a1, &sem));
+            tv_->execCall(new RFunctor1<C, R, P1>((C *)tv_, f, retval_, a1, &sem), true);
             sem.acquire();
             return false;
         }
@@ -424,7 +590,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor1C<C, R, P1>((const C *)tv_, f, retval_, a1, &sem));
+            tv_->execCall(new RFunctor1C<C, R, P1>((const C *)tv_, f, retval_, a1, &sem), true);
             sem.acquire();
             return false;
         }
@@ -434,7 +600,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor2<C, R, P1, P2>((C *)tv_, f, retval_, a1, a2, &sem));
+            tv_->execCall(new RFunctor2<C, R, P1, P2>((C *)tv_, f, retval_, a1, a2, &sem), true);
             sem.acquire();
             return false;
         }
@@ -444,7 +610,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor2C<C, R, P1, P2>((const C *)tv_, f, retval_, a1, a2, &sem));
+            tv_->execCall(new RFunctor2C<C, R, P1, P2>((const C *)tv_, f, retval_, a1, a2, &sem), true);
             sem.acquire();
             return false;
         }
@@ -454,7 +620,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor3<C, R, P1, P2, P3>((C *)tv_, f, retval_, a1, a2, a3, &sem));
+            tv_->execCall(new RFunctor3<C, R, P1, P2, P3>((C *)tv_, f, retval_, a1, a2, a3, &sem), true);
             sem.acquire();
             return false;
         }
@@ -464,7 +630,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor3C<C, R, P1, P2, P3>((const C *)tv_, f, retval_, a1, a2, a3, &sem));
+            tv_->execCall(new RFunctor3C<C, R, P1, P2, P3>((const C *)tv_, f, retval_, a1, a2, a3, &sem), true);
             sem.acquire();
             return false;
         }
@@ -474,7 +640,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor4<C, R, P1, P2, P3, P4>((C *)tv_, f, retval_, a1, a2, a3, a4, &sem));
+            tv_->execCall(new RFunctor4<C, R, P1, P2, P3, P4>((C *)tv_, f, retval_, a1, a2, a3, a4, &sem), true);
             sem.acquire();
             return false;
         }
@@ -484,7 +650,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor4C<C, R, P1, P2, P3, P4>((const C *)tv_, f, retval_, a1, a2, a3, a4, &sem));
+            tv_->execCall(new RFunctor4C<C, R, P1, P2, P3, P4>((const C *)tv_, f, retval_, a1, a2, a3, a4, &sem), true);
             sem.acquire();
             return false;
         }
@@ -494,7 +660,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor5<C, R, P1, P2, P3, P4, P5>((C *)tv_, f, retval_, a1, a2, a3, a4, a5, &sem));
+            tv_->execCall(new RFunctor5<C, R, P1, P2, P3, P4, P5>((C *)tv_, f, retval_, a1, a2, a3, a4, a5, &sem), true);
             sem.acquire();
             return false;
         }
@@ -504,7 +670,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor5C<C, R, P1, P2, P3, P4, P5>((const C *)tv_, f, retval_, a1, a2, a3, a4, a5, &sem));
+            tv_->execCall(new RFunctor5C<C, R, P1, P2, P3, P4, P5>((const C *)tv_, f, retval_, a1, a2, a3, a4, a5, &sem), true);
             sem.acquire();
             return false;
         }
@@ -514,7 +680,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor6<C, R, P1, P2, P3, P4, P5, P6>((C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, &sem));
+            tv_->execCall(new RFunctor6<C, R, P1, P2, P3, P4, P5, P6>((C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, &sem), true);
             sem.acquire();
             return false;
         }
@@ -524,7 +690,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor6C<C, R, P1, P2, P3, P4, P5, P6>((const C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, &sem));
+            tv_->execCall(new RFunctor6C<C, R, P1, P2, P3, P4, P5, P6>((const C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, &sem), true);
             sem.acquire();
             return false;
         }
@@ -534,7 +700,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor7<C, R, P1, P2, P3, P4, P5, P6, P7>((C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, a7, &sem));
+            tv_->execCall(new RFunctor7<C, R, P1, P2, P3, P4, P5, P6, P7>((C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, a7, &sem), true);
             sem.acquire();
             return false;
         }
@@ -544,7 +710,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor7C<C, R, P1, P2, P3, P4, P5, P6, P7>((const C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, a7, &sem));
+            tv_->execCall(new RFunctor7C<C, R, P1, P2, P3, P4, P5, P6, P7>((const C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, a7, &sem), true);
             sem.acquire();
             return false;
         }
@@ -554,7 +720,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor8<C, R, P1, P2, P3, P4, P5, P6, P7, P8>((C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, a7, a8, &sem));
+            tv_->execCall(new RFunctor8<C, R, P1, P2, P3, P4, P5, P6, P7, P8>((C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, a7, a8, &sem), true);
             sem.acquire();
             return false;
         }
@@ -564,7 +730,7 @@ protected:
         {
             if (tv_->verifyThread_->isOwnThread()) return true;
             QSemaphore sem;
-            tv_->execCall(new RFunctor8C<C, R, P1, P2, P3, P4, P5, P6, P7, P8>((const C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, a7, a8, &sem));
+            tv_->execCall(new RFunctor8C<C, R, P1, P2, P3, P4, P5, P6, P7, P8>((const C *)tv_, f, retval_, a1, a2, a3, a4, a5, a6, a7, a8, &sem), true);
             sem.acquire();
             return false;
         }
@@ -603,13 +769,15 @@ private:
     ThreadVerify();
     void setStats(ThreadStats * stats);
     void shutdownThread();
-    void execCall(const Functor * func) const;
+    // returns false, if func got dropped (terminated thread or full queue)
+    bool execCall(const Functor * func, bool synced = false, CallPriority prio = CallNormal) const;
 
 private:
     impl::ThreadHolder * verifyThread_;
     const bool ownerOfVerifyThread_;
 
     friend class ThreadStats;
+    template<typename R> friend class ThreadCallAwaiter;
 };
 
 inline ev_loop * libEVLoopOfThread()
@@ -7,8 +7,8 @@
 
 #include "timer.h"
 
-#include <cflib/util/libev.h>
 #include <cflib/util/threadverify.h>
+#include <cflib/util/timerwheel.h>
 
 namespace cflib { namespace util {
 
@@ -32,20 +32,44 @@ private:
     const Functor * func_;
 };
 
-}
-
-void Timer::singleShot(double afterSecs, const Functor * func)
+class SingleShot : public TimerWheel::Entry
 {
-    ev_loop * loop = libEVLoopOfThread();
-    if (loop) ev_once(loop, -1, 0, afterSecs, &Timer::timeout, (void *)func);
-    else      QTimer::singleShot(afterSecs * 1000, new TimerObject(func), SLOT(timeout()));
+public:
+    SingleShot(const Functor * func) : func_(func) {}
+    ~SingleShot() { delete func_; }
+
+    static void * operator new(std::size_t size)           { return impl::functorAlloc(size); }
+    static void operator delete(void * ptr, std::size_t size) { impl::functorFree(ptr, size); }
+
+protected:
+    void expired() override
+    {
+        (*func_)();
+        delete this;
+    }
+
+    void dropped() override
+    {
+        delete this;
+    }
+
+private:
+    const Functor * func_;
+};
+
 }
 
-void Timer::timeout(int, void * arg)
+void Timer::singleShot(double afterSecs, const Functor * func)
 {
-    const Functor * func = (const Functor *)arg;
-    (*func)();
-    delete func;
+    impl::ThreadHolderLibEV * thread = dynamic_cast<impl::ThreadHolderLibEV *>(QThread::currentThread());
+    if (!thread) {
+        QTimer::singleShot(afterSecs * 1000, new TimerObject(func), SLOT(timeout()));
+    } else if (afterSecs <= 0) {
+        // next loop iteration
+        thread->execLater(func);
+    } else {
+        thread->timerWheel()->start(new SingleShot(func), afterSecs);
+    }
 }
 
 }}    // namespace
@@ -27,9 +27,6 @@ public:
     {
         singleShot(afterSecs, new util::Functor0C<C>(obj, func));
     }
-
-private:
-    static void timeout(int revents, void * arg);
 };
 
 }}    // namespace
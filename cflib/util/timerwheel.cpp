@@ -0,0 +1,188 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include "timerwheel.h"
+
+#include <cflib/util/libev.h>
+#include <cflib/util/threadverify.h>
+
+#include <cmath>
+
+namespace cflib { namespace util {
+
+TimerWheel::TimerWheel(ev_loop * loop) :
+    loop_(loop),
+    driver_(new ev_timer),
+    base_(ev_now(loop)),
+    current_(0),
+    count_(0),
+    inTimeout_(false)
+{
+    ev_init(driver_, &TimerWheel::timeout);
+    driver_->data = this;
+    for (uint level = 0 ; level < Levels ; ++level) {
+        for (uint i = 0 ; i < Slots ; ++i) slots_[level][i].prev = slots_[level][i].next = &slots_[level][i];
+        for (uint i = 0 ; i < Slots / 64 ; ++i) used_[level][i] = 0;
+    }
+}
+
+TimerWheel::~TimerWheel()
+{
+    ev_timer_stop(loop_, driver_);
+    delete driver_;
+    for (uint level = 0 ; level < Levels ; ++level) {
+        for (uint i = 0 ; i < Slots ; ++i) {
+            Link & head = slots_[level][i];
+            while (head.next != &head) {
+                Entry * entry = static_cast<Entry *>(head.next);
+                unlink(entry);
+                entry->wheel_ = 0;
+                entry->dropped();
+            }
+        }
+    }
+}
+
+void TimerWheel::start(Entry * entry, double afterSecs)
+{
+    // round up: never fire early
+    startAt(entry, (quint64)std::ceil((ev_now(loop_) - base_ + qMax(afterSecs, 0.0)) * 1000));
+}
+
+void TimerWheel::startAt(Entry * entry, quint64 tick)
+{
+    if (entry->wheel_) entry->wheel_->stop(entry);
+
+    const quint64 now = nowTick();
+    if (count_ == 0 && now > current_) current_ = now;
+    entry->expires_ = tick;
+    entry->wheel_ = this;
+    insert(entry);
+    ++count_;
+    if (!inTimeout_) schedule();
+}
+
+void TimerWheel::stop(Entry * entry)
+{
+    if (entry->wheel_ != this) return;
+    unlink(entry);
+    entry->wheel_ = 0;
+    if (--count_ == 0 && !inTimeout_) ev_timer_stop(loop_, driver_);
+}
+
+TimerWheel * TimerWheel::ofThread()
+{
+    impl::ThreadHolderLibEV * thread = dynamic_cast<impl::ThreadHolderLibEV *>(QThread::currentThread());
+    return thread ? thread->timerWheel() : 0;
+}
+
+quint64 TimerWheel::nowTick() const
+{
+    return (quint64)((ev_now(loop_) - base_) * 1000);
+}
+
+void TimerWheel::insert(Entry * entry)
+{
+    // never insert into an already processed slot
+    if (entry->expires_ <= current_) entry->expires_ = current_ + 1;
+
+    const quint64 expires = entry->expires_;
+    const quint64 delta = expires - current_;
+    uint level = 0;
+    uint slot;
+    if (delta < Q_UINT64_C(1) << (Levels * SlotBits)) {
+        while (delta >= Q_UINT64_C(1) << ((level + 1) * SlotBits)) ++level;
+        slot = (expires >> (level * SlotBits)) & Mask;
+    } else {
+        // too far away: park in the last slot of the top level and reinsert on cascade
+        level = Levels - 1;
+        slot = ((current_ >> (level * SlotBits)) + Mask) & Mask;
+    }
+
+    Link & head = slots_[level][slot];
+    entry->prev = head.prev;
+    entry->next = &head;
+    head.prev->next = entry;
+    head.prev = entry;
+    used_[level][slot / 64] |= Q_UINT64_C(1) << (slot % 64);
+}
+
+void TimerWheel::cascade(uint level)
+{
+    const uint slot = (current_ >> (level * SlotBits)) & Mask;
+    if (slot == 0 && level + 1 < Levels) cascade(level + 1);
+
+    used_[level][slot / 64] &= ~(Q_UINT64_C(1) << (slot % 64));
+    Link & head = slots_[level][slot];
+    while (head.next != &head) {
+        Entry * entry = static_cast<Entry *>(head.next);
+        unlink(entry);
+        insert(entry);
+    }
+}
+
+int TimerWheel::nextUsedSlot(uint from) const
+{
+    for (uint word = from / 64 ; word < Slots / 64 ; ++word) {
+        quint64 bits = used_[0][word];
+        if (word == from / 64) bits &= ~Q_UINT64_C(0) << (from % 64);
+        if (bits) return word * 64 + qCountTrailingZeroBits(bits);
+    }
+    return -1;
+}
+
+void TimerWheel::advance(quint64 now)
+{
+    while (current_ < now) {
+        // jump to next non empty slot or to next cascade
+        const uint pos = current_ & Mask;
+        const int next = pos < Mask ? nextUsedSlot(pos + 1) : -1;
+        const quint64 target = current_ - pos + (next >= 0 ? (uint)next : (uint)Slots);
+        if (target > now) {
+            current_ = now;
+            break;
+        }
+        current_ = target;
+
+        const uint slot = current_ & Mask;
+        if (slot == 0) cascade(1);
+
+        used_[0][slot / 64] &= ~(Q_UINT64_C(1) << (slot % 64));
+        Link & head = slots_[0][slot];
+        while (head.next != &head) {
+            Entry * entry = static_cast<Entry *>(head.next);
+            unlink(entry);
+            entry->wheel_ = 0;
+            --count_;
+            entry->expired();
+        }
+    }
+}
+
+void TimerWheel::schedule()
+{
+    ev_timer_stop(loop_, driver_);
+    if (count_ == 0) return;
+
+    const uint pos = current_ & Mask;
+    const int next = pos < Mask ? nextUsedSlot(pos + 1) : -1;
+    const quint64 target = current_ - pos + (next >= 0 ? (uint)next : (uint)Slots);
+    const double after = base_ + target / 1000.0 - ev_now(loop_);
+    ev_timer_set(driver_, qMax(after, 0.0) + 0.0001, 0.0);
+    ev_timer_start(loop_, driver_);
+}
+
+void TimerWheel::timeout(ev_loop *, ev_timer * w, int)
+{
+    TimerWheel * wheel = (TimerWheel *)w->data;
+    wheel->inTimeout_ = true;
+    wheel->advance(wheel->nowTick());
+    wheel->inTimeout_ = false;
+    wheel->schedule();
+}
+
+}}    // namespace
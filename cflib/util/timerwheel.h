@@ -0,0 +1,102 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#pragma once
+
+#include <QtCore>
+
+struct ev_loop;
+struct ev_timer;
+
+namespace cflib { namespace util {
+
+// Hierarchical timer wheel of one libev thread
+// 4 levels with 256 slots each and 1 ms resolution cover about 49 days.
+// Start and stop are O(1) and do not allocate, the loop wakes up only for non empty slots
+// or when a higher level has to be cascaded (at most every 256 ms).
+// Not thread safe: all calls have to happen in the thread of the wheel.
+class TimerWheel
+{
+    Q_DISABLE_COPY(TimerWheel)
+private:
+    struct Link
+    {
+        Link * prev;
+        Link * next;
+    };
+
+public:
+    class Entry : private Link
+    {
+        Q_DISABLE_COPY(Entry)
+    public:
+        Entry() : wheel_(0), expires_(0) { prev = next = 0; }
+        virtual ~Entry() { if (wheel_) wheel_->stop(this); }
+
+        bool isActive() const { return wheel_ != 0; }
+        // tick of the (last) expiry
+        quint64 expiresAt() const { return expires_; }
+
+    protected:
+        virtual void expired() = 0;
+        // called instead of expired, if the wheel gets destroyed while entry is active
+        virtual void dropped() {}
+
+    private:
+        TimerWheel * wheel_;
+        quint64 expires_;
+        friend class TimerWheel;
+    };
+
+public:
+    TimerWheel(ev_loop * loop);
+    ~TimerWheel();
+
+    void start(Entry * entry, double afterSecs);
+    // tick: absolute ms since creation of the wheel (e.g. expiresAt() + period for drift free repeats)
+    void startAt(Entry * entry, quint64 tick);
+    void stop(Entry * entry);
+    uint count() const { return count_; }
+
+    // wheel of the current libev thread (0 for other threads)
+    static TimerWheel * ofThread();
+
+private:
+    enum {
+        Levels   = 4,
+        SlotBits = 8,
+        Slots    = 1 << SlotBits,
+        Mask     = Slots - 1
+    };
+
+    quint64 nowTick() const;
+    void insert(Entry * entry);
+    void cascade(uint level);
+    void advance(quint64 now);
+    void schedule();
+    int nextUsedSlot(uint from) const;
+    static void timeout(ev_loop * loop, ev_timer * w, int revents);
+
+    static void unlink(Link * link)
+    {
+        link->prev->next = link->next;
+        link->next->prev = link->prev;
+        link->prev = link->next = 0;
+    }
+
+private:
+    ev_loop * const loop_;
+    ev_timer * const driver_;
+    const double base_;
+    quint64 current_;       // last processed tick
+    uint count_;
+    bool inTimeout_;
+    Link slots_[Levels][Slots];
+    quint64 used_[Levels][Slots / 64];  // may contain stale bits of emptied slots
+};
+
+}}    // namespace
@@ -79,6 +79,52 @@ private slots:
         QCOMPARE(fifo.take(), 0);
     }
 
+    void grow_test()
+    {
+        ThreadFifo<int> fifo(0, FifoGrow, 16);
+        for (int i = 1 ; i <= 1000 ; ++i) QVERIFY(fifo.put(i));
+        QCOMPARE(fifo.size(), (quint64)1000);
+        for (int i = 1 ; i <=  600 ; ++i) QCOMPARE(fifo.take(), i);
+        for (int i = 1001 ; i <= 2000 ; ++i) QVERIFY(fifo.put(i));
+        for (int i =  601 ; i <= 2000 ; ++i) QCOMPARE(fifo.take(), i);
+        QCOMPARE(fifo.take(), 0);
+        QVERIFY(fifo.isEmpty());
+    }
+
+    void block_test()
+    {
+        ThreadFifo<int> fifo(10, FifoBlock, 4);
+        for (int i = 1 ; i <= 10 ; ++i) QVERIFY(fifo.put(i));
+        QThread * th = QThread::create([&fifo]() { fifo.put(11); });
+        th->start();
+        QVERIFY(!th->wait(100));
+        QCOMPARE(fifo.take(), 1);
+        QVERIFY(th->wait(1000));
+        delete th;
+        for (int i = 2 ; i <= 11 ; ++i) QCOMPARE(fifo.take(), i);
+        QCOMPARE(fifo.take(), 0);
+        QVERIFY(fifo.takeOverflowCount() > 0);
+    }
+
+    void putTakeRace_test()
+    {
+        // at most 4 elements queued at any time: the limit of 8 is never reached
+        ThreadFifo<int> fifo(8, FifoReject, 4);
+        QAtomicInt rejected(0);
+        QList<QThread *> threads;
+        for (int t = 0 ; t < 4 ; ++t) threads << QThread::create([&fifo, &rejected]() {
+            for (int i = 1 ; i <= 200000 ; ++i) {
+                if (!fifo.put(i)) rejected.ref();
+                fifo.take();
+            }
+        });
+        foreach (QThread * th, threads) th->start();
+        foreach (QThread * th, threads) QVERIFY(th->wait(60000));
+        qDeleteAll(threads);
+        QCOMPARE(rejected.loadRelaxed(), 0);
+        QVERIFY(fifo.isEmpty());
+    }
+
     void thread_test()
     {
         ThreadFifo<int> fifo(1024);
@@ -0,0 +1,431 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include <cflib/util/test.h>
+#include <cflib/util/task.h>
+#include <cflib/util/threadplacement.h>
+#include <cflib/util/threadstats.h>
+
+#ifdef Q_OS_LINUX
+    #include <sched.h>
+#endif
+
+using namespace cflib::util;
+
+namespace {
+
+const int CallsPerRun = 100000;
+
+class Receiver : public ThreadVerify
+{
+public:
+    Receiver(LoopType loopType, uint threadCount, const QString & name = "Receiver") :
+        ThreadVerify(name, loopType, threadCount),
+        sum_(0)
+    {}
+
+    ~Receiver()
+    {
+        stopVerifyThread();
+    }
+
+    void add(int value)
+    {
+        if (!verifyThreadCall(&Receiver::add, value)) return;
+        sum_ += value;
+    }
+
+    void addLater(int value)
+    {
+        if (!verifyThreadCall(&Receiver::addLater, value)) return;
+        execLater([this, value]() { sum_ += value; });
+    }
+
+    void run(const std::function<void()> & func)
+    {
+        if (!verifyThreadCall(&Receiver::run, func)) return;
+        func();
+    }
+
+    void run(CallPriority prio, const std::function<void()> & func)
+    {
+        if (!verifyThreadCall(prio, &Receiver::run, func)) return;
+        func();
+    }
+
+    void sleep(int msecs)
+    {
+        QThread::msleep(msecs);
+    }
+
+    int fail() const
+    {
+        throw std::runtime_error("failed");
+    }
+
+    void stop()
+    {
+        stopVerifyThread();
+    }
+
+    qint64 sum() const
+    {
+        SyncedThreadCall<qint64> stc(this);
+        if (!stc.verify(&Receiver::sum)) return stc.retval();
+        return sum_;
+    }
+
+private:
+    QAtomicInteger<qint64> sum_;
+};
+
+// deletes its functor after the functor cache of the thread is gone
+struct LateFunctorDelete
+{
+    const Functor * functor = 0;
+    QSemaphore * done = 0;
+
+    ~LateFunctorDelete()
+    {
+        delete functor;
+        delete new StdFunctor([]() {});
+        if (done) done->release();
+    }
+};
+
+thread_local LateFunctorDelete lateFunctorDelete;
+
+Task<qint64> addAndSum(Receiver & recv, int value)
+{
+    co_await onThread(&recv, &Receiver::add, value);
+    co_return co_await onThread(&recv, &Receiver::sum);
+}
+
+Task<> addTwice(Receiver & recv, qint64 & result)
+{
+    co_await addAndSum(recv, 5);
+    result = co_await addAndSum(recv, 7);
+}
+
+void reportCallsPerSec(const char * name, const QElapsedTimer & elapsed)
+{
+    const qint64 nsecs = elapsed.nsecsElapsed();
+    QTextStream(stdout) << name << ": " << (nsecs > 0 ? (qint64)CallsPerRun * 1000000000 / nsecs : 0) << " calls/sec" << Qt::endl;
+}
+
+}
+
+class ThreadVerify_Test: public QObject
+{
+    Q_OBJECT
+private slots:
+
+    void priority_test()
+    {
+        Receiver recv(ThreadVerify::Net, 1);
+        QSemaphore started;
+        QSemaphore release;
+        QSemaphore done;
+        QVector<int> order;
+        recv.run([&]() { started.release(); release.acquire(); });
+        started.acquire();
+        for (int i = 0 ; i < 10 ; ++i) recv.run(CallBulk,   [&order]() { order << CallBulk;   });
+        for (int i = 0 ; i < 10 ; ++i) recv.run(CallNormal, [&order]() { order << CallNormal; });
+        recv.run(CallCritical, [&order]() { order << CallCritical; });
+        recv.run(CallBulk, [&done]() { done.release(); });
+        release.release();
+        done.acquire();
+
+        QCOMPARE(order.size(), 21);
+        QCOMPARE(order.first(), (int)CallCritical);
+        QVERIFY(order.lastIndexOf(CallNormal) < order.lastIndexOf(CallBulk));
+    }
+
+    void qtCallQueueLimit_test()
+    {
+        Receiver qt(ThreadVerify::Qt, 1);
+        int rejected = 0;
+        qt.setCallQueueLimit(100, FifoReject, [&rejected]() { ++rejected; });
+        QSemaphore started;
+        QSemaphore release;
+        qt.run([&]() { started.release(); release.acquire(); });
+        started.acquire();
+        for (int i = 0 ; i < 1000 ; ++i) qt.add(1);
+        release.release();
+        QCOMPARE(qt.sum(), (qint64)100);
+        QCOMPARE(rejected, 900);
+    }
+
+    void poolCallQueueLimit_test()
+    {
+        // the limit counts all threads and lanes of the pool together
+        Receiver pool(ThreadVerify::Worker, 4);
+        QAtomicInt rejected = 0;
+        pool.setCallQueueLimit(100, FifoReject, [&rejected]() { rejected.fetchAndAddOrdered(1); });
+        QSemaphore started;
+        QSemaphore release;
+        for (int i = 0 ; i < 4 ; ++i) pool.run([&]() { started.release(); release.acquire(); });
+        started.acquire(4);
+        QAtomicInt bulk = 0;
+        for (int i = 0 ; i < 500 ; ++i) {
+            pool.add(1);
+            pool.run(CallBulk, [&bulk]() { bulk.fetchAndAddOrdered(1); });
+        }
+        release.release(4);
+        QCOMPARE(pool.sum() + bulk.loadAcquire(), (qint64)100);
+        QCOMPARE(rejected.loadAcquire(), 900);
+    }
+
+    void functorPool_test()
+    {
+        // blocks get reused after delete
+        const Functor * f1 = new StdFunctor([]() {});
+        delete f1;
+        const Functor * f2 = new StdFunctor([]() {});
+        QCOMPARE((const void *)f2, (const void *)f1);
+        delete f2;
+    }
+
+    void functorPoolThreadExit_test()
+    {
+        QSemaphore done;
+        QThread * thread = QThread::create([&done]() {
+            // constructed before the functor cache, thus destroyed after it
+            lateFunctorDelete.done = &done;
+            lateFunctorDelete.functor = new StdFunctor([]() {});
+            for (int i = 0 ; i < 1000 ; ++i) delete new StdFunctor([]() {});
+        });
+        thread->start();
+        QVERIFY(thread->wait(5000));
+        QVERIFY(done.tryAcquire(1, 5000));
+        delete thread;
+    }
+
+    void allCallsArrive_test()
+    {
+        Receiver recv(ThreadVerify::Worker, 4);
+        for (int i = 1 ; i <= CallsPerRun ; ++i) recv.add(i);
+        for (int i = 1 ; i <= 1000 ; ++i) recv.addLater(1);
+        QTRY_COMPARE(recv.sum(), (qint64)CallsPerRun * (CallsPerRun + 1) / 2 + 1000);
+    }
+
+    void autoScaling_test()
+    {
+        Receiver recv(ThreadVerify::Worker, 4);
+        recv.setAutoScaling(1, 0.5, 1, 0.05);
+        QTest::qWait(200);
+
+        // slow calls start more threads
+        QMutex mutex;
+        QSet<QThread *> threads;
+        for (int i = 0 ; i < 200 ; ++i) recv.run([&]() {
+            QThread::msleep(1);
+            QMutexLocker lock(&mutex);
+            threads << QThread::currentThread();
+            recv.add(1);
+        });
+        QTRY_COMPARE(recv.sum(), (qint64)200);
+        QVERIFY(threads.size() > 1);
+
+        // retired threads do not lose calls
+        QTest::qWait(200);
+        for (int i = 0 ; i < 1000 ; ++i) recv.add(1);
+        QTRY_COMPARE(recv.sum(), (qint64)1200);
+    }
+
+    void coroutine_test()
+    {
+        Receiver net(ThreadVerify::Net, 1);
+        qint64 result = 0;
+        addTwice(net, result).start();
+        QTRY_COMPARE(result, (qint64)12);
+
+        Receiver pool(ThreadVerify::Worker, 4);
+        Receiver qt(ThreadVerify::Qt, 1);
+        result = 0;
+        [](Receiver & pool, Receiver & qt, qint64 & result) -> Task<> {
+            co_await onThread(&qt, &Receiver::add, 3);
+            result = co_await addAndSum(pool, 4) + co_await onThread(&qt, &Receiver::sum);
+        }(pool, qt, result).start();
+        QTRY_COMPARE(result, (qint64)7);
+    }
+
+    void coroutineResumeThread_test()
+    {
+        // resumed by the same thread of the pool
+        Receiver pool(ThreadVerify::Worker, 4);
+        Receiver net(ThreadVerify::Net, 1);
+        QAtomicInt sameThread(0);
+        QAtomicInt done(0);
+        pool.run([&]() {
+            [](Receiver & net, QAtomicInt & sameThread, QAtomicInt & done) -> Task<> {
+                for (int i = 0 ; i < 20 ; ++i) {
+                    QThread * before = QThread::currentThread();
+                    co_await onThread(&net, &Receiver::add, 1);
+                    if (QThread::currentThread() == before) sameThread.ref();
+                }
+                done.ref();
+            }(net, sameThread, done).start();
+        });
+        QTRY_COMPARE(done.loadRelaxed(), 1);
+        QCOMPARE(sameThread.loadRelaxed(), 20);
+        QCOMPARE(net.sum(), (qint64)20);
+    }
+
+    void coroutineRetiredThread_test()
+    {
+        // threads of an auto scaled pool retire while their coroutines wait
+        Receiver pool(ThreadVerify::Worker, 4);
+        pool.setAutoScaling(1, 0.5, 1000, 0.05);
+        Receiver net(ThreadVerify::Net, 1);
+        QSemaphore arrived;
+        QSemaphore barrier;
+        QAtomicInt sameThread(0);
+        QAtomicInt done(0);
+        for (int i = 0 ; i < 4 ; ++i) pool.run([&]() {
+            [](Receiver & net, QAtomicInt & sameThread, QAtomicInt & done) -> Task<> {
+                QThread * before = QThread::currentThread();
+                co_await onThread(&net, &Receiver::sleep, 300);
+                if (QThread::currentThread() == before) sameThread.ref();
+                done.ref();
+            }(net, sameThread, done).start();
+            // every call in its own thread
+            arrived.release();
+            barrier.acquire();
+        });
+        QVERIFY(arrived.tryAcquire(4, 5000));
+        barrier.release(4);
+        QTRY_COMPARE_WITH_TIMEOUT(done.loadRelaxed(), 4, 10000);
+        QCOMPARE(sameThread.loadRelaxed(), 4);
+    }
+
+    void coroutineErrors_test()
+    {
+        Receiver net(ThreadVerify::Net, 1);
+        Receiver stopped(ThreadVerify::Net, 1);
+        stopped.stop();
+        QStringList errors;
+        [](Receiver & net, Receiver & stopped, QStringList & errors) -> Task<> {
+            try {
+                co_await onThread(&net, &Receiver::fail);
+            } catch (const std::runtime_error & e) {
+                errors << e.what();
+            }
+            try {
+                co_await onThread(&stopped, &Receiver::sum);
+            } catch (const ThreadCallDropped & e) {
+                errors << e.what();
+            }
+        }(net, stopped, errors).start();
+        QTRY_COMPARE(errors, QStringList() << "failed" << "thread call dropped");
+    }
+
+    void threadPlacement_test()
+    {
+        QVERIFY(setThreadPlacement("Receiver:cpus=0;@net:cpus=0-1|3,node=0,fifo=1; @worker : node=0"));
+        QVERIFY(!setThreadPlacement("Receiver"));
+        QVERIFY(!setThreadPlacement("Receiver:cpus=2-1"));
+        QVERIFY(!setThreadPlacement("Receiver:core=1"));
+        QVERIFY(!setThreadPlacement(":cpus=1"));
+        Receiver recv(ThreadVerify::Worker, 2);
+        recv.add(1);
+        QTRY_COMPARE(recv.sum(), (qint64)1);
+        QVERIFY(setThreadPlacement(""));
+
+#ifdef Q_OS_LINUX
+        // pin a pool to the first cpu we may use
+        cpu_set_t set;
+        QCOMPARE(sched_getaffinity(0, sizeof(set), &set), 0);
+        int cpu = 0;
+        while (!CPU_ISSET(cpu, &set)) ++cpu;
+        ThreadStats stats;
+        QVERIFY(setThreadPlacement(QString("Placed:cpus=%1").arg(cpu)));
+        {
+            Receiver placed(ThreadVerify::Worker, 2, "Placed");
+            QSemaphore checked;
+            QAtomicInt pinned(0);
+            for (int i = 0 ; i < 2 ; ++i) placed.run(CallCritical, [&]() {
+                cpu_set_t own;
+                if (sched_getaffinity(0, sizeof(own), &own) == 0 && CPU_COUNT(&own) == 1 && CPU_ISSET(cpu, &own)) pinned.ref();
+                checked.release();
+            });
+            QVERIFY(checked.tryAcquire(2, 5000));
+            QCOMPARE(pinned.loadRelaxed(), 2);
+
+            const QString expected = QString(": cpus %1").arg(cpu);
+            auto placements = [&]() {
+                QStringList rv;
+                for (const ThreadStats::ThreadInfo & info : stats.current()) {
+                    for (const QString & p : info.placement) if (p.startsWith("Placed ")) rv << p;
+                }
+                rv.sort();
+                return rv;
+            };
+            QTRY_COMPARE(placements(), QStringList() << "Placed 1/2" + expected << "Placed 2/2" + expected);
+        }
+        QVERIFY(setThreadPlacement(""));
+#endif
+    }
+
+    void histogram_test()
+    {
+        ThreadStats::Histogram hist;
+        hist.counts.resize(impl::AtomicHistogram::BucketCount);
+        for (quint64 v = 1 ; v <= 1000 ; ++v) ++hist.counts[impl::AtomicHistogram::bucket(v * 1000)];
+        QCOMPARE(hist.count(), (quint64)1000);
+        QVERIFY(hist.percentile(50) >= 500000 && hist.percentile(50) < 500000 * 1.125);
+        QVERIFY(hist.percentile(99) >= 990000 && hist.percentile(99) < 990000 * 1.125);
+        QVERIFY(hist.max() >= 1000000);
+    }
+
+    void threadStats_test()
+    {
+        ThreadStats stats;
+        {
+            Receiver recv(ThreadVerify::Worker, 2);
+            for (int i = 0 ; i < 1000 ; ++i) recv.add(1);
+            QTRY_COMPARE(recv.sum(), (qint64)1000);
+
+            quint64 calls = 0;
+            for (const ThreadStats::ThreadSnapshot & ts : stats.snapshot()) {
+                calls += ts.calls;
+                QCOMPARE(ts.execTime.count(), ts.calls);
+            }
+            QVERIFY(calls >= 1000);
+            QVERIFY(ThreadStats::toJson(stats.snapshot()).contains("\"Receiver 1/2\""));
+            QVERIFY(ThreadStats::toPrometheus(stats.snapshot()).contains("cflib_thread_wait_seconds{thread=\"Receiver 2/2\",quantile=\"0.99\"}"));
+        }
+    }
+
+    void callsPerSec_test()
+    {
+        BENCHMARK_ONLY();
+
+        Receiver net(ThreadVerify::Net, 1);
+        Receiver pool(ThreadVerify::Worker, 4);
+        Receiver qt(ThreadVerify::Qt, 1);
+
+        QElapsedTimer elapsed;
+        elapsed.start();
+        for (int i = 0 ; i < CallsPerRun ; ++i) net.add(1);
+        QCOMPARE(net.sum(), (qint64)CallsPerRun);
+        reportCallsPerSec("libev thread", elapsed);
+
+        elapsed.start();
+        for (int i = 0 ; i < CallsPerRun ; ++i) pool.add(1);
+        QTRY_COMPARE(pool.sum(), (qint64)CallsPerRun);
+        reportCallsPerSec("worker pool ", elapsed);
+
+        elapsed.start();
+        for (int i = 0 ; i < CallsPerRun ; ++i) qt.add(1);
+        QCOMPARE(qt.sum(), (qint64)CallsPerRun);
+        reportCallsPerSec("Qt thread   ", elapsed);
+    }
+
+};
+#include "threadverify_test.moc"
+ADD_TEST(ThreadVerify_Test)
@@ -0,0 +1,218 @@
+/* Copyright (C) 2013-2024 Christian Fischbach <cf@cflib.de>
+ *
+ * This file is part of cflib.
+ *
+ * Licensed under the MIT License.
+ */
+
+#include <cflib/util/evtimer.h>
+#include <cflib/util/test.h>
+#include <cflib/util/threadverify.h>
+#include <cflib/util/timer.h>
+#include <cflib/util/timerwheel.h>
+
+#include <vector>
+
+using namespace cflib::util;
+
+namespace {
+
+class Loop : public ThreadVerify
+{
+public:
+    Loop() : ThreadVerify("TimerLoop", Net) {}
+    ~Loop() { stopVerifyThread(); }
+
+    void run(const std::function<void()> & func)
+    {
+        if (!verifyThreadCall(&Loop::run, func)) return;
+        func();
+    }
+
+    void runSynced(const std::function<void()> & func)
+    {
+        QSemaphore sem;
+        run([&]() { func(); sem.release(); });
+        sem.acquire();
+    }
+
+    template<typename T>
+    T get(const T & value)
+    {
+        T rv;
+        runSynced([&]() { rv = value; });
+        return rv;
+    }
+};
+
+class Entry : public TimerWheel::Entry
+{
+public:
+    Entry() : id(0), list(0), fired(0) {}
+
+    int id;
+    QList<int> * list;
+    int fired;
+
+protected:
+    void expired() override
+    {
+        ++fired;
+        if (list) *list << id;
+    }
+};
+
+class Repeater
+{
+public:
+    Repeater(int shots = 3, int workMsecs = 0) :
+        timer(this, &Repeater::timeout), count(0), shots_(shots), workMsecs_(workMsecs) {}
+
+    void timeout()
+    {
+        if (++count == shots_) {
+            timer.stop();
+            elapsed = started.elapsed();
+        }
+        if (workMsecs_ > 0) QThread::msleep(workMsecs_);
+    }
+
+    EVTimer timer;
+    int count;
+    QElapsedTimer started;
+    qint64 elapsed = 0;
+
+private:
+    const int shots_;
+    const int workMsecs_;
+};
+
+void reportNsecsPerOp(const char * name, qint64 nsecs, int ops)
+{
+    QTextStream(stdout) << name << ": " << (double)nsecs / ops << " ns/op" << Qt::endl;
+}
+
+}
+
+class TimerWheel_Test: public QObject
+{
+    Q_OBJECT
+private slots:
+
+    void order_test()
+    {
+        Loop loop;
+        QList<int> list;
+        Entry entries[5];
+        loop.run([&]() {
+            const double after[5] = { 0.03, 0.01, 0.3, 0.02, 0.001 };
+            for (int i = 0 ; i < 5 ; ++i) {
+                entries[i].id = i;
+                entries[i].list = &list;
+                TimerWheel::ofThread()->start(&entries[i], after[i]);
+            }
+        });
+        QTRY_COMPARE(loop.get(list).size(), 5);
+        QCOMPARE(loop.get(list), QList<int>() << 4 << 1 << 3 << 0 << 2);
+    }
+
+    void stop_test()
+    {
+        Loop loop;
+        Entry stopped;
+        Entry restarted;
+        Entry fired;
+        uint count = 0;
+        loop.runSynced([&]() {
+            TimerWheel * wheel = TimerWheel::ofThread();
+            wheel->start(&stopped, 0.01);
+            wheel->start(&restarted, 0.01);
+            wheel->start(&fired, 0.02);
+            wheel->stop(&stopped);
+            wheel->start(&restarted, 0.1);
+
+            // destructor stops the entry
+            Entry * destroyed = new Entry();
+            wheel->start(destroyed, 0.01);
+            delete destroyed;
+            count = wheel->count();
+        });
+        QCOMPARE(count, 2u);
+        QTRY_COMPARE(loop.get(fired.fired), 1);
+        QCOMPARE(loop.get(restarted.fired), 0);
+        QTRY_COMPARE(loop.get(restarted.fired), 1);
+        QCOMPARE(loop.get(stopped.fired), 0);
+    }
+
+    void repeat_test()
+    {
+        Loop loop;
+        Repeater rep;
+        int shots = 0;
+        loop.run([&]() {
+            rep.timer.start(0.005);
+            Timer::singleShot(0, new StdFunctor([&shots]() { ++shots; }));
+            Timer::singleShot(0.01, new StdFunctor([&shots]() { ++shots; }));
+        });
+        QTRY_COMPARE(loop.get(rep.count), 3);
+        QTRY_COMPARE(loop.get(shots), 2);
+        QTest::qWait(20);
+        QCOMPARE(loop.get(rep.count), 3);
+
+        // processing time and rounding do not delay the following periods:
+        // a drifting timer needs at least 15 msecs per period, the bound allows
+        // a late scheduler 4 msecs per period on average
+        const int Periods = 20;
+        Repeater drift(Periods, 5);
+        loop.run([&]() {
+            drift.started.start();
+            drift.timer.start(0.01);
+        });
+        QTRY_COMPARE(loop.get(drift.count), Periods);
+        const qint64 elapsed = loop.get(drift.elapsed);
+        QVERIFY2(elapsed >= Periods * 10 - 5 && elapsed < Periods * 14, qPrintable(QString::number(elapsed)));
+    }
+
+    void million_test()
+    {
+        BENCHMARK_ONLY();
+
+        const int Count = 1000000;
+        Loop loop;
+        std::vector<Entry> entries(Count);
+        uint count = 0;
+        loop.runSynced([&]() {
+            TimerWheel * wheel = TimerWheel::ofThread();
+            QElapsedTimer elapsed;
+
+            // timeouts spread over 10 minutes use all levels
+            elapsed.start();
+            for (int i = 0 ; i < Count ; ++i) wheel->start(&entries[i], (i % 600000) / 1000.0 + 1);
+            reportNsecsPerOp("start 1M       ", elapsed.nsecsElapsed(), Count);
+            count = wheel->count();
+
+            elapsed.start();
+            for (int i = 0 ; i < Count ; ++i) wheel->stop(&entries[i]);
+            reportNsecsPerOp("stop 1M        ", elapsed.nsecsElapsed(), Count);
+            count -= wheel->count();
+
+            elapsed.start();
+            for (int i = 0 ; i < Count ; ++i) wheel->start(&entries[i], (i % 100) / 1000.0);
+            reportNsecsPerOp("start 1M 100 ms", elapsed.nsecsElapsed(), Count);
+        });
+        QCOMPARE(count, (uint)Count);
+
+        QElapsedTimer elapsed;
+        elapsed.start();
+        auto firedCount = [&]() {
+            uint fired = 0;
+            loop.runSynced([&]() { for (const Entry & entry : entries) fired += entry.fired; });
+            return fired;
+        };
+        QTRY_COMPARE(firedCount(), (uint)Count);
+        QTextStream(stdout) << "fired 1M within " << elapsed.elapsed() << " ms" << Qt::endl;
+    }
+
+};
+#include "timerwheel_test.moc"
+ADD_TEST(TimerWheel_Test)